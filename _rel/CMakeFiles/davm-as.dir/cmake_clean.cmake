@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-as.dir/tools/as.cpp.o"
+  "CMakeFiles/davm-as.dir/tools/as.cpp.o.d"
+  "davm-as"
+  "davm-as.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-as.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,48 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx.cxx" "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch" "gcc" "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch" "gcc" "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch.d"
+  "/root/repo/vm/assembler.cpp" "CMakeFiles/davm-core.dir/vm/assembler.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/assembler.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/assembler.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/assembler.cpp.o.d"
+  "/root/repo/vm/async.cpp" "CMakeFiles/davm-core.dir/vm/async.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/async.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/async.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/async.cpp.o.d"
+  "/root/repo/vm/image.cpp" "CMakeFiles/davm-core.dir/vm/image.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/image.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/image.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/image.cpp.o.d"
+  "/root/repo/vm/io.cpp" "CMakeFiles/davm-core.dir/vm/io.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/io.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/io.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/io.cpp.o.d"
+  "/root/repo/vm/jit.cpp" "CMakeFiles/davm-core.dir/vm/jit.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/jit.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/jit.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/jit.cpp.o.d"
+  "/root/repo/vm/memory.cpp" "CMakeFiles/davm-core.dir/vm/memory.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/memory.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/memory.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/memory.cpp.o.d"
+  "/root/repo/vm/pool.cpp" "CMakeFiles/davm-core.dir/vm/pool.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/pool.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/pool.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/pool.cpp.o.d"
+  "/root/repo/vm/profile.cpp" "CMakeFiles/davm-core.dir/vm/profile.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/profile.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/profile.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/profile.cpp.o.d"
+  "/root/repo/vm/run.cpp" "CMakeFiles/davm-core.dir/vm/run.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/run.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/run.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/run.cpp.o.d"
+  "/root/repo/vm/stats.cpp" "CMakeFiles/davm-core.dir/vm/stats.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/stats.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/stats.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/stats.cpp.o.d"
+  "/root/repo/vm/thread.cpp" "CMakeFiles/davm-core.dir/vm/thread.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/thread.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/thread.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/thread.cpp.o.d"
+  "/root/repo/vm/trace.cpp" "CMakeFiles/davm-core.dir/vm/trace.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/trace.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/trace.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/trace.cpp.o.d"
+  "/root/repo/vm/verify.cpp" "CMakeFiles/davm-core.dir/vm/verify.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/verify.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/verify.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/verify.cpp.o.d"
+  "/root/repo/vm/vm.cpp" "CMakeFiles/davm-core.dir/vm/vm.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/vm.cpp.o.d"
+  "/root/repo/_rel/CMakeFiles/davm-core.dir/cmake_pch.hxx" "CMakeFiles/davm-core.dir/vm/vm.cpp.o" "gcc" "CMakeFiles/davm-core.dir/vm/vm.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,39 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch"
+  "CMakeFiles/davm-core.dir/cmake_pch.hxx.gch.d"
+  "CMakeFiles/davm-core.dir/vm/assembler.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/assembler.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/async.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/async.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/image.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/image.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/io.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/io.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/jit.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/jit.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/memory.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/memory.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/pool.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/pool.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/profile.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/profile.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/run.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/run.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/stats.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/stats.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/thread.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/thread.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/trace.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/trace.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/verify.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/verify.cpp.o.d"
+  "CMakeFiles/davm-core.dir/vm/vm.cpp.o"
+  "CMakeFiles/davm-core.dir/vm/vm.cpp.o.d"
+  "libdavm-core.a"
+  "libdavm-core.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-core.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
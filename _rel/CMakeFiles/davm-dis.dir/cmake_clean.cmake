@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-dis.dir/tools/dis.cpp.o"
+  "CMakeFiles/davm-dis.dir/tools/dis.cpp.o.d"
+  "davm-dis"
+  "davm-dis.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-dis.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
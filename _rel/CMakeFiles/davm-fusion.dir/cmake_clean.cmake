@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-fusion.dir/tools/fusion.cpp.o"
+  "CMakeFiles/davm-fusion.dir/tools/fusion.cpp.o.d"
+  "davm-fusion"
+  "davm-fusion.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-fusion.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-prof.dir/tools/prof.cpp.o"
+  "CMakeFiles/davm-prof.dir/tools/prof.cpp.o.d"
+  "davm-prof"
+  "davm-prof.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-prof.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm-trace.dir/tools/trace.cpp.o"
+  "CMakeFiles/davm-trace.dir/tools/trace.cpp.o.d"
+  "davm-trace"
+  "davm-trace.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm-trace.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm.dir/vm/main.cpp.o"
+  "CMakeFiles/davm.dir/vm/main.cpp.o.d"
+  "davm"
+  "davm.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/davm_bench.dir/tools/bench.cpp.o"
+  "CMakeFiles/davm_bench.dir/tools/bench.cpp.o.d"
+  "davm_bench"
+  "davm_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/davm_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
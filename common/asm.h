@@ -39,54 +39,37 @@ DA_ALWAYS_INLINE constexpr sregister_t sext_l(OT x) noexcept {
 // Error handling
 
 inline void asm_error_v(vm_context_t& context) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_v:\n"
-			   "ERROR: This function should not be called!\n");
+	DAVM_LOG_ERROR("From asm_error_v: This function should not be called!");
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
 
 inline void asm_error_r1(vm_context_t& context, regid_t rd) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_r1 (with rd = {}):\n"
-			   "ERROR: This function should not be called!\n",
-			   rd);
+	DAVM_LOG_ERROR("From asm_error_r1 (with rd = {}): This function should not be called!", rd);
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
 
 inline void asm_error_r2(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_r3 (with rd = {}, ra = {}):\n"
-			   "ERROR: This function should not be called!\n",
-			   rd, ra);
+	DAVM_LOG_ERROR("From asm_error_r2 (with rd = {}, ra = {}): This function should not be called!", rd, ra);
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
 
 inline void asm_error_r3(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_r3 (with rd = {}, ra = {}, rb = {}):\n"
-			   "ERROR: This function should not be called!\n",
-			   rd, ra, rb);
+	DAVM_LOG_ERROR("From asm_error_r3 (with rd = {}, ra = {}, rb = {}): This function should not be called!", rd, ra, rb);
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
 
 inline void asm_error_r1i1(vm_context_t& context, regid_t rd, immediate_t imm) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_r3 (with rd = {}, imm = {}):\n"
-			   "ERROR: This function should not be called!\n",
-			   rd, imm);
+	DAVM_LOG_ERROR("From asm_error_r1i1 (with rd = {}, imm = {}): This function should not be called!", rd, imm);
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
 
 inline void asm_error_r2i1(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
-	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
-			   "From asm_error_r3 (with rd = {}, ra = {}, imm = {}):\n"
-			   "ERROR: This function should not be called!\n",
-			   rd, ra, imm);
+	DAVM_LOG_ERROR("From asm_error_r2i1 (with rd = {}, ra = {}, imm = {}): This function should not be called!", rd, ra, imm);
 	print_registers(context);
 	DAVM_PC(context) = 0; // Halt the PC
 }
@@ -100,10 +83,17 @@ inline void asm_hlt(vm_context_t& context) noexcept {
 	DAVM_PC(context) = 0;
 }
 
+// Host call: the execution loops stop with status 4 after it, so that the host serves it & resumes the guest
+// By convention rv holds the service & x8 - x15 the arguments, the host writes the result to rv
+inline void asm_ecall(DA_MAYBE_UNUSED vm_context_t& context) noexcept { }
+
 // Stack operations
+// Stack commands access memory before updating any register, so that a faulting one has no effect
+// PUSH sp stores sp after the decrement, as it always did
 inline void asm_push(vm_context_t& context, regid_t rd) noexcept {
+	const register_t value = context.x[rd] - (rd == 3 ? sizeof(register_t) : 0);
+	*DAVM_CAST(register_t*, DAVM_SP(context) - sizeof(register_t)) = value;
 	DAVM_SP(context) -= sizeof(register_t);
-	*DAVM_CAST(register_t*, DAVM_SP(context)) = context.x[rd];
 }
 
 inline void asm_pop(vm_context_t& context, regid_t rd) noexcept {
@@ -117,11 +107,11 @@ inline void asm_pop(vm_context_t& context, regid_t rd) noexcept {
 // MOVQ		rbp, rsp
 // MOVQ		rip, [target]
 inline void asm_call(vm_context_t& context, regid_t target) noexcept {
+	*DAVM_CAST(register_t*, DAVM_SP(context) - sizeof(register_t))	   = DAVM_PC(context);
+	*DAVM_CAST(register_t*, DAVM_SP(context) - sizeof(register_t) * 2) = DAVM_BP(context);
 	DAVM_SP(context) -= sizeof(register_t) * 2;
-	*DAVM_CAST(register_t*, DAVM_SP(context) + sizeof(register_t)) = DAVM_PC(context);
-	*DAVM_CAST(register_t*, DAVM_SP(context))					   = DAVM_BP(context);
-	DAVM_BP(context)											   = DAVM_SP(context);
-	DAVM_PC(context)											   = context.x[target];
+	DAVM_BP(context) = DAVM_SP(context);
+	DAVM_PC(context) = context.x[target];
 }
 
 // Actually equals to (in Intel style):
@@ -129,10 +119,11 @@ inline void asm_call(vm_context_t& context, regid_t target) noexcept {
 // POPQ	rbp
 // POPQ	rip
 inline void asm_ret(vm_context_t& context) noexcept {
-	DAVM_SP(context) = DAVM_BP(context);
-	DAVM_BP(context) = *DAVM_CAST(register_t*, DAVM_SP(context));
-	DAVM_PC(context) = *DAVM_CAST(register_t*, DAVM_SP(context) + sizeof(register_t));
-	DAVM_SP(context) += sizeof(register_t) * 2;
+	const register_t bp = *DAVM_CAST(register_t*, DAVM_BP(context));
+	const register_t pc = *DAVM_CAST(register_t*, DAVM_BP(context) + sizeof(register_t));
+	DAVM_SP(context)	= DAVM_BP(context) + sizeof(register_t) * 2;
+	DAVM_BP(context)	= bp;
+	DAVM_PC(context)	= pc;
 }
 
 // Arithmetical Operations
@@ -379,7 +370,6 @@ DA_MAYBE_UNUSED static constexpr asm_func_v_t asm_table_v[] = {
 	asm_error_v,
 	asm_error_v,
 	asm_error_v,
-	asm_error_v,
 };
 
 DA_MAYBE_UNUSED static constexpr asm_func_r1_t asm_table_r1[] = {
@@ -450,6 +440,8 @@ DA_MAYBE_UNUSED static constexpr asm_func_r2i1_t asm_table_branch[] = {
 	asm_error_r2i1,
 };
 
+#undef DA_X
+
 END_DA_NAMESPACE
 
 #endif // _DAVM_COMMON_ASM_H_
@@ -0,0 +1,80 @@
+/**
+ * @file      atomic.h
+ * @brief     Atomic assembler functions, on the atomics of the host
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_COMMON_ATOMIC_H_
+#define _DAVM_COMMON_ATOMIC_H_
+
+#include <common/pch.h>
+#include <common/bulk.h>
+#include <common/type.h>
+
+#include <type_traits>
+
+BEGIN_DA_NAMESPACE
+
+// Guest threads share memory, see vm/thread.h, so every command is one sequentially consistent host atomic.
+// SC is a compare & swap against the value LR read: it succeeds even if other threads wrote the same value in between,
+// which algorithms built on LR & SC cannot tell apart from no write at all
+
+// Host address of the T at @param p, faults if misaligned or outside guest memory, or outside code & read only data too if @param Write is false
+template<typename T, bool Write>
+DA_ALWAYS_INLINE T* atomic_at(const vm_context_t& context, register_t p) noexcept {
+	DA_IF_UNLIKELY(p & (sizeof(T) - 1)) {
+		raise_guest_fault(p);
+	}
+	bulk_check<Write>(context, p, sizeof(T));
+	return DAVM_CAST(T*, p);
+}
+
+// Words are sign extended like LW
+template<typename T>
+DA_ALWAYS_INLINE register_t atomic_extend(T value) noexcept {
+	return register_t(std::make_signed_t<T>(value));
+}
+
+template<typename T>
+inline void asm_lr(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	const register_t p	   = context.x[ra];
+	const T			 value = __atomic_load_n(atomic_at<T, false>(context, p), __ATOMIC_SEQ_CST);
+	context.reservation	   = { p, value };
+	context.x[rd]		   = atomic_extend(value);
+}
+
+template<typename T>
+inline void asm_sc(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	const register_t p		  = context.x[ra];
+	T*				 at		  = atomic_at<T, true>(context, p);
+	T				 expected = T(context.reservation.value);
+	const bool		 stored	  = context.reservation.address == p
+					   && __atomic_compare_exchange_n(at, &expected, T(context.x[rb]), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	context.reservation.address = 0;
+	context.x[rd]				= !stored;
+}
+
+template<typename T>
+inline void asm_amoadd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	context.x[rd] = atomic_extend(__atomic_fetch_add(atomic_at<T, true>(context, context.x[ra]), T(context.x[rb]), __ATOMIC_SEQ_CST));
+}
+
+template<typename T>
+inline void asm_amoswap(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	context.x[rd] = atomic_extend(__atomic_exchange_n(atomic_at<T, true>(context, context.x[ra]), T(context.x[rb]), __ATOMIC_SEQ_CST));
+}
+
+// Fails as CMPXCHG does, leaving what [xa] holds in xd
+template<typename T>
+inline void asm_amocas(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	T expected = T(context.x[rd]);
+	__atomic_compare_exchange_n(atomic_at<T, true>(context, context.x[ra]), &expected, T(context.x[rb]), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	context.x[rd] = atomic_extend(expected);
+}
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_COMMON_ATOMIC_H_
@@ -12,6 +12,13 @@
 
 #include <common/pch.h>
 
+#include <algorithm>
+#include <cstring>
+
+#if DA_COMP_GNU && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+#endif
+
 BEGIN_DA_NAMESPACE
 
 inline static constexpr char b64padding_char = '=';
@@ -65,14 +72,14 @@ inline constexpr size_t b64dec_len(size_t encoded) noexcept {
 }
 
 /**
- * @brief  Encode at most @param n bytes from @param src to @param dest
+ * @brief  Encode at most @param n bytes from @param src to @param dest, reference of @ref b64enc
  * @param  dest The place where the result writes to
  * @param  src  The source data stream to encode
  * @param  n    Length of the data stream
  * @note   Make sure there are enough space in @param dest, you may use @ref b64enc_len to calculate the space
  * @note   It's recommended that @param dest is at least 4-byte aligned, otherwise it may be slow or even fail in some rare cases
  */
-constexpr void b64enc(char* dest, const uint8_t* src, size_t n) noexcept {
+constexpr void b64enc_scalar(char* dest, const uint8_t* src, size_t n) noexcept {
 	uint32_t code = 0;
 	while(n > 2) {
 		n -= 3;
@@ -118,7 +125,7 @@ constexpr void b64enc(char* dest, const uint8_t* src, size_t n) noexcept {
 }
 
 /**
- * @brief  Decode at most @param n chars from @param src to @param dest
+ * @brief  Decode at most @param n chars from @param src to @param dest, reference of @ref b64dec
  * @param  dest The place where the result writes to
  * @param  src  The encoded stream
  * @param  n    Length of the encoded stream
@@ -127,10 +134,13 @@ constexpr void b64enc(char* dest, const uint8_t* src, size_t n) noexcept {
  * @retval -2 Unexpected token
  * @note   Make sure there are enough space in @param dest, you may use @ref b64dec_len to calculate the space
  */
-constexpr size_t b64dec(uint8_t* dest, const char* src, size_t n) noexcept {
+constexpr size_t b64dec_scalar(uint8_t* dest, const char* src, size_t n) noexcept {
 	DA_IF_UNLIKELY(n & 0x03) { // n should be dividable by 4
 		return -1;
 	}
+	DA_IF_UNLIKELY(n == 0) {
+		return 0;
+	}
 	size_t ret = (n >> 2) + (n >> 1);
 	uint32_t code = 0;
 	while(n > 4) {
@@ -183,6 +193,363 @@ constexpr size_t b64dec(uint8_t* dest, const char* src, size_t n) noexcept {
 	return ret;
 }
 
+// SIMD paths, each one stops before the last quartet & leaves the rest to the scalar code,
+// so that padding & errors are handled the same way everywhere
+
+#if DA_COMP_GNU && (defined(__x86_64__) || defined(__i386__))
+	#define DA_B64_SIMD 1
+#else
+	#define DA_B64_SIMD 0
+#endif
+
+// Instruction sets, in order of preference
+enum b64_isa_t : uint8_t {
+	B64_SCALAR,
+	B64_SSE41,
+	B64_AVX2,
+	B64_AVX512VBMI,
+	B64_ISA_COUNT
+};
+
+#if DA_B64_SIMD
+
+// Decoded value of chars 0x00 - 0x7F, 0x80 if invalid, for vpermi2b
+static constexpr auto b64table_dec128 = [] {
+	struct {
+		uint8_t value[128];
+	} table {};
+	for(size_t i = 0; i < 128; ++i) {
+		table.value[i] = b64table_dec[i] < 0x40 ? b64table_dec[i] : 0x80;
+	}
+	return table;
+}();
+
+// Output byte of each 24-bit group packed by madd into a dword, for vpermb
+static constexpr auto b64table_pack48 = [] {
+	struct {
+		uint8_t index[64];
+	} table {};
+	for(size_t i = 0; i < 48; ++i) {
+		table.index[i] = uint8_t(i / 3 * 4 + 2 - i % 3);
+	}
+	return table;
+}();
+
+// Spread 3 bytes into the 4 bytes whose 6-bit fields are the output chars, in each 16-byte lane
+__attribute__((target("sse4.1"))) inline __m128i b64enc_reshuffle(__m128i in) noexcept {
+	in				 = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+// Map 6-bit values to chars by adding the offset of their range
+__attribute__((target("sse4.1"))) inline __m128i b64enc_translate(__m128i in) noexcept {
+	const __m128i lut	  = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i		  indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	indices				  = _mm_sub_epi8(indices, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+__attribute__((target("sse4.1"))) inline void b64enc_sse41(char* dest, const uint8_t* src, size_t n) noexcept {
+	for(; n >= 16; n -= 12) { // Reads 16 bytes, consumes 12
+		const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), b64enc_translate(b64enc_reshuffle(in)));
+		src += 12;
+		dest += 16;
+	}
+	b64enc_scalar(dest, src, n);
+}
+
+// Check chars & map them to 6-bit values, the nibble tables flag anything outside the alphabet, including '='
+// @return Whether all chars are valid
+__attribute__((target("sse4.1"))) inline bool b64dec_translate(__m128i& str) noexcept {
+	const __m128i lut_lo   = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi   = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f  = _mm_set1_epi8(0x2F);
+	const __m128i hi	   = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+	const __m128i lo	   = _mm_and_si128(str, mask_2f);
+	DA_IF_UNLIKELY(!_mm_testz_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi))) {
+		return false;
+	}
+	const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi));
+	str				   = _mm_add_epi8(str, roll);
+	return true;
+}
+
+// Pack 4 6-bit values into 3 bytes, the 12 bytes of each lane come first
+__attribute__((target("sse4.1"))) inline __m128i b64dec_pack(__m128i in) noexcept {
+	const __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1"))) inline size_t b64dec_sse41(uint8_t* dest, const char* src, size_t n) noexcept {
+	DA_IF_UNLIKELY(n & 0x03) {
+		return -1;
+	}
+	size_t done = 0;
+	for(; n >= 16 + 8; n -= 16) { // Writes 16 bytes, keeps room for the 4 extra ones
+		__m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		DA_IF_UNLIKELY(!b64dec_translate(str)) {
+			return -2;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), b64dec_pack(str));
+		src += 16;
+		dest += 12;
+		done += 12;
+	}
+	const size_t rest = b64dec_scalar(dest, src, n);
+	return rest >= size_t(-2) ? rest : done + rest;
+}
+
+__attribute__((target("avx2"))) inline __m256i b64enc_reshuffle(__m256i in) noexcept {
+	const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+											1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	in					 = _mm256_shuffle_epi8(in, spread);
+	const __m256i t0	 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+	const __m256i t1	 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	const __m256i t2	 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+	const __m256i t3	 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t1, t3);
+}
+
+__attribute__((target("avx2"))) inline __m256i b64enc_translate(__m256i in) noexcept {
+	const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+										 65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m256i indices = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+	indices			= _mm256_sub_epi8(indices, _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25)));
+	return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, indices));
+}
+
+__attribute__((target("avx2"))) inline void b64enc_avx2(char* dest, const uint8_t* src, size_t n) noexcept {
+	for(; n >= 28; n -= 24) { // Reads 12 bytes into each lane with 2 loads of 16
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12));
+		const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), b64enc_translate(b64enc_reshuffle(in)));
+		src += 24;
+		dest += 32;
+	}
+	b64enc_sse41(dest, src, n);
+}
+
+__attribute__((target("avx2"))) inline bool b64dec_translate(__m256i& str) noexcept {
+	const __m256i lut_lo   = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+											  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi   = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+											  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+											  0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f  = _mm256_set1_epi8(0x2F);
+	const __m256i hi	   = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+	const __m256i lo	   = _mm256_and_si256(str, mask_2f);
+	DA_IF_UNLIKELY(!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo), _mm256_shuffle_epi8(lut_hi, hi))) {
+		return false;
+	}
+	const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi));
+	str				   = _mm256_add_epi8(str, roll);
+	return true;
+}
+
+// Same as the SSE one, then move the 12 bytes of the upper lane next to those of the lower one
+__attribute__((target("avx2"))) inline __m256i b64dec_pack(__m256i in) noexcept {
+	const __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+	const __m256i packed = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+																		 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+__attribute__((target("avx2"))) inline size_t b64dec_avx2(uint8_t* dest, const char* src, size_t n) noexcept {
+	DA_IF_UNLIKELY(n & 0x03) {
+		return -1;
+	}
+	size_t done = 0;
+	for(; n >= 32 + 12; n -= 32) { // Writes 32 bytes, keeps room for the 8 extra ones
+		__m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		DA_IF_UNLIKELY(!b64dec_translate(str)) {
+			return -2;
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), b64dec_pack(str));
+		src += 32;
+		dest += 24;
+		done += 24;
+	}
+	const size_t rest = b64dec_sse41(dest, src, n);
+	return rest >= size_t(-2) ? rest : done + rest;
+}
+
+// Every byte lane, the zero-masked forms compile to the same vpermb & vpmultishiftqb as the plain ones,
+// which pass _mm512_undefined_epi32() & trip -Wmaybe-uninitialized on GCC 12
+static constexpr __mmask64 B64_MASK64 = ~__mmask64(0);
+
+// 48 bytes to 64 chars: vpermb spreads every 3 bytes over a dword, vpmultishiftqb extracts the 6-bit fields,
+// & vpermb looks them up in the alphabet, using only the low 6 bits of each index
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) inline void b64enc_avx512vbmi(char* dest, const uint8_t* src, size_t n) noexcept {
+	const __m512i spread = _mm512_setr_epi32(0x01020001, 0x04050304, 0x07080607, 0x0A0B090A, 0x0D0E0C0D, 0x10110F10, 0x13141213, 0x16171516,
+											 0x191A1819, 0x1C1D1B1C, 0x1F201E1F, 0x22232122, 0x25262425, 0x28292728, 0x2B2C2A2B, 0x2E2F2D2E);
+	const __m512i shifts = _mm512_set1_epi64(0x3036242A1016040A);
+	const __m512i lookup = _mm512_loadu_si512(b64table_enc);
+	for(; n >= 48; n -= 48) {
+		const __m512i in = _mm512_maskz_loadu_epi8(0xFFFFFFFFFFFF, src);
+		const __m512i fields = _mm512_maskz_multishift_epi64_epi8(B64_MASK64, shifts, _mm512_maskz_permutexvar_epi8(B64_MASK64, spread, in));
+		_mm512_storeu_si512(dest, _mm512_maskz_permutexvar_epi8(B64_MASK64, fields, lookup));
+		src += 48;
+		dest += 64;
+	}
+	b64enc_avx2(dest, src, n);
+}
+
+// 64 chars to 48 bytes: vpermi2b looks chars up in a 128-entry table, where invalid ones have the sign bit set
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) inline size_t b64dec_avx512vbmi(uint8_t* dest, const char* src, size_t n) noexcept {
+	DA_IF_UNLIKELY(n & 0x03) {
+		return -1;
+	}
+	const __m512i lookup_lo = _mm512_loadu_si512(b64table_dec128.value);
+	const __m512i lookup_hi = _mm512_loadu_si512(b64table_dec128.value + 64);
+	const __m512i pack		= _mm512_loadu_si512(b64table_pack48.index);
+	size_t		  done		= 0;
+	for(; n >= 64 + 4; n -= 64) { // Stores exactly 48 bytes
+		const __m512i str	= _mm512_loadu_si512(src);
+		const __m512i value = _mm512_permutex2var_epi8(lookup_lo, str, lookup_hi);
+		DA_IF_UNLIKELY(_mm512_movepi8_mask(_mm512_or_si512(value, str))) {
+			return -2;
+		}
+		const __m512i merged = _mm512_madd_epi16(_mm512_maddubs_epi16(value, _mm512_set1_epi32(0x01400140)), _mm512_set1_epi32(0x00011000));
+		_mm512_mask_storeu_epi8(dest, 0xFFFFFFFFFFFF, _mm512_maskz_permutexvar_epi8(B64_MASK64, pack, merged));
+		src += 64;
+		dest += 48;
+		done += 48;
+	}
+	const size_t rest = b64dec_avx2(dest, src, n);
+	return rest >= size_t(-2) ? rest : done + rest;
+}
+
+// Best instruction set supported by the CPU & the OS
+inline b64_isa_t b64_detect() noexcept {
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw")) {
+		return B64_AVX512VBMI;
+	}
+	if(__builtin_cpu_supports("avx2")) {
+		return B64_AVX2;
+	}
+	if(__builtin_cpu_supports("sse4.1")) {
+		return B64_SSE41;
+	}
+	return B64_SCALAR;
+}
+#else
+inline b64_isa_t b64_detect() noexcept {
+	return B64_SCALAR;
+}
+#endif
+
+using b64enc_func_t = void (*)(char*, const uint8_t*, size_t) noexcept;
+using b64dec_func_t = size_t (*)(uint8_t*, const char*, size_t) noexcept;
+
+// Implementations indexed by b64_isa_t, those the CPU lacks must not be called
+#if DA_B64_SIMD
+DA_MAYBE_UNUSED static constexpr b64enc_func_t b64enc_table[] = { b64enc_scalar, b64enc_sse41, b64enc_avx2, b64enc_avx512vbmi };
+DA_MAYBE_UNUSED static constexpr b64dec_func_t b64dec_table[] = { b64dec_scalar, b64dec_sse41, b64dec_avx2, b64dec_avx512vbmi };
+#else
+DA_MAYBE_UNUSED static constexpr b64enc_func_t b64enc_table[] = { b64enc_scalar };
+DA_MAYBE_UNUSED static constexpr b64dec_func_t b64dec_table[] = { b64dec_scalar };
+#endif
+
+// Chosen once at startup, stays B64_SCALAR (zero) for callers running before it is initialized
+inline const b64_isa_t b64_isa = b64_detect();
+
+/**
+ * @brief Same as @ref b64enc_scalar, using the best instruction set of the CPU
+ * @note  @param src may be read up to 4 bytes past the encoded bytes, but never past @param n
+ */
+inline void b64enc(char* dest, const uint8_t* src, size_t n) noexcept {
+	b64enc_table[b64_isa](dest, src, n);
+}
+
+/**
+ * @brief  Same as @ref b64dec_scalar, using the best instruction set of the CPU
+ * @note   @param dest must hold @ref b64dec_len(@param n) bytes, which may all be written even if fewer are decoded
+ */
+inline size_t b64dec(uint8_t* dest, const char* src, size_t n) noexcept {
+	return b64dec_table[b64_isa](dest, src, n);
+}
+
+/**
+ * @brief Incremental decoder, for streams split into chunks of any size
+ *
+ * Whole quartets are decoded straight from each chunk by @ref b64dec,
+ * only the chars of a quartet split by the end of a chunk are kept until the next one.
+ */
+class b64dec_stream_t {
+	char	m_quartet[4]; // Start of the split quartet
+	uint8_t m_count = 0; // Chars in m_quartet
+	bool	m_end	= false; // Padding seen, the stream must end
+
+public:
+	/**
+	 * @brief  Decode the chunk of @param n chars at @param src to @param dest
+	 * @return The real count that writes to @param dest
+	 * @retval -2 Unexpected token, including chars following padding
+	 * @note   @param dest must hold @ref b64dec_len(@param n + 3) bytes
+	 */
+	size_t feed(uint8_t* dest, const char* src, size_t n) noexcept {
+		DA_IF_UNLIKELY(m_end && n) {
+			return -2;
+		}
+		size_t done = 0;
+		if(m_count) {
+			const size_t take = std::min<size_t>(4 - m_count, n);
+			std::memcpy(m_quartet + m_count, src, take);
+			m_count += uint8_t(take);
+			src += take;
+			n -= take;
+			if(m_count < 4) {
+				return 0;
+			}
+			m_count = 0;
+			done	= b64dec(dest, m_quartet, 4);
+			DA_IF_UNLIKELY(done >= size_t(-2)) {
+				return done;
+			}
+			m_end = done < 3;
+			DA_IF_UNLIKELY(m_end && n) {
+				return -2;
+			}
+		}
+		const size_t whole = n & ~size_t(0x03);
+		if(whole) {
+			const size_t ret = b64dec(dest + done, src, whole);
+			DA_IF_UNLIKELY(ret >= size_t(-2)) {
+				return ret;
+			}
+			m_end = ret < b64dec_len(whole);
+			done += ret;
+			DA_IF_UNLIKELY(m_end && n > whole) {
+				return -2;
+			}
+		}
+		m_count = uint8_t(n - whole);
+		std::memcpy(m_quartet, src + whole, m_count);
+		return done;
+	}
+
+	/**
+	 * @brief  End the stream, the decoder can then be reused for another one
+	 * @retval 0  Success
+	 * @retval -1 Unexpected end of stream
+	 */
+	size_t finish() noexcept {
+		const bool partial = m_count;
+		m_count			   = 0;
+		m_end			   = false;
+		return partial ? -1 : 0;
+	}
+};
+
 END_DA_NAMESPACE
 
 #endif // _DAVM_COMMON_BASE64_H_
@@ -0,0 +1,98 @@
+/**
+ * @file      bulk.h
+ * @brief     Bulk memory assembler functions, on the vectorized routines of the host libc
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_COMMON_BULK_H_
+#define _DAVM_COMMON_BULK_H_
+
+#include <common/pch.h>
+#include <common/type.h>
+
+#include <cstring>
+
+BEGIN_DA_NAMESPACE
+
+/**
+ * @brief Report a guest memory fault at @param address to the innermost trap frame, as a faulting access does
+ * @note  Defined in vm/memory.cpp, aborts outside any trap frame
+ */
+[[noreturn]] void raise_guest_fault(addr_t address) noexcept;
+
+// A command reaches as far as its length says, past the guards around memory, so each range is checked before the call
+
+// Check [p, p + length) lies in guest memory, or in code & read only data if @param Write is false
+template<bool Write>
+DA_ALWAYS_INLINE void bulk_check(const vm_context_t& context, register_t p, register_t length) noexcept {
+	const guest_bounds_t& bounds = context.bounds;
+	DA_IF_LIKELY(p - bounds.begin <= bounds.end - bounds.begin && length <= bounds.end - p) {
+		return;
+	}
+	if constexpr(!Write) {
+		DA_IF_LIKELY(p - bounds.ro_begin <= bounds.ro_end - bounds.ro_begin && length <= bounds.ro_end - p) {
+			return;
+		}
+	}
+	DA_IF_UNLIKELY(length) {
+		raise_guest_fault(p);
+	}
+}
+
+// End of the range p lies in, readable without further checks, faults if none
+DA_ALWAYS_INLINE register_t bulk_limit(const vm_context_t& context, register_t p) noexcept {
+	const guest_bounds_t& bounds = context.bounds;
+	DA_IF_LIKELY(p - bounds.begin < bounds.end - bounds.begin) {
+		return bounds.end;
+	}
+	DA_IF_LIKELY(p - bounds.ro_begin < bounds.ro_end - bounds.ro_begin) {
+		return bounds.ro_end;
+	}
+	raise_guest_fault(p);
+}
+
+inline void asm_mcpy(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	const register_t length = context.x[rb];
+	bulk_check<false>(context, context.x[ra], length);
+	bulk_check<true>(context, context.x[rd], length);
+	std::memmove(DAVM_CAST(void*, context.x[rd]), DAVM_CAST(const void*, context.x[ra]), length);
+}
+
+inline void asm_mset(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	const register_t length = context.x[rb];
+	bulk_check<true>(context, context.x[rd], length);
+	std::memset(DAVM_CAST(void*, context.x[rd]), int(byte_t(context.x[ra])), length);
+}
+
+inline void asm_mcmp(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	const register_t length = context.x[rc];
+	bulk_check<false>(context, context.x[ra], length);
+	bulk_check<false>(context, context.x[rb], length);
+	const int ret = std::memcmp(DAVM_CAST(const void*, context.x[ra]), DAVM_CAST(const void*, context.x[rb]), length);
+	context.x[rd] = register_t(sregister_t((ret > 0) - (ret < 0)));
+}
+
+inline void asm_mchr(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	const register_t length = context.x[rc];
+	bulk_check<false>(context, context.x[ra], length);
+	const void* found = std::memchr(DAVM_CAST(const void*, context.x[ra]), int(byte_t(context.x[rb])), length);
+	context.x[rd]	  = found ? DAVM_CAST(register_t, found) - context.x[ra] : length;
+}
+
+// Scans at most to the end of the range xa lies in, the NUL must be found before
+inline void asm_mlen(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	const register_t p	   = context.x[ra];
+	const register_t limit = bulk_limit(context, p);
+	const void*		 found = std::memchr(DAVM_CAST(const void*, p), 0, limit - p);
+	DA_IF_UNLIKELY(!found) {
+		raise_guest_fault(limit);
+	}
+	context.x[rd] = DAVM_CAST(register_t, found) - p;
+}
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_COMMON_BULK_H_
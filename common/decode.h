@@ -0,0 +1,687 @@
+/**
+ * @file      decode.h
+ * @brief     Predecoded form of commands
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_COMMON_DECODE_H_
+#define _DAVM_COMMON_DECODE_H_
+
+#include <common/pch.h>
+#include <common/asm.h>
+#include <common/atomic.h>
+#include <common/bulk.h>
+#include <common/float.h>
+#include <common/log.h>
+#include <common/type.h>
+#include <common/vector.h>
+
+BEGIN_DA_NAMESPACE
+
+// Error handling
+
+inline void exec_error(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	DAVM_LOG_ERROR("From exec_error (with code = {:#010X}): Invalid command!", word_t(inst.imm));
+	print_registers(context);
+	DAVM_PC(context) = 0; // Halt the PC
+}
+
+// Commands without immediate, forward to the asm functions
+
+template<asm_func_v_t F>
+inline void exec_v(vm_context_t& context, DA_MAYBE_UNUSED const asm_inst_t& inst) noexcept {
+	F(context);
+}
+
+template<asm_func_r1_t F>
+inline void exec_r1(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	F(context, inst.rd);
+}
+
+template<asm_func_r2_t F>
+inline void exec_r2(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	F(context, inst.rd, inst.ra);
+}
+
+template<asm_func_r3_t F>
+inline void exec_r3(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	F(context, inst.rd, inst.ra, inst.rb);
+}
+
+template<asm_func_r4_t F>
+inline void exec_r4(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	F(context, inst.rd, inst.ra, inst.rb, regid_t(inst.imm));
+}
+
+// Commands with immediate, the immediate is already extended so use it directly
+
+// R1I1
+inline void exec_lui(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] += inst.imm;
+}
+
+inline void exec_auipc(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = DAVM_PC(context) + inst.imm;
+}
+
+inline void exec_jal(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = DAVM_PC(context);
+	DAVM_PC(context) += inst.imm;
+}
+
+// Immediate operations
+inline void exec_addi(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] + inst.imm;
+}
+
+inline void exec_muli(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] * inst.imm;
+}
+
+inline void exec_slti(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = sregister_t(context.x[inst.ra]) < inst.imm;
+}
+
+inline void exec_sltui(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] < register_t(inst.imm);
+}
+
+inline void exec_andi(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] & inst.imm;
+}
+
+inline void exec_ori(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] | inst.imm;
+}
+
+inline void exec_xori(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] ^ inst.imm;
+}
+
+inline void exec_slli(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] << inst.imm;
+}
+
+inline void exec_srli(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = context.x[inst.ra] >> inst.imm;
+}
+
+inline void exec_srai(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = sregister_t(context.x[inst.ra]) >> inst.imm;
+}
+
+// Load
+inline void exec_lb(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = sext_r<BYTE_BITS>(*reinterpret_cast<byte_t*>(context.x[inst.ra] + inst.imm));
+}
+
+inline void exec_lh(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = sext_r<HWORD_BITS>(*reinterpret_cast<hword_t*>(context.x[inst.ra] + inst.imm));
+}
+
+inline void exec_lw(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = sext_r<WORD_BITS>(*reinterpret_cast<word_t*>(context.x[inst.ra] + inst.imm));
+}
+
+inline void exec_ld(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = *reinterpret_cast<dword_t*>(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_lbu(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = *reinterpret_cast<byte_t*>(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_lhu(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = *reinterpret_cast<hword_t*>(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_lwu(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	context.x[inst.rd] = *reinterpret_cast<word_t*>(context.x[inst.ra] + inst.imm);
+}
+
+// Save
+inline void exec_sb(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	*reinterpret_cast<byte_t*>(context.x[inst.rd]) = byte_t(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_sh(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	*reinterpret_cast<hword_t*>(context.x[inst.rd]) = hword_t(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_sw(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	*reinterpret_cast<word_t*>(context.x[inst.rd]) = word_t(context.x[inst.ra] + inst.imm);
+}
+
+inline void exec_sd(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	*reinterpret_cast<dword_t*>(context.x[inst.rd]) = dword_t(context.x[inst.ra] + inst.imm);
+}
+
+// Branch
+inline void exec_jalr(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	const register_t cra = context.x[inst.ra]; // In case rd == ra
+	context.x[inst.rd]	 = DAVM_PC(context);
+	DAVM_PC(context)	 = cra + inst.imm;
+}
+
+inline void exec_beq(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(context.x[inst.rd] == context.x[inst.ra]) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+inline void exec_bne(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(context.x[inst.rd] != context.x[inst.ra]) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+inline void exec_blt(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(sregister_t(context.x[inst.rd]) < sregister_t(context.x[inst.ra])) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+inline void exec_bge(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(sregister_t(context.x[inst.rd]) >= sregister_t(context.x[inst.ra])) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+inline void exec_bltu(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(context.x[inst.rd] < context.x[inst.ra]) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+inline void exec_bgeu(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	if(context.x[inst.rd] >= context.x[inst.ra]) {
+		DAVM_PC(context) += inst.imm;
+	}
+}
+
+// Vector
+inline void exec_vld(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	std::memcpy(context.v[inst.rd].bytes, reinterpret_cast<const void*>(context.x[inst.ra] + inst.imm), VECTOR_BYTES);
+}
+
+inline void exec_vst(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	std::memcpy(reinterpret_cast<void*>(context.x[inst.ra] + inst.imm), context.v[inst.rd].bytes, VECTOR_BYTES);
+}
+
+template<typename T>
+inline void exec_vext(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	T lane;
+	std::memcpy(&lane, context.v[inst.ra].bytes + inst.imm * sizeof(T), sizeof(T));
+	context.x[inst.rd] = lane;
+}
+
+// Float
+inline void exec_flw(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	word_t value;
+	std::memcpy(&value, reinterpret_cast<const void*>(context.x[inst.ra] + inst.imm), sizeof(value));
+	context.f[inst.rd] = value;
+}
+
+inline void exec_fld(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	std::memcpy(&context.f[inst.rd], reinterpret_cast<const void*>(context.x[inst.ra] + inst.imm), sizeof(dword_t));
+}
+
+inline void exec_fsw(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	const word_t value = word_t(context.f[inst.rd]);
+	std::memcpy(reinterpret_cast<void*>(context.x[inst.ra] + inst.imm), &value, sizeof(value));
+}
+
+inline void exec_fsd(vm_context_t& context, const asm_inst_t& inst) noexcept {
+	std::memcpy(reinterpret_cast<void*>(context.x[inst.ra] + inst.imm), &context.f[inst.rd], sizeof(dword_t));
+}
+
+// Function tables
+// Indexed by op2 like asm_table_*, but without padding as the decoder checks the range
+
+#define DA_X(big, type, small...) exec_v<asm_##small>,
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_v[] = {
+	DA_X_V
+};
+
+#undef DA_X
+#define DA_X(big, type, small...) exec_r1<asm_##small>,
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_r1[] = {
+	DA_X_R1
+};
+
+#undef DA_X
+#define DA_X(big, type, small...) exec_r2<asm_##small>,
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_r2[] = {
+	DA_X_R2
+};
+
+#undef DA_X
+#define DA_X(big, type, small...) exec_r3<asm_##small>,
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_arith[] = {
+	DA_X_ARITH
+};
+
+#undef DA_X
+#define DA_X(big, type, small...) exec_##small,
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_r1i1[] = {
+	DA_X_R1I1
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_load[] = {
+	DA_X_LOAD
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_save[] = {
+	DA_X_SAVE
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_imm[] = {
+	DA_X_IMM
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_imm_shift[] = {
+	DA_X_IMM_SHIFT
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_branch[] = {
+	DA_X_BRANCH
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_vector_memory[] = {
+	DA_X_VECTOR_MEMORY
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_float_memory[] = {
+	DA_X_FLOAT_MEMORY
+};
+
+#undef DA_X
+#define DA_X(big, type, small...) exec_r4<asm_##small>,
+
+// Indexed by (op2 - I_G_FLOAT_FMA_S) * 4 + op3 of asm_cmd_r4_t
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_float_fma[] = {
+	DA_X_FLOAT_FMA
+};
+
+#undef DA_X
+#define DA_X_EXEC_R2(big, type, small...) exec_r2<asm_##small>,
+#define DA_X_EXEC_R3(big, type, small...) exec_r3<asm_##small>,
+#define DA_X_EXEC_R4(big, type, small...) exec_r4<asm_##small>,
+#define DA_X_EXEC(big, type, small...) exec_##small,
+#define DA_X_EXEC_INST_R2 DA_X_EXEC_R2
+#define DA_X_EXEC_INST_R3 DA_X_EXEC_R3
+#define DA_X_EXEC_INST_R4 DA_X_EXEC_R4
+#define DA_X_EXEC_TYPED(big, type, small...) DA_X_EXEC_##type(big, type, small)
+
+// Indexed by op3 of asm_cmd_r3x_t
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_vector[] = {
+	// clang-format off
+#define DA_X DA_X_EXEC_R3
+	DA_X_VECTOR
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_VECTOR_REDUCE
+#undef DA_X
+#define DA_X DA_X_EXEC
+	DA_X_VECTOR_EXTRACT
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_VECTOR_SPLAT
+#undef DA_X
+	// clang-format on
+};
+
+// Indexed by op3 of asm_cmd_r3x_t
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_float[] = {
+	// clang-format off
+#define DA_X DA_X_EXEC_R3
+	DA_X_FLOAT
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_FLOAT_UNARY
+#undef DA_X
+#define DA_X DA_X_EXEC_R3
+	DA_X_FLOAT_COMPARE
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+#undef DA_X
+	// clang-format on
+};
+
+// Indexed by op2 of asm_cmd_r4_t, commands of mixed types
+#define DA_X DA_X_EXEC_TYPED
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_bulk[] = {
+	DA_X_BULK
+};
+
+// Indexed by op3 of asm_cmd_r3x_t
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table_atomic[] = {
+	DA_X_ATOMIC
+};
+#undef DA_X
+
+// Indexed by plain op_t
+DA_MAYBE_UNUSED static constexpr asm_func_t exec_table[] = {
+	exec_error, // OP_UNDECODED
+	exec_error, // OP_ERROR
+	exec_error, // OP_GENERIC, handled by asm_inst_t::func
+	// V
+	exec_v<asm_ret>,
+	exec_v<asm_hlt>,
+	exec_v<asm_ecall>,
+	// R1
+	exec_r1<asm_push>,
+	exec_r1<asm_pop>,
+	exec_r1<asm_call>,
+	// R2
+	exec_r2<asm_mov>,
+	// R1I1
+	exec_lui,
+	exec_auipc,
+	exec_jal,
+	// clang-format off
+#define DA_X DA_X_EXEC_R3
+	DA_X_ARITH
+#undef DA_X
+#define DA_X DA_X_EXEC
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+#undef DA_X
+#define DA_X DA_X_EXEC_R3
+	DA_X_VECTOR
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_VECTOR_REDUCE
+#undef DA_X
+#define DA_X DA_X_EXEC
+	DA_X_VECTOR_EXTRACT
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_VECTOR_SPLAT
+#undef DA_X
+#define DA_X DA_X_EXEC
+	DA_X_FLOAT_MEMORY
+#undef DA_X
+#define DA_X DA_X_EXEC_R4
+	DA_X_FLOAT_FMA
+#undef DA_X
+#define DA_X DA_X_EXEC_R3
+	DA_X_FLOAT
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_FLOAT_UNARY
+#undef DA_X
+#define DA_X DA_X_EXEC_R3
+	DA_X_FLOAT_COMPARE
+#undef DA_X
+#define DA_X DA_X_EXEC_R2
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+#undef DA_X
+#define DA_X DA_X_EXEC_TYPED
+	DA_X_BULK
+	DA_X_ATOMIC
+#undef DA_X
+	// clang-format on
+};
+static_assert(std::size(exec_table) == OP_FUSED);
+
+#undef DA_X_EXEC_R2
+#undef DA_X_EXEC_R3
+#undef DA_X_EXEC_R4
+#undef DA_X_EXEC_INST_R2
+#undef DA_X_EXEC_INST_R3
+#undef DA_X_EXEC_INST_R4
+#undef DA_X_EXEC_TYPED
+#undef DA_X_EXEC
+
+// Fusion
+
+// Check whether a plain command neither reads nor writes pc, only such commands can lead a fused command
+inline constexpr bool is_straight(uint8_t id) noexcept {
+	return (id >= OP_ADD && id < OP_JALR) || (id >= OP_VLD && id < OP_FUSED) || id == OP_PUSH || id == OP_POP || id == OP_MOV || id == OP_LUI;
+}
+
+// Check whether a plain command accesses memory, only such commands can fault
+inline constexpr bool is_access(uint8_t id) noexcept {
+	return (id >= OP_LB && id <= OP_SD) || id == OP_VLD || id == OP_VST || (id >= OP_FLW && id <= OP_FSD) || (id >= OP_MCPY && id <= OP_AMOCASD) || id == OP_PUSH || id == OP_POP || id == OP_CALL || id == OP_RET;
+}
+
+#define DA_X(name, a, b) static_assert(is_straight(OP_##a), "Fused command " #name " must start with a straight command");
+DA_X_FUSED_PAIR
+#undef DA_X
+#define DA_X(name, a, b, c) static_assert(is_straight(OP_##a) && is_straight(OP_##b), "Fused command " #name " must start with straight commands");
+DA_X_FUSED_TRIPLE
+#undef DA_X
+
+/**
+ * @brief  Find the fused command starting at @param inst, longer sequences win
+ * @param  count Count of decoded records from @param inst on
+ * @return The fused op, or the plain op of @param inst if no sequence matches
+ */
+inline uint8_t fuse_inst(const asm_inst_t* inst, size_t count) noexcept {
+#define DA_X(name, a, b, c)                                                               \
+	if(count >= 3 && inst[0].op == OP_##a && inst[1].op == OP_##b && inst[2].op == OP_##c) { \
+		return OP_##name;                                                                 \
+	}
+	DA_X_FUSED_TRIPLE
+#undef DA_X
+#define DA_X(name, a, b)                                             \
+	if(count >= 2 && inst[0].op == OP_##a && inst[1].op == OP_##b) { \
+		return OP_##name;                                            \
+	}
+	DA_X_FUSED_PAIR
+#undef DA_X
+	return inst->op;
+}
+
+// Decoder
+
+/**
+ * @brief  Check whether a command reaches pc through its register operands, or jumps to an unaligned target
+ * @note   Such commands can only be executed by asm_inst_t::func with pc synced
+ */
+inline bool is_irregular(const asm_inst_t& inst) noexcept {
+	if(inst.id == OP_JAL || (inst.id >= OP_BEQ && inst.id <= OP_BGEU)) {
+		DA_IF_UNLIKELY(inst.imm & (sizeof(word_t) - 1)) {
+			return true;
+		}
+	}
+	// Only operands in x can be pc
+	const op_files_t files = op_files[inst.id];
+	switch(op_type[inst.id]) {
+	case INST_R4:
+		DA_IF_UNLIKELY(inst.imm == 0 && files.rb == FILE_X) {
+			return true;
+		}
+		[[fallthrough]];
+	case INST_R3:
+		DA_IF_UNLIKELY(inst.rb == 0 && files.rb == FILE_X) {
+			return true;
+		}
+		[[fallthrough]];
+	case INST_R2:
+	case INST_R2I1:
+		DA_IF_UNLIKELY(inst.ra == 0 && files.ra == FILE_X) {
+			return true;
+		}
+		[[fallthrough]];
+	case INST_R1:
+	case INST_R1I1:
+		return inst.rd == 0 && files.rd == FILE_X;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief  Decode one command into its predecoded form, without checking @ref is_irregular
+ * @param  code The raw command
+ * @return The predecoded command, with id OP_ERROR and the raw code as immediate if @param code is invalid, never fused
+ * @note   Immediates are extended the same way as the matching asm_* function does, so handlers never touch the raw bits
+ */
+inline asm_inst_t decode_plain(word_t code) noexcept {
+	asm_inst_t inst = { exec_error, sregister_t(code), OP_ERROR, 0, 0, 0 };
+	switch(code & 0x7F) { // Bit 6 - 0 is opcode
+	case I_G_ARITH: {
+		const asm_cmd_r3_t cmd = *DAVM_CAST(asm_cmd_r3_t*, &code);
+		DA_IF_LIKELY(cmd.op2 < std::size(exec_table_arith)) {
+			inst = { exec_table_arith[cmd.op2], 0, uint8_t(OP_ADD + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+		}
+		break;
+	}
+	case I_G_LOAD: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_LIKELY(cmd.op2 < std::size(exec_table_load)) {
+			inst = { exec_table_load[cmd.op2], sext_s(cmd.imm), uint8_t(OP_LB + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_SAVE: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_LIKELY(cmd.op2 < std::size(exec_table_save)) {
+			inst = { exec_table_save[cmd.op2], sext_s(cmd.imm), uint8_t(OP_SB + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_IMM: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_UNLIKELY(cmd.op2 == I_G_IMM_SHIFT) {
+			const asm_cmd_imm_shift_t cmd = *DAVM_CAST(asm_cmd_imm_shift_t*, &code);
+			DA_IF_LIKELY(cmd.op3 < std::size(exec_table_imm_shift)) {
+				inst = { exec_table_imm_shift[cmd.op3], sregister_t(cmd.imm), uint8_t(OP_SLLI + cmd.op3), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+			}
+		} else {
+			// ADDI, MULI & SLTI take signed immediate, others take unsigned
+			const sregister_t imm = cmd.op2 <= I_SLTI ? sext_s(cmd.imm) : sregister_t(cmd.imm);
+			inst				  = { exec_table_imm[cmd.op2], imm, uint8_t(OP_ADDI + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_BRANCH: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_LIKELY(cmd.op2 < std::size(exec_table_branch)) {
+			inst = { exec_table_branch[cmd.op2], sext_s(cmd.imm) << 1, uint8_t(OP_JALR + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_VECTOR: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_LIKELY(cmd.op2 == I_G_VECTOR_R3) {
+			const asm_cmd_r3x_t cmd = *DAVM_CAST(asm_cmd_r3x_t*, &code);
+			const uint8_t		   op  = uint8_t(OP_VADDB + cmd.op3);
+			if(op >= OP_VEXTB && op <= OP_VEXTD) { // The lane is in rb
+				DA_IF_LIKELY(cmd.rb < VECTOR_BYTES >> (op - OP_VEXTB)) {
+					inst = { exec_table_vector[cmd.op3], sregister_t(cmd.rb), op, uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+				}
+			} else if(cmd.op3 < std::size(exec_table_vector)) {
+				inst = { exec_table_vector[cmd.op3], 0, op, uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+			}
+		} else if(cmd.op2 < std::size(exec_table_vector_memory)) {
+			inst = { exec_table_vector_memory[cmd.op2], sext_s(cmd.imm), uint8_t(OP_VLD + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_FLOAT: {
+		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
+		DA_IF_LIKELY(cmd.op2 == I_G_FLOAT_R3) {
+			const asm_cmd_r3x_t cmd = *DAVM_CAST(asm_cmd_r3x_t*, &code);
+			DA_IF_LIKELY(cmd.op3 < std::size(exec_table_float)) {
+				inst = { exec_table_float[cmd.op3], 0, uint8_t(OP_FADDS + cmd.op3), uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+			}
+		} else if(cmd.op2 == I_G_FLOAT_FMA_S || cmd.op2 == I_G_FLOAT_FMA_D) { // rc is kept in the immediate
+			const asm_cmd_r4_t cmd = *DAVM_CAST(asm_cmd_r4_t*, &code);
+			const uint32_t	   id  = (cmd.op2 - I_G_FLOAT_FMA_S) * 4 + cmd.op3;
+			inst				   = { exec_table_float_fma[id], sregister_t(cmd.rc), uint8_t(OP_FMADDS + id), uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+		} else if(cmd.op2 < std::size(exec_table_float_memory)) {
+			inst = { exec_table_float_memory[cmd.op2], sext_s(cmd.imm), uint8_t(OP_FLW + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		}
+		break;
+	}
+	case I_G_BULK: { // rc is kept in the immediate
+		const asm_cmd_r4_t cmd = *DAVM_CAST(asm_cmd_r4_t*, &code);
+		DA_IF_UNLIKELY(cmd.op2 == I_G_BULK_ATOMIC) {
+			const asm_cmd_r3x_t cmd = *DAVM_CAST(asm_cmd_r3x_t*, &code);
+			DA_IF_LIKELY(cmd.op3 < std::size(exec_table_atomic)) {
+				inst = { exec_table_atomic[cmd.op3], 0, uint8_t(OP_LRW + cmd.op3), uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+			}
+		} else if(cmd.op2 < std::size(exec_table_bulk) && cmd.op3 == 0) {
+			inst = { exec_table_bulk[cmd.op2], sregister_t(cmd.rc), uint8_t(OP_MCPY + cmd.op2), uint8_t(cmd.rd), uint8_t(cmd.ra), uint8_t(cmd.rb) };
+		}
+		break;
+	}
+	default: { // Deal with unique id
+		const uint32_t op = code & 0x7F;
+		if((op >> 3) == 1) { // void call
+			const asm_cmd_v_t cmd = *DAVM_CAST(asm_cmd_v_t*, &code);
+			DA_IF_LIKELY(cmd.op2 < std::size(exec_table_v)) {
+				inst = { exec_table_v[cmd.op2], 0, uint8_t(OP_RET + cmd.op2), 0, 0, 0 };
+			}
+		} else if((op >> 3) == 2) { // r1 call
+			const asm_cmd_r1_t cmd = *DAVM_CAST(asm_cmd_r1_t*, &code);
+			DA_IF_LIKELY(cmd.op2 < std::size(exec_table_r1)) {
+				inst = { exec_table_r1[cmd.op2], 0, uint8_t(OP_PUSH + cmd.op2), uint8_t(cmd.rd), 0, 0 };
+			}
+		} else if(op - I_MOV < std::size(exec_table_r2)) { // r2 call
+			const asm_cmd_r2_t cmd = *DAVM_CAST(asm_cmd_r2_t*, &code);
+			inst				   = { exec_table_r2[op - I_MOV], 0, uint8_t(OP_MOV + op - I_MOV), uint8_t(cmd.rd), uint8_t(cmd.ra), 0 };
+		} else if(op - I_LUI < std::size(exec_table_r1i1)) { // r1i1 call
+			const asm_cmd_r1i1_t cmd = *DAVM_CAST(asm_cmd_r1i1_t*, &code);
+			// LUI & AUIPC take the upper 20 bits, JAL takes signed offset
+			const sregister_t imm = op == I_JAL ? sext_l(cmd.imm) << 1 : sregister_t(word_t(cmd.imm << 12));
+			inst				  = { exec_table_r1i1[op - I_LUI], imm, uint8_t(OP_LUI + op - I_LUI), uint8_t(cmd.rd), 0, 0 };
+		}
+	}
+	}
+	inst.op = inst.id;
+	return inst;
+}
+
+/**
+ * @brief  Text of @param code as `0XCODE\tNAME\toperands\n`, see dissemble_inst()
+ * @note   Allocates, dissemble() in vm/assembler.h writes many commands at once
+ */
+inline std::string dissemble_command(word_t code) {
+	char  line[DISSEMBLE_INST + 16] = { '0', 'X' };
+	char* end						= dissemble_hex(line + 2, code, 8);
+	*end++							= '\t';
+	const asm_inst_t inst			= decode_plain(code);
+	DA_IF_UNLIKELY(inst.op == OP_ERROR) {
+		constexpr std::string_view error = "ERROR COMMAND";
+		end								 = std::copy(error.begin(), error.end(), end);
+	} else {
+		end = dissemble_inst(end, inst);
+	}
+	*end++ = '\n';
+	return std::string(line, end);
+}
+
+/**
+ * @brief  Decode one command into its predecoded form
+ * @return Same as @ref decode_plain, but with id OP_GENERIC if @ref is_irregular
+ */
+inline asm_inst_t decode_inst(word_t code) noexcept {
+	asm_inst_t inst = decode_plain(code);
+	DA_IF_UNLIKELY(inst.id != OP_ERROR && is_irregular(inst)) {
+		inst.id = inst.op = OP_GENERIC;
+	}
+	return inst;
+}
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_COMMON_DECODE_H_
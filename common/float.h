@@ -0,0 +1,283 @@
+/**
+ * @file      float.h
+ * @brief     Floating point assembler functions, on SSE2 & FMA when the host has them
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_COMMON_FLOAT_H_
+#define _DAVM_COMMON_FLOAT_H_
+
+#include <common/pch.h>
+#include <common/asm.h>
+#include <common/type.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// Arithmetic on float & double already compiles to scalar SSE2 on x86-64, intrinsics only avoid the errno path of std::sqrt.
+// std::fma is one instruction when the compiler targets FMA, see DAVM_NATIVE, other builds check the CPU for it at startup
+#if DA_COMP_GNU && defined(__x86_64__) && defined(__SSE2__)
+	#define DA_FLOAT_SSE2 1
+	#include <immintrin.h>
+#else
+	#define DA_FLOAT_SSE2 0
+#endif
+
+BEGIN_DA_NAMESPACE
+
+// A register holds a double, or a single in its low 32 bits with the high bits cleared
+
+template<typename T>
+DA_ALWAYS_INLINE T float_get(dword_t bits) noexcept {
+	static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+	if constexpr(std::is_same_v<T, float>) {
+		const word_t low = word_t(bits);
+		float		 ret;
+		std::memcpy(&ret, &low, sizeof(ret));
+		return ret;
+	} else {
+		double ret;
+		std::memcpy(&ret, &bits, sizeof(ret));
+		return ret;
+	}
+}
+
+template<typename T>
+DA_ALWAYS_INLINE dword_t float_bits(T value) noexcept {
+	if constexpr(std::is_same_v<T, float>) {
+		word_t ret;
+		std::memcpy(&ret, &value, sizeof(ret));
+		return ret;
+	} else {
+		dword_t ret;
+		std::memcpy(&ret, &value, sizeof(ret));
+		return ret;
+	}
+}
+
+// fd = f(fa, fb)
+template<typename T, typename F>
+DA_ALWAYS_INLINE void float_map(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, F f) noexcept {
+	context.f[rd] = float_bits<T>(f(float_get<T>(context.f[ra]), float_get<T>(context.f[rb])));
+}
+
+// Arithmetic, rounded to nearest even as the host keeps it
+
+template<typename T>
+inline void asm_fadd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a + b; });
+}
+
+template<typename T>
+inline void asm_fsub(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a - b; });
+}
+
+template<typename T>
+inline void asm_fmul(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a * b; });
+}
+
+template<typename T>
+inline void asm_fdiv(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a / b; });
+}
+
+// As MINSS & MAXSS, fb if either is NaN or both are zeros
+template<typename T>
+inline void asm_fmin(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a < b ? a : b; });
+}
+
+template<typename T>
+inline void asm_fmax(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	float_map<T>(context, rd, ra, rb, [](T a, T b) { return a > b ? a : b; });
+}
+
+// fd = (±fa) * fb + (±fc) rounded once
+template<typename T, bool NegA, bool NegC>
+DA_ALWAYS_INLINE void float_muladd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	const T a = float_get<T>(context.f[ra]), c = float_get<T>(context.f[rc]);
+	context.f[rd] = float_bits<T>(std::fma(NegA ? -a : a, float_get<T>(context.f[rb]), NegC ? -c : c));
+}
+
+#if DA_FLOAT_SSE2 && !defined(__FMA__)
+// Whether the CPU & the OS support FMA, chosen once at startup
+inline bool float_detect_fma() noexcept {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("fma");
+}
+
+inline const bool float_fma3 = float_detect_fma();
+
+// std::fma becomes one instruction here, with the signs folded into it
+template<typename T, bool NegA, bool NegC>
+__attribute__((target("fma"))) inline void float_muladd_fma3(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	float_muladd<T, NegA, NegC>(context, rd, ra, rb, rc);
+}
+#endif
+
+// Jumps to float_muladd_fma3() when the CPU has FMA
+template<typename T, bool NegA, bool NegC>
+DA_ALWAYS_INLINE void float_fma(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+#if DA_FLOAT_SSE2 && !defined(__FMA__)
+	DA_IF_LIKELY(float_fma3) {
+		return float_muladd_fma3<T, NegA, NegC>(context, rd, ra, rb, rc);
+	}
+#endif
+	float_muladd<T, NegA, NegC>(context, rd, ra, rb, rc);
+}
+
+template<typename T>
+inline void asm_fmadd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	float_fma<T, false, false>(context, rd, ra, rb, rc);
+}
+
+template<typename T>
+inline void asm_fmsub(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	float_fma<T, false, true>(context, rd, ra, rb, rc);
+}
+
+template<typename T>
+inline void asm_fnmadd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	float_fma<T, true, true>(context, rd, ra, rb, rc);
+}
+
+template<typename T>
+inline void asm_fnmsub(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb, regid_t rc) noexcept {
+	float_fma<T, true, false>(context, rd, ra, rb, rc);
+}
+
+template<typename T>
+inline void asm_fsqrt(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	const T a = float_get<T>(context.f[ra]);
+#if DA_FLOAT_SSE2
+	if constexpr(std::is_same_v<T, float>) {
+		context.f[rd] = float_bits(_mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(a))));
+	} else {
+		const __m128d v = _mm_set_sd(a);
+		context.f[rd]	= float_bits(_mm_cvtsd_f64(_mm_sqrt_sd(v, v)));
+	}
+#else
+	context.f[rd] = float_bits<T>(std::sqrt(a));
+#endif
+}
+
+inline void asm_fcvtsd(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.f[rd] = float_bits(float(float_get<double>(context.f[ra])));
+}
+
+inline void asm_fcvtds(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.f[rd] = float_bits(double(float_get<float>(context.f[ra])));
+}
+
+// Compares, false if either is NaN
+
+template<typename T>
+inline void asm_feq(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	context.x[rd] = float_get<T>(context.f[ra]) == float_get<T>(context.f[rb]);
+}
+
+template<typename T>
+inline void asm_flt(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	context.x[rd] = float_get<T>(context.f[ra]) < float_get<T>(context.f[rb]);
+}
+
+template<typename T>
+inline void asm_fle(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	context.x[rd] = float_get<T>(context.f[ra]) <= float_get<T>(context.f[rb]);
+}
+
+// Moves between files
+
+// Truncate toward zero, NaN & out of range values give INT64_MIN as CVTTSD2SI, checked here as compilers fold the intrinsic otherwise
+template<typename T>
+inline void asm_fcvtl(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	constexpr T LIMIT = T(9223372036854775808.0); // 2^63
+	const T		a	  = float_get<T>(context.f[ra]);
+	DA_IF_LIKELY(a >= -LIMIT && a < LIMIT) {
+		context.x[rd] = register_t(sregister_t(a));
+	} else {
+		context.x[rd] = register_t(std::numeric_limits<sregister_t>::min());
+	}
+}
+
+inline void asm_fcvtsl(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.f[rd] = float_bits(float(sregister_t(context.x[ra])));
+}
+
+inline void asm_fcvtdl(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.f[rd] = float_bits(double(sregister_t(context.x[ra])));
+}
+
+inline void asm_fmvxd(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.x[rd] = context.f[ra];
+}
+
+inline void asm_fmvdx(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.f[rd] = context.x[ra];
+}
+
+// Memory, fd at xa + imm like VLD & VST
+
+inline void asm_flw(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	word_t value;
+	std::memcpy(&value, reinterpret_cast<const void*>(context.x[ra] + sext_s(imm)), sizeof(value));
+	context.f[rd] = value;
+}
+
+inline void asm_fld(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	std::memcpy(&context.f[rd], reinterpret_cast<const void*>(context.x[ra] + sext_s(imm)), sizeof(dword_t));
+}
+
+inline void asm_fsw(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	const word_t value = word_t(context.f[rd]);
+	std::memcpy(reinterpret_cast<void*>(context.x[ra] + sext_s(imm)), &value, sizeof(value));
+}
+
+inline void asm_fsd(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	std::memcpy(reinterpret_cast<void*>(context.x[ra] + sext_s(imm)), &context.f[rd], sizeof(dword_t));
+}
+
+// Function tables, not padded as decode_plain() checks the range
+
+#define DA_X(big, type, small...) asm_##small,
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2i1_t asm_table_float_memory[] = {
+	DA_X_FLOAT_MEMORY
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r4_t asm_table_float_fma[] = {
+	DA_X_FLOAT_FMA
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r3_t asm_table_float[] = {
+	DA_X_FLOAT
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2_t asm_table_float_unary[] = {
+	DA_X_FLOAT_UNARY
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r3_t asm_table_float_compare[] = {
+	DA_X_FLOAT_COMPARE
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2_t asm_table_float_to_x[] = {
+	DA_X_FLOAT_TO_X
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2_t asm_table_float_from_x[] = {
+	DA_X_FLOAT_FROM_X
+};
+
+#undef DA_X
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_COMMON_FLOAT_H_
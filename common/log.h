@@ -14,6 +14,19 @@
 #include <common/reflect.h>
 #include <common/type.h>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 BEGIN_DA_NAMESPACE
 
 enum loglevel {
@@ -29,57 +42,440 @@ enum loglevel {
 #define DEFAULT_LOG_LEVEL LOG_DEBUG
 #endif
 
-inline void print_registers(vm_context_t& context) {
-	std::string s = "Registers:\n";
-	for(int i = 0; i < 32; ++i) {
-		s += fmt::format("{0:<3} : {1:#018X}", reg_name[i], context.x[i]);
-		s += ((i + 1) & 0b11) ? '\t' : '\n';
+// Compiled in level, calls of DAVM_LOG below it are discarded at compile time
+#ifndef DAVM_LOG_LEVEL
+	#define DAVM_LOG_LEVEL DEFAULT_LOG_LEVEL
+#endif
+
+DA_MAYBE_UNUSED static constexpr const char* log_level_name[] = {
+	"DEBUG",
+	"INFO",
+	"WARNING",
+	"ERROR",
+};
+
+// Asynchronous logger
+// Threads append fixed size binary records to their own ring, a writer thread formats them
+
+inline constexpr size_t LOG_ARGS	 = 12; // Arguments of a record at most
+inline constexpr size_t LOG_RING	 = 1024; // Records buffered per thread, a power of two
+inline constexpr auto	LOG_INTERVAL = std::chrono::milliseconds(1); // Sleep of the writer while every ring is empty
+
+enum log_arg_kind_t : uint8_t {
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_BOOL,
+	LOG_ARG_CHAR,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING, // const char*, which must outlive the logger, e.g. a literal
+	LOG_ARG_POINTER,
+};
+
+template<typename T>
+inline constexpr log_arg_kind_t log_arg_kind() noexcept {
+	if constexpr(std::is_same_v<T, bool>) {
+		return LOG_ARG_BOOL;
+	} else if constexpr(std::is_same_v<T, char>) {
+		return LOG_ARG_CHAR;
+	} else if constexpr(std::is_enum_v<T>) {
+		return log_arg_kind<std::underlying_type_t<T>>();
+	} else if constexpr(std::is_integral_v<T>) {
+		return std::is_signed_v<T> ? LOG_ARG_INT : LOG_ARG_UINT;
+	} else if constexpr(std::is_floating_point_v<T>) {
+		return LOG_ARG_DOUBLE;
+	} else if constexpr(std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+		return LOG_ARG_STRING;
+	} else {
+		static_assert(std::is_pointer_v<T>, "Only integers, floats, C strings & pointers can be logged");
+		return LOG_ARG_POINTER;
 	}
-	// Buffer the output
-	std::printf("%s", s.c_str());
 }
 
-inline std::string dissemble_command(uint32_t code) {
-	std::string ret = fmt::format("{0:#010X}\t", code);
-	switch(code & 0x7F) {
-	case I_G_ARITH: {
-		const asm_cmd_r3_t cmd = *DAVM_CAST(asm_cmd_r3_t*, &code);
-		ret += fmt::format("{0}\t{1}, {2}, {3}\n", asm_name_arith[cmd.op2], reg_name[cmd.rd], reg_name[cmd.ra], reg_name[cmd.rb]);
-		break;
+// Two cache lines, arguments are stored as 64-bit values & their kinds as 4-bit each
+struct alignas(128) log_record_t {
+	uint64_t	time; // Nanoseconds of std::chrono::steady_clock
+	const char* format; // Static, in the syntax of fmt::format
+	uint8_t		level;
+	uint8_t		count;
+	uint8_t		kinds[LOG_ARGS / 2];
+	uint64_t	args[LOG_ARGS];
+
+	template<typename T>
+	void set(size_t i, const T& value) noexcept {
+		using U					 = std::decay_t<T>;
+		constexpr uint8_t kind	 = log_arg_kind<U>();
+		kinds[i / 2]			 = uint8_t(kinds[i / 2] | kind << (i % 2 * 4));
+		if constexpr(kind == LOG_ARG_DOUBLE) {
+			const double bits = double(value);
+			std::memcpy(&args[i], &bits, sizeof(bits));
+		} else if constexpr(kind == LOG_ARG_STRING || kind == LOG_ARG_POINTER) {
+			args[i] = uint64_t(reinterpret_cast<uintptr_t>(value));
+		} else if constexpr(kind == LOG_ARG_INT) {
+			args[i] = uint64_t(int64_t(value));
+		} else {
+			args[i] = uint64_t(value);
+		}
 	}
-	case I_G_LOAD: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		ret += fmt::format("{0}\t{1}, {2}, {3}\n", asm_name_load[cmd.op2], reg_name[cmd.rd], reg_name[cmd.ra], cmd.imm);
-		break;
+
+	log_arg_kind_t kind(size_t i) const noexcept {
+		return log_arg_kind_t(kinds[i / 2] >> (i % 2 * 4) & 0xF);
 	}
-	case I_G_SAVE: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		ret += fmt::format("{0}\t{1}, {2}, {3}\n", asm_name_save[cmd.op2], reg_name[cmd.rd], reg_name[cmd.ra], cmd.imm);
-		break;
+};
+
+// Records of one thread, filled by it & emptied by the writer
+struct log_ring_t {
+	alignas(64) std::atomic<uint64_t> head { 0 }; // Next record to write out
+	alignas(64) std::atomic<uint64_t> tail { 0 }; // Next record to fill
+	std::atomic<bool> owned { true }; // Whether a thread fills it, a released ring is given to the next new thread
+	uint32_t		  id; // Written as T<id>
+	log_record_t	  records[LOG_RING];
+};
+
+/**
+ * @brief Process wide logger, see DAVM_LOG
+ *
+ * Logging never blocks: a record is dropped & counted if the ring of the thread is full.
+ * The writer thread starts with the first record & writes everything left at exit.
+ */
+class logger_t {
+	std::mutex								 m_mutex; // Held by whoever empties the rings
+	std::vector<std::unique_ptr<log_ring_t>> m_rings;
+	std::FILE*								 m_output = stderr;
+	std::atomic<uint64_t>					 m_dropped { 0 };
+	std::atomic<bool>						 m_stop { false };
+	const uint64_t							 m_start;
+	std::thread								 m_thread;
+
+	// Holds the ring of a thread, released when the thread exits
+	struct handle_t {
+		log_ring_t* ring;
+
+		handle_t()
+			: ring(instance().attach()) { }
+
+		~handle_t() {
+			ring->owned.store(false, std::memory_order_release);
+		}
+	};
+
+	logger_t()
+		: m_start(now())
+		, m_thread([this] { run(); }) { }
+
+	log_ring_t* attach() {
+		std::lock_guard lock(m_mutex);
+		for(const std::unique_ptr<log_ring_t>& ring : m_rings) {
+			bool owned = false;
+			if(ring->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+				return ring.get();
+			}
+		}
+		m_rings.push_back(std::make_unique<log_ring_t>());
+		m_rings.back()->id = uint32_t(m_rings.size() - 1);
+		return m_rings.back().get();
 	}
-	case I_G_IMM: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		DA_IF_UNLIKELY(cmd.op2 == I_G_IMM_SHIFT) {
-			const asm_cmd_imm_shift_t cmd = *DAVM_CAST(asm_cmd_imm_shift_t*, &code);
-			ret += fmt::format("{0}\t{1}, {2}, {3}\n", asm_name_imm_shift[cmd.op2], reg_name[cmd.rd], reg_name[cmd.ra], cmd.imm);
-		} else {
-			ret += fmt::format("{0}\t{1}, {2}, {3}\n", asm_name_imm[cmd.op2], reg_name[cmd.rd], reg_name[cmd.ra], cmd.imm);
+
+	void run() {
+		while(!m_stop.load(std::memory_order_acquire)) {
+			std::unique_lock lock(m_mutex);
+			if(!drain()) {
+				std::fflush(m_output);
+				lock.unlock();
+				std::this_thread::sleep_for(LOG_INTERVAL);
+			}
 		}
-		break;
+		std::lock_guard lock(m_mutex);
+		drain();
+		std::fflush(m_output);
 	}
-	default: { // Deal with unique id
-		if(code & 0x08) { // void call
-			const asm_cmd_v_t cmd = *DAVM_CAST(asm_cmd_v_t*, &code);
-			ret += asm_name_v[cmd.op2];
-		} else if(code & 0x10) { // r1 call
-			const asm_cmd_r1_t cmd = *DAVM_CAST(asm_cmd_r1_t*, &code);
-			ret += fmt::format("{0}\t{1}\n", asm_name_r1[cmd.op2], reg_name[cmd.rd]);
-		} else {
-			ret += "ERROR COMMAND\n";
+
+	// Write out every record in the rings with m_mutex held, @return Whether any is written
+	bool drain() {
+		bool		written = false;
+		std::string line;
+		for(const std::unique_ptr<log_ring_t>& ring : m_rings) {
+			const uint64_t tail = ring->tail.load(std::memory_order_acquire);
+			uint64_t	   head = ring->head.load(std::memory_order_relaxed);
+			if(head == tail) {
+				continue;
+			}
+			for(; head != tail; ++head) {
+				format(line, *ring, ring->records[head % LOG_RING]);
+				std::fwrite(line.data(), 1, line.size(), m_output);
+			}
+			ring->head.store(head, std::memory_order_release);
+			written = true;
+		}
+		if(const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed)) {
+			line = fmt::format("[{:>14.6f}] {:<7} {} records dropped as rings were full\n", double(now() - m_start) / 1e9, "WARNING", dropped);
+			std::fwrite(line.data(), 1, line.size(), m_output);
+		}
+		return written;
+	}
+
+	// Format argument @param i of @param record with @param spec, e.g. "{:#x}"
+	static void format_arg(std::string& out, std::string_view spec, const log_record_t& record, size_t i) {
+		const uint64_t bits = record.args[i];
+		switch(record.kind(i)) {
+		case LOG_ARG_INT: {
+			const int64_t value = int64_t(bits);
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+			break;
+		}
+		case LOG_ARG_UINT: {
+			out += fmt::vformat(spec, fmt::make_format_args(bits));
+			break;
+		}
+		case LOG_ARG_BOOL: {
+			const bool value = bits != 0;
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+			break;
+		}
+		case LOG_ARG_CHAR: {
+			const char value = char(bits);
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+			break;
+		}
+		case LOG_ARG_DOUBLE: {
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+			break;
+		}
+		case LOG_ARG_STRING: {
+			const char* value = reinterpret_cast<const char*>(uintptr_t(bits));
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+			break;
+		}
+		default: {
+			const void* value = reinterpret_cast<const void*>(uintptr_t(bits));
+			out += fmt::vformat(spec, fmt::make_format_args(value));
+		}
+		}
+	}
+
+	// Text of @param record as one line into @param line, arguments are formatted one by one
+	void format(std::string& line, const log_ring_t& ring, const log_record_t& record) const {
+		line = fmt::format("[{:>14.6f}] {:<7} T{:<3} ", double(record.time - m_start) / 1e9, log_level_name[record.level], ring.id);
+		size_t next = 0;
+		for(const char* p = record.format; *p;) {
+			if((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}')) {
+				line += *p;
+				p += 2;
+			} else if(*p == '{') {
+				const char* end = std::strchr(p, '}');
+				if(!end) {
+					break;
+				}
+				// Optional argument id, then the spec after ':'
+				const char* colon = std::find(p, end, ':');
+				size_t		index = next++;
+				if(colon != p + 1) {
+					std::from_chars(p + 1, colon, index);
+				}
+				const std::string spec = "{" + std::string(colon, end) + "}";
+				try {
+					DA_IF_LIKELY(index < record.count) {
+						format_arg(line, spec, record, index);
+					} else {
+						line += "{?}";
+					}
+				} catch(...) { // Bad spec
+					line += "{?}";
+				}
+				p = end + 1;
+			} else {
+				line += *p++;
+			}
+		}
+		line += '\n';
+	}
+
+public:
+	~logger_t() {
+		m_stop.store(true, std::memory_order_release);
+		m_thread.join();
+	}
+
+	logger_t(const logger_t&)			 = delete;
+	logger_t& operator=(const logger_t&) = delete;
+
+	static logger_t& instance() {
+		static logger_t logger;
+		return logger;
+	}
+
+	static uint64_t now() noexcept {
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// Ring of the calling thread
+	static log_ring_t& ring() {
+		static thread_local handle_t handle;
+		return *handle.ring;
+	}
+
+	// Append a record to the ring of the calling thread, or drop it if the ring is full
+	template<size_t N, typename... Args>
+	void write(loglevel level, const char (&format)[N], const Args&... args) noexcept {
+		static_assert(sizeof...(Args) <= LOG_ARGS, "Too many arguments to log");
+		log_ring_t&	   ring = this->ring();
+		const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+		DA_IF_UNLIKELY(tail - ring.head.load(std::memory_order_acquire) == LOG_RING) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
+		log_record_t& record = ring.records[tail % LOG_RING];
+		record.time			 = now();
+		record.format		 = format;
+		record.level		 = uint8_t(level);
+		record.count		 = uint8_t(sizeof...(Args));
+		std::memset(record.kinds, 0, sizeof(record.kinds));
+		size_t i = 0;
+		(record.set(i++, args), ...);
+		ring.tail.store(tail + 1, std::memory_order_release);
+	}
+
+	// Write out every record logged so far, on the calling thread
+	void flush() {
+		std::lock_guard lock(m_mutex);
+		drain();
+		std::fflush(m_output);
+	}
+
+	// Where records are written, stderr by default
+	void set_output(std::FILE* output) {
+		std::lock_guard lock(m_mutex);
+		drain();
+		std::fflush(m_output);
+		m_output = output;
+	}
+};
+
+/**
+ * @brief Log @param format with fmt::format syntax & up to LOG_ARGS arguments, if @param level is at least DAVM_LOG_LEVEL
+ * @note  @param format must be a literal, C strings among the arguments must outlive the logger too,
+ *        as they are formatted later by the writer thread
+ */
+#define DAVM_LOG(level, ...)                                      \
+	do {                                                         \
+		if constexpr((level) >= DAVM_LOG_LEVEL) {                \
+			_DA_NS logger_t::instance().write(level, __VA_ARGS__); \
+		}                                                        \
+	} while(0)
+
+#define DAVM_LOG_DEBUG(...)	  DAVM_LOG(_DA_NS LOG_DEBUG, __VA_ARGS__)
+#define DAVM_LOG_INFO(...)	  DAVM_LOG(_DA_NS LOG_INFO, __VA_ARGS__)
+#define DAVM_LOG_WARNING(...) DAVM_LOG(_DA_NS LOG_WARNING, __VA_ARGS__)
+#define DAVM_LOG_ERROR(...)	  DAVM_LOG(_DA_NS LOG_ERROR, __VA_ARGS__)
+
+// Log every register at LOG_ERROR, 4 per record
+inline void print_registers(const vm_context_t& context) {
+	DAVM_LOG_ERROR("Registers:");
+	for(size_t i = 0; i < std::size(context.x); i += 4) {
+		DAVM_LOG_ERROR("{:<3} : {:#018X}\t{:<3} : {:#018X}\t{:<3} : {:#018X}\t{:<3} : {:#018X}",
+					   reg_name[i], context.x[i], reg_name[i + 1], context.x[i + 1], reg_name[i + 2], context.x[i + 2], reg_name[i + 3], context.x[i + 3]);
+	}
+}
+
+inline constexpr size_t DISSEMBLE_INST = 40; // Longest text written by dissemble_inst(), besides the jump target
+
+// Names of plain op_t & registers as views, so that they are copied without scanning
+struct dissemble_names_t {
+	std::string_view op[std::size(op_name)];
+	std::string_view reg[std::size(reg_name)];
+	std::string_view vreg[std::size(vreg_name)];
+	std::string_view freg[std::size(freg_name)];
+
+	constexpr dissemble_names_t() noexcept
+		: op {}
+		, reg {}
+		, vreg {}
+		, freg {} {
+		for(size_t i = 0; i < std::size(op_name); ++i) {
+			op[i] = op_name[i];
+		}
+		for(size_t i = 0; i < std::size(reg_name); ++i) {
+			reg[i] = reg_name[i];
+		}
+		for(size_t i = 0; i < std::size(vreg_name); ++i) {
+			vreg[i] = vreg_name[i];
+		}
+		for(size_t i = 0; i < std::size(freg_name); ++i) {
+			freg[i] = freg_name[i];
+		}
+	}
+};
+
+inline constexpr dissemble_names_t dissemble_names;
+
+// Write @param value as @param digits upper case hexadecimal digits, @return End of the text
+inline char* dissemble_hex(char* out, uint64_t value, size_t digits) noexcept {
+	for(size_t i = digits; i-- > 0; value >>= 4) {
+		out[i] = "0123456789ABCDEF"[value & 0xF];
+	}
+	return out + digits;
+}
+
+/**
+ * @brief  Write the text of plain command @param inst predecoded by decode_plain(), as `NAME\trd, ra, imm`
+ * @param  target Written instead of the offset of JAL & branches but JALR if not empty, e.g. a label
+ * @return End of the text, at most DISSEMBLE_INST + @param target .size() chars after @param out
+ * @note   Operands are written as the assembler takes them: offsets of jumps in bytes from the following command,
+ *         the 20-bit field of LUI & AUIPC in hexadecimal, other immediates as extended by the command
+ */
+inline char* dissemble_inst(char* out, const asm_inst_t& inst, std::string_view target = {}) noexcept {
+	auto put = [&](std::string_view text) {
+		std::memcpy(out, text.data(), text.size());
+		out += text.size();
+	};
+	auto reg = [&](reg_file_t file, uint8_t id, bool last) {
+		put(file == FILE_V ? dissemble_names.vreg[id] : file == FILE_F ? dissemble_names.freg[id] : dissemble_names.reg[id]);
+		if(!last) {
+			put(", ");
+		}
+	};
+	const op_files_t files = op_files[inst.op];
+	put(dissemble_names.op[inst.op]);
+	*out++ = '\t';
+	switch(op_type[inst.op]) {
+	case INST_V:
+		return out - 1; // No operand, drop the tab
+	case INST_R1:
+		reg(files.rd, inst.rd, true);
+		return out;
+	case INST_R2:
+		reg(files.rd, inst.rd, false);
+		reg(files.ra, inst.ra, true);
+		return out;
+	case INST_R3:
+		reg(files.rd, inst.rd, false);
+		reg(files.ra, inst.ra, false);
+		reg(files.rb, inst.rb, true);
+		return out;
+	case INST_R4:
+		reg(files.rd, inst.rd, false);
+		reg(files.ra, inst.ra, false);
+		reg(files.rb, inst.rb, false);
+		reg(files.rb, uint8_t(inst.imm), true);
+		return out;
+	case INST_R1I1:
+		reg(files.rd, inst.rd, false);
+		break;
+	case INST_R2I1:
+		reg(files.rd, inst.rd, false);
+		reg(files.ra, inst.ra, false);
+		break;
+	}
+	if(inst.op == OP_LUI || inst.op == OP_AUIPC) {
+		put("0X");
+		return dissemble_hex(out, word_t(inst.imm) >> 12, 5);
 	}
+	if(!target.empty() && (inst.op == OP_JAL || (inst.op >= OP_BEQ && inst.op <= OP_BGEU))) {
+		put(target);
+		return out;
 	}
-	return ret;
+	return std::to_chars(out, out + 20, inst.imm).ptr;
 }
 
 END_DA_NAMESPACE
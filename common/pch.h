@@ -102,6 +102,14 @@
 	#define DA_MAYBE_UNUSED
 #endif
 
+#if DA_HAS_CPP_ATTRIBUTE(clang::musttail)
+	#define DA_HAS_MUSTTAIL 1
+	#define DA_MUSTTAIL [[clang::musttail]]
+#else
+	#define DA_HAS_MUSTTAIL 0
+	#define DA_MUSTTAIL
+#endif
+
 // Conditional headers
 
 #if DA_HAS_INCLUDE(<format>) // Try to use standard format first
@@ -109,6 +117,8 @@
 	BEGIN_DA_NAMESPACE
 	namespace fmt {
 		using std::format;
+		using std::make_format_args;
+		using std::vformat;
 	}
 	END_DA_NAMESPACE
 #elif DA_HAS_INCLUDE(<fmt/format.h>) // Then try to use system installed / user specified
@@ -13,6 +13,8 @@
 #include <common/pch.h>
 #include <common/type.h>
 
+#include <string_view>
+
 BEGIN_DA_NAMESPACE
 
 // Enum value to string
@@ -52,6 +54,76 @@ DA_MAYBE_UNUSED static constexpr const char* reg_name[] = {
 	"ZR",
 };
 
+DA_MAYBE_UNUSED static constexpr const char* vreg_name[] = {
+	"V00",
+	"V01",
+	"V02",
+	"V03",
+	"V04",
+	"V05",
+	"V06",
+	"V07",
+	"V08",
+	"V09",
+	"V10",
+	"V11",
+	"V12",
+	"V13",
+	"V14",
+	"V15",
+	"V16",
+	"V17",
+	"V18",
+	"V19",
+	"V20",
+	"V21",
+	"V22",
+	"V23",
+	"V24",
+	"V25",
+	"V26",
+	"V27",
+	"V28",
+	"V29",
+	"V30",
+	"V31",
+};
+
+DA_MAYBE_UNUSED static constexpr const char* freg_name[] = {
+	"F00",
+	"F01",
+	"F02",
+	"F03",
+	"F04",
+	"F05",
+	"F06",
+	"F07",
+	"F08",
+	"F09",
+	"F10",
+	"F11",
+	"F12",
+	"F13",
+	"F14",
+	"F15",
+	"F16",
+	"F17",
+	"F18",
+	"F19",
+	"F20",
+	"F21",
+	"F22",
+	"F23",
+	"F24",
+	"F25",
+	"F26",
+	"F27",
+	"F28",
+	"F29",
+	"F30",
+	"F31",
+};
+
 #define DA_X(name, ...) #name,
 
 DA_MAYBE_UNUSED static constexpr const char* asm_name_v[] = {
@@ -62,7 +134,6 @@ DA_MAYBE_UNUSED static constexpr const char* asm_name_v[] = {
 	"ERROR VOID COMMAND",
 	"ERROR VOID COMMAND",
 	"ERROR VOID COMMAND",
-	"ERROR VOID COMMAND",
 };
 
 DA_MAYBE_UNUSED static constexpr const char* asm_name_r1[] = {
@@ -143,25 +214,424 @@ DA_MAYBE_UNUSED static constexpr const char* asm_name_imm_shift[] = {
 	"ERROR IMM SHIFT COMMAND",
 };
 
+// Name of each plain op_t
+DA_MAYBE_UNUSED static constexpr const char* op_name[] = {
+	"UNDECODED",
+	"ERROR",
+	"GENERIC",
+	// clang-format off
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	DA_X_BULK
+	DA_X_ATOMIC
+	// clang-format on
+};
+
+#undef DA_X
+#define DA_X(name, type, ...) type,
+
+// Type of each plain op_t
+DA_MAYBE_UNUSED static constexpr inst_type_t op_type[] = {
+	INST_V, // OP_UNDECODED
+	INST_V, // OP_ERROR
+	INST_V, // OP_GENERIC
+	// clang-format off
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	DA_X_BULK
+	DA_X_ATOMIC
+	// clang-format on
+};
+
 #undef DA_X
-#define DA_X(name, type, ...) { #name, type << 16 | I_##name },
 
-// String to enum value
-DA_MAYBE_UNUSED static const std::map<std::string, uint32_t> asm_id = {
+// Name of each op_group_t
+DA_MAYBE_UNUSED static constexpr const char* group_name[] = {
+	"ARITH",
+	"LOAD",
+	"SAVE",
+	"IMM",
+	"BRANCH",
+	"VECTOR",
+	"FLOAT",
+	"BULK",
+	"V",
+	"R1",
+	"R2",
+	"R1I1",
+};
+static_assert(std::size(group_name) == GROUP_COUNT);
+
+// Group of each plain op_t
+DA_MAYBE_UNUSED static constexpr op_group_t op_group[] = {
+	GROUP_V, // OP_UNDECODED
+	GROUP_V, // OP_ERROR
+	GROUP_V, // OP_GENERIC
 	// clang-format off
+#define DA_X(...) GROUP_V,
 	DA_X_V
+#undef DA_X
+#define DA_X(...) GROUP_R1,
 	DA_X_R1
+#undef DA_X
+#define DA_X(...) GROUP_R2,
 	DA_X_R2
+#undef DA_X
+#define DA_X(...) GROUP_R1I1,
 	DA_X_R1I1
+#undef DA_X
+#define DA_X(...) GROUP_ARITH,
 	DA_X_ARITH
+#undef DA_X
+#define DA_X(...) GROUP_LOAD,
 	DA_X_LOAD
+#undef DA_X
+#define DA_X(...) GROUP_SAVE,
 	DA_X_SAVE
+#undef DA_X
+#define DA_X(...) GROUP_IMM,
 	DA_X_IMM
 	DA_X_IMM_SHIFT
+#undef DA_X
+#define DA_X(...) GROUP_BRANCH,
+	DA_X_BRANCH
+#undef DA_X
+#define DA_X(...) GROUP_VECTOR,
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+#undef DA_X
+#define DA_X(...) GROUP_FLOAT,
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+#undef DA_X
+#define DA_X(...) GROUP_BULK,
+	DA_X_BULK
+	DA_X_ATOMIC
+#undef DA_X
 	// clang-format on
 };
+static_assert(std::size(op_group) == OP_FUSED);
 
+// Register files of the operands of each plain op_t
+DA_MAYBE_UNUSED static constexpr op_files_t op_files[] = {
+	{ FILE_X, FILE_X, FILE_X }, // OP_UNDECODED
+	{ FILE_X, FILE_X, FILE_X }, // OP_ERROR
+	{ FILE_X, FILE_X, FILE_X }, // OP_GENERIC
+	// clang-format off
+#define DA_X(...) { FILE_X, FILE_X, FILE_X },
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+#undef DA_X
+#define DA_X(...) { FILE_V, FILE_X, FILE_X },
+	DA_X_VECTOR_MEMORY
+#undef DA_X
+#define DA_X(...) { FILE_V, FILE_V, FILE_V },
+	DA_X_VECTOR
+#undef DA_X
+#define DA_X(...) { FILE_X, FILE_V, FILE_X },
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+#undef DA_X
+#define DA_X(...) { FILE_V, FILE_X, FILE_X },
+	DA_X_VECTOR_SPLAT
+#undef DA_X
+#define DA_X(...) { FILE_F, FILE_X, FILE_X },
+	DA_X_FLOAT_MEMORY
+#undef DA_X
+#define DA_X(...) { FILE_F, FILE_F, FILE_F },
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
 #undef DA_X
+#define DA_X(...) { FILE_X, FILE_F, FILE_F },
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+#undef DA_X
+#define DA_X(...) { FILE_F, FILE_X, FILE_X },
+	DA_X_FLOAT_FROM_X
+#undef DA_X
+#define DA_X(...) { FILE_X, FILE_X, FILE_X },
+	DA_X_BULK
+	DA_X_ATOMIC
+#undef DA_X
+	// clang-format on
+};
+static_assert(std::size(op_files) == OP_FUSED);
+
+// String to enum value, through perfect hashes built at compile time
+
+/**
+ * @brief  Fold @param name to upper case & pack it little endian into an integer, which identifies it exactly
+ * @return The packed name, 0 if @param name is empty or longer than 8 chars
+ */
+inline constexpr uint64_t pack_name(std::string_view name) noexcept {
+	uint64_t ret = 0;
+	DA_IF_UNLIKELY(name.size() > sizeof(ret)) {
+		return 0;
+	}
+	for(size_t i = 0; i < name.size(); ++i) {
+		const char c = name[i] >= 'a' && name[i] <= 'z' ? char(name[i] - 'a' + 'A') : name[i];
+		ret |= uint64_t(uint8_t(c)) << (i * BYTE_BITS);
+	}
+	return ret;
+}
+
+/**
+ * @brief Perfect hash of up to N packed names, 0 marks a hole in the keys, the slot of a name is (packed * seed) >> shift
+ *
+ * With 8 slots per name a seed without collision is found after a few tries.
+ * Slots hold the packed name, so a lookup is one multiplication & one comparison.
+ */
+template<size_t N>
+struct name_hash_t {
+	static constexpr size_t BITS = [] {
+		size_t bits = 3;
+		while((size_t(1) << bits) < N * 8) {
+			++bits;
+		}
+		return bits;
+	}();
+	static constexpr size_t SLOTS = size_t(1) << BITS;
+
+	uint64_t seed = 0;
+	uint64_t keys[SLOTS] {};
+	uint8_t	 values[SLOTS] {};
+
+	// Value of @param key, @param missing if it is not in the table
+	constexpr uint8_t find(uint64_t key, uint8_t missing) const noexcept {
+		const size_t slot = size_t((key * seed) >> (DWORD_BITS - BITS));
+		return key && keys[slot] == key ? values[slot] : missing;
+	}
+};
+
+template<size_t N>
+inline constexpr name_hash_t<N> make_name_hash(const uint64_t (&keys)[N], const uint8_t (&values)[N]) noexcept {
+	name_hash_t<N> ret;
+	uint64_t	   state = 0x9E3779B97F4A7C15;
+	for(;;) {
+		state += 0x9E3779B97F4A7C15; // splitmix64
+		uint64_t seed = state;
+		seed		  = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9;
+		seed		  = (seed ^ (seed >> 27)) * 0x94D049BB133111EB;
+		ret.seed	  = (seed ^ (seed >> 31)) | 1;
+		for(uint64_t& key : ret.keys) {
+			key = 0;
+		}
+		bool ok = true;
+		for(size_t i = 0; ok && i < N; ++i) {
+			if(!keys[i]) { // Hole
+				continue;
+			}
+			const size_t slot = size_t((keys[i] * ret.seed) >> (DWORD_BITS - ret.BITS));
+			ok				  = ret.keys[slot] == 0;
+			ret.keys[slot]	  = keys[i];
+			ret.values[slot]  = values[i];
+		}
+		if(ok) {
+			return ret;
+		}
+	}
+}
+
+#define DA_X(name, ...) pack_name(#name),
+
+DA_MAYBE_UNUSED static constexpr uint64_t asm_keys[] = {
+	// clang-format off
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	DA_X_BULK
+	DA_X_ATOMIC
+	// clang-format on
+};
+
+#undef DA_X
+#define DA_X(name, ...) OP_##name,
+
+DA_MAYBE_UNUSED static constexpr uint8_t asm_values[] = {
+	// clang-format off
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	DA_X_BULK
+	DA_X_ATOMIC
+	// clang-format on
+};
+
+#undef DA_X
+
+inline constexpr auto asm_hash = make_name_hash(asm_keys, asm_values);
+
+/**
+ * @brief  Find the plain command named @param name, case insensitive
+ * @return Its op_t, OP_ERROR if there is none
+ */
+inline constexpr uint8_t asm_id(std::string_view name) noexcept {
+	return asm_hash.find(pack_name(name), OP_ERROR);
+}
+
+// Every name in reg_name, then xN for every register, 0 if already in reg_name
+inline constexpr auto reg_keys = [] {
+	constexpr size_t COUNT = std::size(reg_name);
+	struct {
+		uint64_t key[COUNT * 2];
+		uint8_t	 value[COUNT * 2];
+	} ret {};
+	for(size_t i = 0; i < COUNT; ++i) {
+		ret.key[i]	 = pack_name(reg_name[i]);
+		ret.value[i] = uint8_t(i);
+	}
+	for(size_t i = 0; i < COUNT; ++i) {
+		const char	   name[] = { 'X', char(i < 10 ? '0' + i : '0' + i / 10), char('0' + i % 10) };
+		const uint64_t key	  = pack_name(std::string_view(name, i < 10 ? 2 : 3));
+		bool		   listed = false;
+		for(size_t j = 0; j < COUNT; ++j) {
+			listed |= ret.key[j] == key;
+		}
+		ret.key[COUNT + i]	 = listed ? 0 : key;
+		ret.value[COUNT + i] = uint8_t(i);
+	}
+	return ret;
+}();
+
+inline constexpr auto reg_hash = make_name_hash(reg_keys.key, reg_keys.value);
+
+/**
+ * @brief  Find the register named @param name, case insensitive, either its alias in reg_name or xN
+ * @return Its id, 0xFF if there is none
+ */
+inline constexpr uint8_t reg_id(std::string_view name) noexcept {
+	return reg_hash.find(pack_name(name), 0xFF);
+}
+
+/**
+ * @brief  Find the register of a numbered file named @param prefix N, case insensitive, N in decimal possibly with a leading 0
+ * @param  prefix Upper case letter of the file
+ * @return Its id, 0xFF if there is none
+ */
+inline constexpr uint8_t numbered_reg_id(char prefix, std::string_view name) noexcept {
+	DA_IF_UNLIKELY(name.size() < 2 || name.size() > 3 || (name[0] != prefix && name[0] != prefix - 'A' + 'a')) {
+		return 0xFF;
+	}
+	uint32_t id = 0;
+	for(const char c : name.substr(1)) {
+		DA_IF_UNLIKELY(c < '0' || c > '9') {
+			return 0xFF;
+		}
+		id = id * 10 + uint32_t(c - '0');
+	}
+	return id < 32 ? uint8_t(id) : 0xFF;
+}
+
+// Find the vector register named vN as in vreg_name, 0xFF if there is none
+inline constexpr uint8_t vreg_id(std::string_view name) noexcept {
+	return numbered_reg_id('V', name);
+}
+
+// Find the floating point register named fN as in freg_name, 0xFF if there is none
+inline constexpr uint8_t freg_id(std::string_view name) noexcept {
+	return numbered_reg_id('F', name);
+}
+
+static_assert(asm_id("addi") == OP_ADDI && asm_id("BGEU") == OP_BGEU && asm_id("nop") == OP_ERROR);
+static_assert(reg_id("zr") == 31 && reg_id("x8") == 8 && reg_id("X08") == 8 && reg_id("x31") == 31 && reg_id("x32") == 0xFF);
+static_assert(asm_id("vaddb") == OP_VADDB && asm_id("VSPLATD") == OP_VSPLATD && vreg_id("v7") == 7 && vreg_id("V07") == 7 && vreg_id("v32") == 0xFF);
+static_assert(asm_id("fmaddd") == OP_FMADDD && asm_id("FMVDX") == OP_FMVDX && freg_id("f7") == 7 && freg_id("F31") == 31 && freg_id("v1") == 0xFF);
+static_assert(asm_id("mcpy") == OP_MCPY && asm_id("MLEN") == OP_MLEN && asm_id("lrw") == OP_LRW && asm_id("AMOSWAPD") == OP_AMOSWAPD);
 
 END_DA_NAMESPACE
 
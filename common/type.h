@@ -44,9 +44,10 @@ inline constexpr size_t HWORD_MASK = 0xFFFF;
 inline constexpr size_t WORD_MASK  = 0xFFFFFFFF;
 inline constexpr size_t DWORD_MASK = 0xFFFFFFFFFFFFFFFF;
 
-#define DA_X_V             \
-	DA_X(RET, INST_V, ret) \
-	DA_X(HLT, INST_V, hlt)
+#define DA_X_V               \
+	DA_X(RET, INST_V, ret)   \
+	DA_X(HLT, INST_V, hlt)   \
+	DA_X(ECALL, INST_V, ecall)
 
 #define DA_X_R1               \
 	DA_X(PUSH, INST_R1, push) \
@@ -119,6 +120,159 @@ inline constexpr size_t DWORD_MASK = 0xFFFFFFFFFFFFFFFF;
 	DA_X(BLTU, INST_R2I1, bltu) \
 	DA_X(BGEU, INST_R2I1, bgeu)
 
+// Vector commands on lanes of 8, 16, 32 & 64 bits, suffixed B, H, W & D like loads
+#define DA_X_LANES(big, type, small)   \
+	DA_X(big##B, type, small<byte_t>)  \
+	DA_X(big##H, type, small<hword_t>) \
+	DA_X(big##W, type, small<word_t>)  \
+	DA_X(big##D, type, small<dword_t>)
+
+// VLD vd, xa, imm & VST vd, xa, imm, like loads but with a vector rd
+#define DA_X_VECTOR_MEMORY      \
+	DA_X(VLD, INST_R2I1, vld) \
+	DA_X(VST, INST_R2I1, vst)
+
+// Lane-wise vd, va, vb, compares set the whole lane
+#define DA_X_VECTOR                     \
+	DA_X_LANES(VADD, INST_R3, vadd)   \
+	DA_X_LANES(VSUB, INST_R3, vsub)   \
+	DA_X_LANES(VMUL, INST_R3, vmul)   \
+	DA_X_LANES(VMIN, INST_R3, vmin)   \
+	DA_X_LANES(VMAX, INST_R3, vmax)   \
+	DA_X_LANES(VMINU, INST_R3, vminu) \
+	DA_X_LANES(VMAXU, INST_R3, vmaxu) \
+	DA_X_LANES(VSEQ, INST_R3, vseq)   \
+	DA_X_LANES(VSLT, INST_R3, vslt)   \
+	DA_X_LANES(VSLTU, INST_R3, vsltu) \
+	DA_X(VAND, INST_R3, vand)         \
+	DA_X(VOR, INST_R3, vor)           \
+	DA_X(VXOR, INST_R3, vxor)         \
+	DA_X(VSHUF, INST_R3, vshuf)
+
+// Horizontal xd, va
+#define DA_X_VECTOR_REDUCE                \
+	DA_X_LANES(VRSUM, INST_R2, vrsum)   \
+	DA_X_LANES(VRMIN, INST_R2, vrmin)   \
+	DA_X_LANES(VRMAX, INST_R2, vrmax)   \
+	DA_X_LANES(VRMINU, INST_R2, vrminu) \
+	DA_X_LANES(VRMAXU, INST_R2, vrmaxu) \
+	DA_X(VMASK, INST_R2, vmask)
+
+// VEXT xd, va, lane
+#define DA_X_VECTOR_EXTRACT \
+	DA_X_LANES(VEXT, INST_R2I1, vext)
+
+// VSPLAT vd, xa
+#define DA_X_VECTOR_SPLAT \
+	DA_X_LANES(VSPLAT, INST_R2, vsplat)
+
+// Floating point commands on single & double, suffixed S & D
+#define DA_X_PRECISIONS(big, type, small) \
+	DA_X(big##S, type, small<float>)      \
+	DA_X(big##D, type, small<double>)
+
+// FLW fd, xa, imm & FSW fd, xa, imm, like VLD & VST
+#define DA_X_FLOAT_MEMORY     \
+	DA_X(FLW, INST_R2I1, flw) \
+	DA_X(FLD, INST_R2I1, fld) \
+	DA_X(FSW, INST_R2I1, fsw) \
+	DA_X(FSD, INST_R2I1, fsd)
+
+// fd, fa, fb, fc rounded once, FMADD is fa * fb + fc, FMSUB fa * fb - fc, FNMADD -fa * fb - fc, FNMSUB -fa * fb + fc
+#define DA_X_FLOAT_FMA                     \
+	DA_X(FMADDS, INST_R4, fmadd<float>)    \
+	DA_X(FMSUBS, INST_R4, fmsub<float>)    \
+	DA_X(FNMADDS, INST_R4, fnmadd<float>)  \
+	DA_X(FNMSUBS, INST_R4, fnmsub<float>)  \
+	DA_X(FMADDD, INST_R4, fmadd<double>)   \
+	DA_X(FMSUBD, INST_R4, fmsub<double>)   \
+	DA_X(FNMADDD, INST_R4, fnmadd<double>) \
+	DA_X(FNMSUBD, INST_R4, fnmsub<double>)
+
+// fd, fa, fb
+#define DA_X_FLOAT                       \
+	DA_X_PRECISIONS(FADD, INST_R3, fadd) \
+	DA_X_PRECISIONS(FSUB, INST_R3, fsub) \
+	DA_X_PRECISIONS(FMUL, INST_R3, fmul) \
+	DA_X_PRECISIONS(FDIV, INST_R3, fdiv) \
+	DA_X_PRECISIONS(FMIN, INST_R3, fmin) \
+	DA_X_PRECISIONS(FMAX, INST_R3, fmax)
+
+// fd, fa, FCVTSD rounds a double to single, FCVTDS widens a single
+#define DA_X_FLOAT_UNARY                   \
+	DA_X_PRECISIONS(FSQRT, INST_R2, fsqrt) \
+	DA_X(FCVTSD, INST_R2, fcvtsd)          \
+	DA_X(FCVTDS, INST_R2, fcvtds)
+
+// xd, fa, fb, 1 if the compare holds, 0 otherwise or if any is NaN
+#define DA_X_FLOAT_COMPARE             \
+	DA_X_PRECISIONS(FEQ, INST_R3, feq) \
+	DA_X_PRECISIONS(FLT, INST_R3, flt) \
+	DA_X_PRECISIONS(FLE, INST_R3, fle)
+
+// xd, fa, FCVTL truncates to a signed 64-bit integer, FMVXD copies the bits
+#define DA_X_FLOAT_TO_X                    \
+	DA_X_PRECISIONS(FCVTL, INST_R2, fcvtl) \
+	DA_X(FMVXD, INST_R2, fmvxd)
+
+// fd, xa, FCVTSL & FCVTDL convert a signed 64-bit integer, FMVDX copies the bits
+#define DA_X_FLOAT_FROM_X         \
+	DA_X(FCVTSL, INST_R2, fcvtsl) \
+	DA_X(FCVTDL, INST_R2, fcvtdl) \
+	DA_X(FMVDX, INST_R2, fmvdx)
+
+// Bulk memory commands on lengths in registers, each range is checked once against guest_bounds_t, see common/bulk.h
+// MCPY xd, xa, xb      copy xb bytes from xa to xd, the ranges may overlap
+// MSET xd, xa, xb      fill xb bytes at xd with the low byte of xa
+// MCMP xd, xa, xb, xc  xd = -1, 0 or 1 as the xc bytes at xa compare to those at xb, unsigned
+// MCHR xd, xa, xb, xc  xd = offset of the first low byte of xb in the xc bytes at xa, xc if none
+// MLEN xd, xa          xd = length of the NUL terminated string at xa
+#define DA_X_BULK             \
+	DA_X(MCPY, INST_R3, mcpy) \
+	DA_X(MSET, INST_R3, mset) \
+	DA_X(MCMP, INST_R4, mcmp) \
+	DA_X(MCHR, INST_R4, mchr) \
+	DA_X(MLEN, INST_R2, mlen)
+
+// Atomic commands on words & double words, suffixed W & D, sequentially consistent, see common/atomic.h
+// The address must be aligned to the width, words read are sign extended
+#define DA_X_WIDTHS(big, type, small)  \
+	DA_X(big##W, type, small<word_t>)  \
+	DA_X(big##D, type, small<dword_t>)
+
+// LR xd, xa            xd = [xa], reserving xa
+// SC xd, xa, xb        [xa] = xb if it still holds what LR reserved at xa, xd = 0 if stored, 1 otherwise, drops the reservation
+// AMOADD xd, xa, xb    xd = [xa], [xa] += xb
+// AMOSWAP xd, xa, xb   xd = [xa], [xa] = xb
+// AMOCAS xd, xa, xb    xd = [xa], [xa] = xb if it held xd
+#define DA_X_ATOMIC                        \
+	DA_X_WIDTHS(LR, INST_R2, lr)           \
+	DA_X_WIDTHS(SC, INST_R3, sc)           \
+	DA_X_WIDTHS(AMOADD, INST_R3, amoadd)   \
+	DA_X_WIDTHS(AMOSWAP, INST_R3, amoswap) \
+	DA_X_WIDTHS(AMOCAS, INST_R3, amocas)
+
+// Fused commands, a sequence of commands dispatched at once
+// Listed as DA_X(name, first, ..., last), all but the last command must not touch pc
+// Regenerate them with davm-fusion on real programs
+#define DA_X_FUSED_PAIR         \
+	DA_X(LUI_ADDI, LUI, ADDI)   \
+	DA_X(ADDI_BNE, ADDI, BNE)   \
+	DA_X(ADDI_BLT, ADDI, BLT)   \
+	DA_X(ADDI_BLTU, ADDI, BLTU) \
+	DA_X(LD_ADD, LD, ADD)       \
+	DA_X(LD_LD, LD, LD)         \
+	DA_X(ADD_LD, ADD, LD)       \
+	DA_X(SLLI_ADD, SLLI, ADD)   \
+	DA_X(MOV_RET, MOV, RET)     \
+	DA_X(POP_RET, POP, RET)     \
+	DA_X(PUSH_CALL, PUSH, CALL)
+
+#define DA_X_FUSED_TRIPLE                  \
+	DA_X(PUSH_PUSH_CALL, PUSH, PUSH, CALL) \
+	DA_X(POP_POP_RET, POP, POP, RET)       \
+	DA_X(SLLI_ADD_LD, SLLI, ADD, LD)
+
 #define DA_X(name, ...) I_##name,
 // List of all accepted assembler commands
 // Most of commands are from RISC-V
@@ -128,6 +282,9 @@ enum inst_t : uint8_t {
 	I_G_SAVE,
 	I_G_IMM,
 	I_G_BRANCH,
+	I_G_VECTOR,
+	I_G_FLOAT,
+	I_G_BULK, // See asm_cmd_r4_t
 
 	// v
 	I_DUMMY_V = 0x07,
@@ -174,8 +331,126 @@ enum inst_branch_t {
 	DA_X_BRANCH
 };
 
+enum inst_vector_t {
+	DA_X_VECTOR_MEMORY
+		I_G_VECTOR_R3 = 0x07, // See asm_cmd_r3x_t
+};
+
+enum inst_vector_r3_t {
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+};
+
+enum inst_float_t {
+	DA_X_FLOAT_MEMORY
+		I_G_FLOAT_FMA_S = 0x04, // See asm_cmd_r4_t
+	I_G_FLOAT_FMA_D,
+	I_G_FLOAT_R3 = 0x07, // See asm_cmd_r3x_t
+};
+
+enum inst_float_fma_t {
+	DA_X_FLOAT_FMA
+};
+
+enum inst_float_r3_t {
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+};
+
+enum inst_bulk_t {
+	DA_X_BULK
+		I_G_BULK_ATOMIC = 0x07, // See asm_cmd_r3x_t
+};
+
+enum inst_atomic_t {
+	DA_X_ATOMIC
+};
+
+#undef DA_X
+#define DA_X(name, ...) OP_##name,
+
+// Dense id of every command, used by the predecoded form
+enum op_t : uint8_t {
+	OP_UNDECODED, // Not decoded yet
+	OP_ERROR,	  // Invalid code
+	OP_GENERIC,	  // Touches pc in an irregular way, only executable through asm_inst_t::func
+
+	DA_X_V
+	DA_X_R1
+	DA_X_R2
+	DA_X_R1I1
+	DA_X_ARITH
+	DA_X_LOAD
+	DA_X_SAVE
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	DA_X_BRANCH
+	DA_X_VECTOR_MEMORY
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_MEMORY
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	DA_X_BULK
+	DA_X_ATOMIC
+
+	DA_X_FUSED_PAIR
+	DA_X_FUSED_TRIPLE
+
+	OP_COUNT
+};
+
+inline constexpr uint8_t OP_FUSED = OP_AMOCASD + 1; // First fused op
+
+// Groups of commands by opcode, I_G_* then the classes of unique opcodes
+enum op_group_t : uint8_t {
+	GROUP_ARITH	 = I_G_ARITH,
+	GROUP_LOAD	 = I_G_LOAD,
+	GROUP_SAVE	 = I_G_SAVE,
+	GROUP_IMM	 = I_G_IMM, // With I_G_IMM_SHIFT
+	GROUP_BRANCH = I_G_BRANCH,
+	GROUP_VECTOR = I_G_VECTOR,
+	GROUP_FLOAT	 = I_G_FLOAT,
+	GROUP_BULK	 = I_G_BULK,
+	GROUP_V,
+	GROUP_R1,
+	GROUP_R2,
+	GROUP_R1I1,
+	GROUP_COUNT
+};
+
 #undef DA_X
 
+inline constexpr size_t VECTOR_BYTES = 16;
+
+// Vector register, lanes are packed in host order like memory
+struct alignas(VECTOR_BYTES) vector_t {
+	byte_t bytes[VECTOR_BYTES];
+};
+
+// Host ranges [begin, end) bulk commands may access, refreshed by the VM each time it starts running
+struct guest_bounds_t {
+	register_t begin, end; // Guest memory, read & write
+	register_t ro_begin, ro_end; // Code & read only data, read only
+};
+
+// Set by LR & dropped by SC
+struct reservation_t {
+	register_t address; // 0 if none
+	register_t value; // Read by LR, zero extended
+};
+
 struct vm_context_t {
 	/**
 	 * ID	   |Alias  |Desc
@@ -191,7 +466,11 @@ struct vm_context_t {
 	 * x16 - x30		Temp Registers
 	 * x31		zr		Zero Register (should be read only)
 	 */
-	register_t x[32];
+	register_t	   x[32];
+	dword_t		   f[32]; // Floating point registers, singles in the low 32 bits, see common/float.h
+	vector_t	   v[32]; // Vector registers, see common/vector.h
+	guest_bounds_t bounds; // Not a register, see common/bulk.h
+	reservation_t  reservation; // Not a register, see common/atomic.h
 };
 
 // Macros for easier access to special registers
@@ -212,9 +491,25 @@ using asm_func_v_t	  = void (*)(vm_context_t&) noexcept;
 using asm_func_r1_t	  = void (*)(vm_context_t&, regid_t) noexcept;
 using asm_func_r2_t	  = void (*)(vm_context_t&, regid_t, regid_t) noexcept;
 using asm_func_r3_t	  = void (*)(vm_context_t&, regid_t, regid_t, regid_t) noexcept;
+using asm_func_r4_t	  = void (*)(vm_context_t&, regid_t, regid_t, regid_t, regid_t) noexcept;
 using asm_func_r1i1_t = void (*)(vm_context_t&, regid_t, immediate_t) noexcept;
 using asm_func_r2i1_t = void (*)(vm_context_t&, regid_t, regid_t, immediate_t) noexcept;
 
+struct asm_inst_t;
+
+using asm_func_t = void (*)(vm_context_t&, const asm_inst_t&) noexcept;
+
+// Predecoded command, see common/decode.h
+struct asm_inst_t {
+	asm_func_t	func; // Handler of this command alone
+	sregister_t imm; // Immediate, already extended & shifted as the handler uses it
+	uint8_t		id; // op_t to dispatch on, a fused op if the following commands are fused into this one
+	uint8_t		rd; // Register ids, 8-bit to keep the record compact
+	uint8_t		ra;
+	uint8_t		rb;
+	uint8_t		op = OP_UNDECODED; // op_t of this command alone
+};
+
 struct asm_cmd_v_t {
 	uint32_t op2 : 3;
 	uint32_t op : 4;
@@ -267,6 +562,30 @@ struct asm_cmd_imm_shift_t {
 	uint32_t imm : 10;
 };
 
+// I_G_VECTOR with op2 == I_G_VECTOR_R3, op3 is an inst_vector_r3_t, rb holds the lane of VEXT
+// I_G_FLOAT with op2 == I_G_FLOAT_R3, op3 is an inst_float_r3_t
+// I_G_BULK with op2 == I_G_BULK_ATOMIC, op3 is an inst_atomic_t
+struct asm_cmd_r3x_t {
+	uint32_t op : 7;
+	uint32_t rd : 5;
+	uint32_t ra : 5;
+	uint32_t op2 : 3;
+	uint32_t rb : 5;
+	uint32_t op3 : 7;
+};
+
+// I_G_FLOAT with op2 == I_G_FLOAT_FMA_S or I_G_FLOAT_FMA_D, op3 is FMADD, FMSUB, FNMADD or FNMSUB
+// I_G_BULK with op2 an inst_bulk_t & op3 == 0, rc & rb are 0 if unused
+struct asm_cmd_r4_t {
+	uint32_t op : 7;
+	uint32_t rd : 5;
+	uint32_t ra : 5;
+	uint32_t op2 : 3;
+	uint32_t rb : 5;
+	uint32_t rc : 5;
+	uint32_t op3 : 2;
+};
+
 enum inst_type_t {
 	INST_V,
 	INST_R1,
@@ -274,6 +593,20 @@ enum inst_type_t {
 	INST_R3,
 	INST_R1I1,
 	INST_R2I1,
+	INST_R4, // rd, ra, rb, rc, rc is in asm_inst_t::imm & in the file of rb
+};
+
+// Register file an operand names
+enum reg_file_t : uint8_t {
+	FILE_X, // vm_context_t::x
+	FILE_V, // vm_context_t::v
+	FILE_F, // vm_context_t::f
+};
+
+struct op_files_t {
+	reg_file_t rd;
+	reg_file_t ra;
+	reg_file_t rb;
 };
 
 END_DA_NAMESPACE
@@ -0,0 +1,643 @@
+/**
+ * @file      vector.h
+ * @brief     Vector assembler functions, on SSE when the host has it
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_COMMON_VECTOR_H_
+#define _DAVM_COMMON_VECTOR_H_
+
+#include <common/pch.h>
+#include <common/asm.h>
+#include <common/type.h>
+
+#include <cstring>
+#include <type_traits>
+
+// SSE2 is part of x86-64, later sets are chosen at startup like common/base64.h does,
+// or at build time when the compiler targets them, see DAVM_NATIVE
+#if DA_COMP_GNU && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+	#define DA_VECTOR_SSE2 1
+	#include <immintrin.h>
+#else
+	#define DA_VECTOR_SSE2 0
+#endif
+
+BEGIN_DA_NAMESPACE
+
+// Instruction sets, each one implies those before it
+enum vector_isa_t : uint8_t {
+	VECTOR_SSE2,
+	VECTOR_SSSE3,
+	VECTOR_SSE41,
+	VECTOR_SSE42,
+	VECTOR_AVX512, // F, VL & DQ, for the 64-bit lanes of 128-bit registers
+};
+
+// Best set the compiler targets, no check is needed up to it
+#if DA_VECTOR_SSE2 && defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512DQ__)
+inline constexpr vector_isa_t VECTOR_ISA_BUILD = VECTOR_AVX512;
+#elif DA_VECTOR_SSE2 && defined(__SSE4_2__)
+inline constexpr vector_isa_t VECTOR_ISA_BUILD = VECTOR_SSE42;
+#elif DA_VECTOR_SSE2 && defined(__SSE4_1__)
+inline constexpr vector_isa_t VECTOR_ISA_BUILD = VECTOR_SSE41;
+#elif DA_VECTOR_SSE2 && defined(__SSSE3__)
+inline constexpr vector_isa_t VECTOR_ISA_BUILD = VECTOR_SSSE3;
+#else
+inline constexpr vector_isa_t VECTOR_ISA_BUILD = VECTOR_SSE2;
+#endif
+
+// Best set supported by the CPU & the OS
+inline vector_isa_t vector_detect() noexcept {
+#if DA_VECTOR_SSE2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")) {
+		return VECTOR_AVX512;
+	}
+	if(__builtin_cpu_supports("sse4.2")) {
+		return VECTOR_SSE42;
+	}
+	if(__builtin_cpu_supports("sse4.1")) {
+		return VECTOR_SSE41;
+	}
+	if(__builtin_cpu_supports("ssse3")) {
+		return VECTOR_SSSE3;
+	}
+#endif
+	return VECTOR_SSE2;
+}
+
+// Chosen once at startup, stays VECTOR_SSE2 (zero) for callers running before it is initialized
+inline const vector_isa_t vector_isa = vector_detect();
+
+// Whether the paths of @param isa may run, folded away up to VECTOR_ISA_BUILD
+DA_ALWAYS_INLINE bool vector_has(vector_isa_t isa) noexcept {
+	return isa <= VECTOR_ISA_BUILD || isa <= vector_isa;
+}
+
+template<typename T>
+inline constexpr size_t VECTOR_LANES = VECTOR_BYTES / sizeof(T);
+
+// Lanes of a vector register as an array, the portable path works on them
+template<typename T>
+struct vector_lanes_t {
+	T lane[VECTOR_LANES<T>];
+};
+
+template<typename T>
+DA_ALWAYS_INLINE vector_lanes_t<T> vector_get(const vector_t& v) noexcept {
+	vector_lanes_t<T> ret;
+	std::memcpy(&ret, v.bytes, VECTOR_BYTES);
+	return ret;
+}
+
+template<typename T>
+DA_ALWAYS_INLINE void vector_set(vector_t& v, const vector_lanes_t<T>& lanes) noexcept {
+	std::memcpy(v.bytes, &lanes, VECTOR_BYTES);
+}
+
+// vd = f(va, vb) lane by lane
+template<typename T, typename F>
+DA_ALWAYS_INLINE void vector_map(vector_t& vd, const vector_t& va, const vector_t& vb, F f) noexcept {
+	const vector_lanes_t<T> a = vector_get<T>(va);
+	const vector_lanes_t<T> b = vector_get<T>(vb);
+	vector_lanes_t<T>		r;
+	for(size_t i = 0; i < VECTOR_LANES<T>; ++i) {
+		r.lane[i] = f(a.lane[i], b.lane[i]);
+	}
+	vector_set(vd, r);
+}
+
+// Fold the lanes of @param va, taken as R, with f
+template<typename T, typename R, typename F>
+DA_ALWAYS_INLINE R vector_fold(const vector_t& va, F f) noexcept {
+	const vector_lanes_t<T> a	= vector_get<T>(va);
+	R						ret = R(a.lane[0]);
+	for(size_t i = 1; i < VECTOR_LANES<T>; ++i) {
+		ret = f(ret, R(a.lane[i]));
+	}
+	return ret;
+}
+
+template<typename T>
+DA_ALWAYS_INLINE T vector_mask(bool set) noexcept {
+	return set ? T(~T(0)) : T(0);
+}
+
+#if DA_VECTOR_SSE2
+DA_ALWAYS_INLINE __m128i vector_load(const vector_t& v) noexcept {
+	return _mm_load_si128(reinterpret_cast<const __m128i*>(v.bytes));
+}
+
+DA_ALWAYS_INLINE void vector_store(vector_t& v, __m128i value) noexcept {
+	_mm_store_si128(reinterpret_cast<__m128i*>(v.bytes), value);
+}
+
+// Flip the sign bit of every lane, so that signed compares order lanes as unsigned
+template<typename T>
+DA_ALWAYS_INLINE __m128i vector_bias(__m128i v) noexcept {
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		return _mm_xor_si128(v, _mm_set1_epi8(char(0x80)));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return _mm_xor_si128(v, _mm_set1_epi16(short(0x8000)));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		return _mm_xor_si128(v, _mm_set1_epi32(int(0x80000000)));
+	} else {
+		return _mm_xor_si128(v, _mm_set1_epi64x(int64_t(0x8000000000000000)));
+	}
+}
+
+// Kernels of the later sets, to be called only when vector_has() them
+// They load & store the registers themselves, so that the handlers jump to them
+
+// pshufb only zeroes on the sign bit, so set it on indices 16 - 127 as well
+__attribute__((target("ssse3"))) inline void vector_shuf_ssse3(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	const __m128i index = vector_load(vb);
+	vector_store(vd, _mm_shuffle_epi8(vector_load(va), _mm_or_si128(index, _mm_cmpgt_epi8(index, _mm_set1_epi8(15)))));
+}
+
+__attribute__((target("sse4.1"))) inline void vector_mul32_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	vector_store(vd, _mm_mullo_epi32(vector_load(va), vector_load(vb)));
+}
+
+__attribute__((target("sse4.1"))) inline void vector_seq64_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	vector_store(vd, _mm_cmpeq_epi64(vector_load(va), vector_load(vb)));
+}
+
+// Lanes of 8 & 32 bits
+template<typename T>
+__attribute__((target("sse4.1"))) inline void vector_min_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		vector_store(vd, _mm_min_epi8(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_min_epi32(vector_load(va), vector_load(vb)));
+	}
+}
+
+template<typename T>
+__attribute__((target("sse4.1"))) inline void vector_max_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		vector_store(vd, _mm_max_epi8(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_max_epi32(vector_load(va), vector_load(vb)));
+	}
+}
+
+// Lanes of 16 & 32 bits
+template<typename T>
+__attribute__((target("sse4.1"))) inline void vector_minu_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		vector_store(vd, _mm_min_epu16(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_min_epu32(vector_load(va), vector_load(vb)));
+	}
+}
+
+template<typename T>
+__attribute__((target("sse4.1"))) inline void vector_maxu_sse41(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		vector_store(vd, _mm_max_epu16(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_max_epu32(vector_load(va), vector_load(vb)));
+	}
+}
+
+// phminposuw, the minimum is in the low lane
+__attribute__((target("sse4.1"))) inline register_t vector_rminu16_sse41(const vector_t& va) noexcept {
+	return register_t(_mm_extract_epi16(_mm_minpos_epu16(vector_load(va)), 0));
+}
+
+// 64-bit lanes, unsigned ones are biased first
+template<bool Unsigned>
+__attribute__((target("sse4.2"))) inline __m128i vector_cmpgt64_sse42(__m128i a, __m128i b) noexcept {
+	if constexpr(Unsigned) {
+		return _mm_cmpgt_epi64(vector_bias<dword_t>(a), vector_bias<dword_t>(b));
+	} else {
+		return _mm_cmpgt_epi64(a, b);
+	}
+}
+
+template<bool Unsigned>
+__attribute__((target("sse4.2"))) inline void vector_min64_sse42(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	const __m128i a = vector_load(va), b = vector_load(vb);
+	vector_store(vd, _mm_blendv_epi8(a, b, vector_cmpgt64_sse42<Unsigned>(a, b)));
+}
+
+template<bool Unsigned>
+__attribute__((target("sse4.2"))) inline void vector_max64_sse42(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	const __m128i a = vector_load(va), b = vector_load(vb);
+	vector_store(vd, _mm_blendv_epi8(b, a, vector_cmpgt64_sse42<Unsigned>(a, b)));
+}
+
+template<bool Unsigned>
+__attribute__((target("sse4.2"))) inline void vector_slt64_sse42(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	vector_store(vd, vector_cmpgt64_sse42<Unsigned>(vector_load(vb), vector_load(va)));
+}
+
+// AVX-512 has single instructions for 64-bit lanes, which SSE lacks or does in 2 - 3
+__attribute__((target("avx512f,avx512vl,avx512dq"))) inline void vector_mul64_avx512(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	vector_store(vd, _mm_mullo_epi64(vector_load(va), vector_load(vb)));
+}
+
+template<bool Unsigned>
+__attribute__((target("avx512f,avx512vl,avx512dq"))) inline void vector_min64_avx512(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(Unsigned) {
+		vector_store(vd, _mm_min_epu64(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_min_epi64(vector_load(va), vector_load(vb)));
+	}
+}
+
+template<bool Unsigned>
+__attribute__((target("avx512f,avx512vl,avx512dq"))) inline void vector_max64_avx512(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	if constexpr(Unsigned) {
+		vector_store(vd, _mm_max_epu64(vector_load(va), vector_load(vb)));
+	} else {
+		vector_store(vd, _mm_max_epi64(vector_load(va), vector_load(vb)));
+	}
+}
+
+// Unsigned only, pcmpgtq already does the signed compare in 1
+__attribute__((target("avx512f,avx512vl,avx512dq"))) inline void vector_sltu64_avx512(vector_t& vd, const vector_t& va, const vector_t& vb) noexcept {
+	vector_store(vd, _mm_movm_epi64(_mm_cmplt_epu64_mask(vector_load(va), vector_load(vb))));
+}
+#endif
+
+// Lane-wise operations
+// Each handler takes the best path the CPU has for its lane width & falls back to the lanes otherwise
+
+template<typename T>
+inline void asm_vadd(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	const __m128i a = vector_load(context.v[ra]), b = vector_load(context.v[rb]);
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		vector_store(context.v[rd], _mm_add_epi8(a, b));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		vector_store(context.v[rd], _mm_add_epi16(a, b));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		vector_store(context.v[rd], _mm_add_epi32(a, b));
+	} else {
+		vector_store(context.v[rd], _mm_add_epi64(a, b));
+	}
+#else
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return T(a + b); });
+#endif
+}
+
+template<typename T>
+inline void asm_vsub(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	const __m128i a = vector_load(context.v[ra]), b = vector_load(context.v[rb]);
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		vector_store(context.v[rd], _mm_sub_epi8(a, b));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		vector_store(context.v[rd], _mm_sub_epi16(a, b));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		vector_store(context.v[rd], _mm_sub_epi32(a, b));
+	} else {
+		vector_store(context.v[rd], _mm_sub_epi64(a, b));
+	}
+#else
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return T(a - b); });
+#endif
+}
+
+// Low half of the products
+template<typename T>
+inline void asm_vmul(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return vector_store(context.v[rd], _mm_mullo_epi16(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_mul32_sse41(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	} else if constexpr(sizeof(T) == sizeof(dword_t)) {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_mul64_avx512(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return T(std::common_type_t<T, unsigned>(a) * b); });
+}
+
+template<typename T>
+inline void asm_vmin(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	using S = std::make_signed_t<T>;
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return vector_store(context.v[rd], _mm_min_epi16(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(dword_t)) {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_min64_avx512<false>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_min64_sse42<false>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_min_sse41<T>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return S(b) < S(a) ? b : a; });
+}
+
+template<typename T>
+inline void asm_vmax(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	using S = std::make_signed_t<T>;
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return vector_store(context.v[rd], _mm_max_epi16(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(dword_t)) {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_max64_avx512<false>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_max64_sse42<false>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_max_sse41<T>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return S(a) < S(b) ? b : a; });
+}
+
+template<typename T>
+inline void asm_vminu(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		return vector_store(context.v[rd], _mm_min_epu8(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(dword_t)) {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_min64_avx512<true>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_min64_sse42<true>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_minu_sse41<T>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return b < a ? b : a; });
+}
+
+template<typename T>
+inline void asm_vmaxu(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		return vector_store(context.v[rd], _mm_max_epu8(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(dword_t)) {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_max64_avx512<true>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_max64_sse42<true>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_maxu_sse41<T>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return a < b ? b : a; });
+}
+
+template<typename T>
+inline void asm_vseq(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		return vector_store(context.v[rd], _mm_cmpeq_epi8(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return vector_store(context.v[rd], _mm_cmpeq_epi16(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		return vector_store(context.v[rd], _mm_cmpeq_epi32(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			return vector_seq64_sse41(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return vector_mask<T>(a == b); });
+}
+
+template<typename T>
+inline void asm_vslt(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+	using S = std::make_signed_t<T>;
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		return vector_store(context.v[rd], _mm_cmplt_epi8(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		return vector_store(context.v[rd], _mm_cmplt_epi16(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		return vector_store(context.v[rd], _mm_cmplt_epi32(vector_load(context.v[ra]), vector_load(context.v[rb])));
+	} else {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_slt64_sse42<false>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return vector_mask<T>(S(a) < S(b)); });
+}
+
+template<typename T>
+inline void asm_vsltu(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		const __m128i a = vector_bias<T>(vector_load(context.v[ra])), b = vector_bias<T>(vector_load(context.v[rb]));
+		return vector_store(context.v[rd], _mm_cmplt_epi8(a, b));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		const __m128i a = vector_bias<T>(vector_load(context.v[ra])), b = vector_bias<T>(vector_load(context.v[rb]));
+		return vector_store(context.v[rd], _mm_cmplt_epi16(a, b));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		const __m128i a = vector_bias<T>(vector_load(context.v[ra])), b = vector_bias<T>(vector_load(context.v[rb]));
+		return vector_store(context.v[rd], _mm_cmplt_epi32(a, b));
+	} else {
+		if(vector_has(VECTOR_AVX512)) {
+			return vector_sltu64_avx512(context.v[rd], context.v[ra], context.v[rb]);
+		}
+		DA_IF_LIKELY(vector_has(VECTOR_SSE42)) {
+			return vector_slt64_sse42<true>(context.v[rd], context.v[ra], context.v[rb]);
+		}
+	}
+#endif
+	vector_map<T>(context.v[rd], context.v[ra], context.v[rb], [](T a, T b) { return vector_mask<T>(a < b); });
+}
+
+// Bit operations, the same on any lane width
+
+inline void asm_vand(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	vector_store(context.v[rd], _mm_and_si128(vector_load(context.v[ra]), vector_load(context.v[rb])));
+#else
+	vector_map<dword_t>(context.v[rd], context.v[ra], context.v[rb], [](dword_t a, dword_t b) { return a & b; });
+#endif
+}
+
+inline void asm_vor(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	vector_store(context.v[rd], _mm_or_si128(vector_load(context.v[ra]), vector_load(context.v[rb])));
+#else
+	vector_map<dword_t>(context.v[rd], context.v[ra], context.v[rb], [](dword_t a, dword_t b) { return a | b; });
+#endif
+}
+
+inline void asm_vxor(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	vector_store(context.v[rd], _mm_xor_si128(vector_load(context.v[ra]), vector_load(context.v[rb])));
+#else
+	vector_map<dword_t>(context.v[rd], context.v[ra], context.v[rb], [](dword_t a, dword_t b) { return a ^ b; });
+#endif
+}
+
+// Byte i of vd is byte vb[i] of va, 0 if vb[i] >= 16
+inline void asm_vshuf(vm_context_t& context, regid_t rd, regid_t ra, regid_t rb) noexcept {
+#if DA_VECTOR_SSE2
+	DA_IF_LIKELY(vector_has(VECTOR_SSSE3)) {
+		return vector_shuf_ssse3(context.v[rd], context.v[ra], context.v[rb]);
+	}
+#endif
+	const vector_t		   a = context.v[ra], index = context.v[rb]; // In case rd is ra or rb
+	vector_lanes_t<byte_t> r;
+	for(size_t i = 0; i < VECTOR_BYTES; ++i) {
+		r.lane[i] = index.bytes[i] < VECTOR_BYTES ? a.bytes[index.bytes[i]] : 0;
+	}
+	vector_set(context.v[rd], r);
+}
+
+// Reductions into xd, lanes are zero extended but for VRMIN & VRMAX
+
+template<typename T>
+inline void asm_vrsum(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) { // psadbw against 0 sums each half
+		vector_t sums;
+		vector_store(sums, _mm_sad_epu8(vector_load(context.v[ra]), _mm_setzero_si128()));
+		const vector_lanes_t<dword_t> half = vector_get<dword_t>(sums);
+		context.x[rd]					   = half.lane[0] + half.lane[1];
+		return;
+	}
+#endif
+	context.x[rd] = vector_fold<T, register_t>(context.v[ra], [](register_t a, register_t b) { return a + b; });
+}
+
+template<typename T>
+inline void asm_vrmin(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	using S		  = std::make_signed_t<T>;
+	context.x[rd] = register_t(sregister_t(vector_fold<S, S>(context.v[ra], [](S a, S b) { return b < a ? b : a; })));
+}
+
+template<typename T>
+inline void asm_vrmax(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	using S		  = std::make_signed_t<T>;
+	context.x[rd] = register_t(sregister_t(vector_fold<S, S>(context.v[ra], [](S a, S b) { return a < b ? b : a; })));
+}
+
+template<typename T>
+inline void asm_vrminu(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(hword_t)) {
+		DA_IF_LIKELY(vector_has(VECTOR_SSE41)) {
+			context.x[rd] = vector_rminu16_sse41(context.v[ra]);
+			return;
+		}
+	}
+#endif
+	context.x[rd] = vector_fold<T, T>(context.v[ra], [](T a, T b) { return b < a ? b : a; });
+}
+
+template<typename T>
+inline void asm_vrmaxu(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+	context.x[rd] = vector_fold<T, T>(context.v[ra], [](T a, T b) { return a < b ? b : a; });
+}
+
+// Bit i of xd is the sign bit of byte i, e.g. to find the first lane set by a compare
+inline void asm_vmask(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+#if DA_VECTOR_SSE2
+	context.x[rd] = register_t(uint32_t(_mm_movemask_epi8(vector_load(context.v[ra]))));
+#else
+	register_t mask = 0;
+	for(size_t i = 0; i < VECTOR_BYTES; ++i) {
+		mask |= register_t(context.v[ra].bytes[i] >> 7) << i;
+	}
+	context.x[rd] = mask;
+#endif
+}
+
+// Lane moves
+
+// xd = lane @param imm of va, zero extended, the decoder checks the range
+template<typename T>
+inline void asm_vext(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	T lane;
+	std::memcpy(&lane, context.v[ra].bytes + (imm & (VECTOR_LANES<T> - 1)) * sizeof(T), sizeof(T));
+	context.x[rd] = lane;
+}
+
+// Every lane of vd = the low bits of xa
+template<typename T>
+inline void asm_vsplat(vm_context_t& context, regid_t rd, regid_t ra) noexcept {
+#if DA_VECTOR_SSE2
+	if constexpr(sizeof(T) == sizeof(byte_t)) {
+		vector_store(context.v[rd], _mm_set1_epi8(char(context.x[ra])));
+	} else if constexpr(sizeof(T) == sizeof(hword_t)) {
+		vector_store(context.v[rd], _mm_set1_epi16(short(context.x[ra])));
+	} else if constexpr(sizeof(T) == sizeof(word_t)) {
+		vector_store(context.v[rd], _mm_set1_epi32(int(context.x[ra])));
+	} else {
+		vector_store(context.v[rd], _mm_set1_epi64x(int64_t(context.x[ra])));
+	}
+#else
+	vector_lanes_t<T> r;
+	for(T& lane : r.lane) {
+		lane = T(context.x[ra]);
+	}
+	vector_set(context.v[rd], r);
+#endif
+}
+
+// Memory, 16 bytes at xa + imm without alignment
+inline void asm_vld(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	std::memcpy(context.v[rd].bytes, reinterpret_cast<const void*>(context.x[ra] + sext_s(imm)), VECTOR_BYTES);
+}
+
+inline void asm_vst(vm_context_t& context, regid_t rd, regid_t ra, immediate_t imm) noexcept {
+	std::memcpy(reinterpret_cast<void*>(context.x[ra] + sext_s(imm)), context.v[rd].bytes, VECTOR_BYTES);
+}
+
+// Function tables, not padded as decode_plain() checks the range
+
+#define DA_X(big, type, small...) asm_##small,
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2i1_t asm_table_vector_memory[] = {
+	DA_X_VECTOR_MEMORY
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r3_t asm_table_vector[] = {
+	DA_X_VECTOR
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2_t asm_table_vector_reduce[] = {
+	DA_X_VECTOR_REDUCE
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2i1_t asm_table_vector_extract[] = {
+	DA_X_VECTOR_EXTRACT
+};
+
+DA_MAYBE_UNUSED static constexpr asm_func_r2_t asm_table_vector_splat[] = {
+	DA_X_VECTOR_SPLAT
+};
+
+#undef DA_X
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_COMMON_VECTOR_H_
@@ -0,0 +1,88 @@
+/**
+ * @file      base64.cpp
+ * @brief     Check the SIMD paths of base64 against the scalar ones
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <common/base64.h>
+
+#include <random>
+#include <vector>
+using namespace da;
+
+// Usage: davm-test-base64
+// Every path the CPU has, up to b64_isa, must encode & decode exactly as b64enc_scalar() & b64dec_scalar() do,
+// over lengths around each block size, each padding & an invalid char at each position. Exits with the number of mismatches
+
+static const char* const isa_names[] = { "scalar", "sse4.1", "avx2", "avx512vbmi" };
+
+static size_t failures = 0;
+
+static void fail(b64_isa_t isa, const char* what, size_t n, size_t at = size_t(-1)) {
+	if(++failures <= 20) {
+		std::fprintf(stderr, "%s: %s differs, length %zu", isa_names[isa], what, n);
+		if(at != size_t(-1)) {
+			std::fprintf(stderr, ", invalid char at %zu", at);
+		}
+		std::fputc('\n', stderr);
+	}
+}
+
+// Compare only the bytes both claim to have decoded, as a failed decode may leave any bytes behind
+static void check_dec(b64_isa_t isa, const std::string& str, size_t at = size_t(-1)) {
+	std::vector<uint8_t> expect(b64dec_len(str.size()) + 1), actual(b64dec_len(str.size()) + 1);
+	const size_t		 ret  = b64dec_scalar(expect.data(), str.data(), str.size());
+	const size_t		 ret2 = b64dec_table[isa](actual.data(), str.data(), str.size());
+	if(ret != ret2) {
+		fail(isa, "decoded length", str.size(), at);
+	} else if(ret < size_t(-2) && std::memcmp(expect.data(), actual.data(), ret)) {
+		fail(isa, "decoded bytes", str.size(), at);
+	}
+}
+
+static void check(b64_isa_t isa, const std::vector<uint8_t>& bytes) {
+	const size_t n = bytes.size();
+	std::string	 expect(b64enc_len(n), '\0'), actual(b64enc_len(n), '\0');
+	b64enc_scalar(expect.data(), bytes.data(), n);
+	b64enc_table[isa](actual.data(), bytes.data(), n);
+	if(expect != actual) {
+		fail(isa, "encoded chars", n);
+	}
+
+	// n % 3 gives no padding, 2 chars or 1 char of it
+	check_dec(isa, expect);
+	for(size_t cut = 1; cut <= 3 && cut <= expect.size(); ++cut) {
+		check_dec(isa, expect.substr(0, expect.size() - cut));
+	}
+	static const char invalid[] = { '!', '-', '_', ' ', '\n', '=', char(0x80), char(0xFF), '\0' };
+	for(size_t at = 0; at < expect.size(); ++at) {
+		std::string str = expect;
+		str[at]			= invalid[at % sizeof(invalid)];
+		check_dec(isa, str, at);
+	}
+}
+
+int main() {
+	std::mt19937 rng(42);
+	for(uint8_t i = B64_SSE41; i < B64_ISA_COUNT; ++i) {
+		const b64_isa_t isa = b64_isa_t(i);
+		if(isa > b64_isa) {
+			std::printf("%s: skipped, not supported by the CPU\n", isa_names[isa]);
+			continue;
+		}
+		const size_t before = failures;
+		for(size_t n = 0; n <= 200; ++n) { // Past 4 blocks of 48 bytes
+			std::vector<uint8_t> bytes(n);
+			for(uint8_t& byte : bytes) {
+				byte = uint8_t(rng());
+			}
+			check(isa, bytes);
+		}
+		std::printf("%s: %zu mismatches\n", isa_names[isa], failures - before);
+	}
+	return int(std::min<size_t>(failures, 255));
+}
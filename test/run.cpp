@@ -0,0 +1,387 @@
+/**
+ * @file      run.cpp
+ * @brief     Run assembled programs through every run loop & check that they agree
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/assembler.h>
+#include <vm/vm.h>
+
+#include <filesystem>
+#include <functional>
+using namespace da;
+
+// Usage: davm-test-run
+// Each program runs through one_step(), then through run_switch(), run_goto(), run_tail() & run_jit() over several slice sizes,
+// each with & without verify() first. All must stop the same way as one_step() does. Exits with the number of failed checks
+
+static size_t failures = 0;
+
+static void expect(bool ok, const std::string& what) {
+	if(!ok) {
+		++failures;
+		std::fprintf(stderr, "FAIL %s\n", what.c_str());
+	}
+}
+
+// Assemble @param source into an image in the temporary directory & load it into a new VM
+static std::unique_ptr<VM> load(const char* name, std::string_view source) {
+	image_source_t image;
+	std::string	   error;
+	if(!assemble(source, image, error, 1)) {
+		std::fprintf(stderr, "%s: %s", name, error.c_str());
+		return nullptr;
+	}
+	const std::string file = (std::filesystem::temp_directory_path() / ("davm-test-" + std::string(name) + ".img")).string();
+	auto			  vm   = std::make_unique<VM>();
+	const bool		  ok   = write_image(file, image) && vm->load(file);
+	std::filesystem::remove(file);
+	return ok ? std::move(vm) : nullptr;
+}
+
+// Run for at most @param slice commands, 0 for unlimited, one_step() ignores it
+using run_func_t = std::function<int(VM&, size_t)>;
+
+static const std::pair<const char*, run_func_t> loops[] = {
+	{ "one_step", [](VM& vm, size_t) { return vm.one_step(); } },
+	{ "run_switch", [](VM& vm, size_t slice) { return vm.run_switch(slice); } },
+#if DA_COMP_GNU
+	{ "run_goto", [](VM& vm, size_t slice) { return vm.run_goto(slice); } },
+#endif
+#if DA_HAS_MUSTTAIL
+	{ "run_tail", [](VM& vm, size_t slice) { return vm.run_tail(slice); } },
+#endif
+#if DAVM_JIT
+	{ "run_jit", [](VM& vm, size_t slice) { return vm.run_jit(slice); } },
+#endif
+};
+
+static constexpr size_t slices[] = { 0, 1, 2, 3, 5, 16, 1000 };
+
+// Addresses differ between VMs, so those into memory & the image are taken relative to them
+static constexpr addr_t REBASED_MEMORY = addr_t(1) << 62, REBASED_IMAGE = addr_t(2) << 62;
+
+static addr_t rebase(const VM& vm, addr_t value) {
+	const addr_t memory = DAVM_CAST(addr_t, vm.memory().data());
+	if(value - (memory - VM_GUARD_SIZE) <= DAVM_CAST(addr_t, vm.memory().end()) + VM_GUARD_SIZE - (memory - VM_GUARD_SIZE)) {
+		return REBASED_MEMORY | (value - memory);
+	}
+	// The read only mapping as VM::bind_bounds() sees it, context().bounds is only set once a loop touches memory
+	const image_t& image  = *vm.image();
+	const addr_t   text	  = DAVM_CAST(addr_t, image.section(IMAGE_TEXT));
+	const addr_t   rodata = DAVM_CAST(addr_t, image.section(IMAGE_RODATA));
+	const addr_t   begin  = std::min(text, rodata);
+	const addr_t   end	  = std::max(text + image.section_size(IMAGE_TEXT), rodata + image.section_size(IMAGE_RODATA));
+	if(value - begin <= end - begin) {
+		return REBASED_IMAGE | (value - begin);
+	}
+	return value;
+}
+
+// How a run went, comparable across VMs
+struct outcome_t {
+	std::vector<std::pair<int, addr_t>> stops; // Status & rebased pc of every return but the ends of slices
+	addr_t								x[32];
+	dword_t									f[32];
+	vector_t								v[32];
+	size_t									retired;
+	vm_trap_t								trap;
+
+	bool operator==(const outcome_t& other) const noexcept {
+		return stops == other.stops && !std::memcmp(x, other.x, sizeof(x)) && !std::memcmp(f, other.f, sizeof(f))
+			&& !std::memcmp(v, other.v, sizeof(v)) && retired == other.retired && trap.pc == other.trap.pc && trap.address == other.trap.address;
+	}
+};
+
+// Calls run at most this many times, so that a loop which never stops still ends the test
+static constexpr size_t RUN_CALLS = 1 << 20;
+
+// Run until a status other than 0 or 4, continuing after each ECALL
+static outcome_t run(VM& vm, const run_func_t& func, size_t slice) {
+	outcome_t out;
+	for(size_t calls = 0;; ++calls) {
+		if(calls == RUN_CALLS) {
+			out.stops.emplace_back(-1, 0);
+			break;
+		}
+		const int status = func(vm, slice);
+		if(status) {
+			out.stops.emplace_back(status, rebase(vm, DAVM_PC(vm.context())));
+		}
+		if(status && status != 4) {
+			break;
+		}
+	}
+	const vm_context_t& context = vm.context();
+	for(size_t i = 0; i < 32; ++i) {
+		out.x[i] = rebase(vm, context.x[i]);
+	}
+	std::memcpy(out.f, context.f, sizeof(out.f));
+	std::memcpy(out.v, context.v, sizeof(out.v));
+	out.retired = vm.retired();
+	out.trap	= { rebase(vm, vm.trap().pc), rebase(vm, vm.trap().address) };
+	return out;
+}
+
+static std::string describe(const outcome_t& out) {
+	std::string ret = fmt::format("retired {}, stops", out.retired);
+	for(const auto& [status, pc] : out.stops) {
+		ret += fmt::format(" {}@{:#X}", status, pc);
+	}
+	ret += fmt::format(", trap {:#X} {:#X}, x", out.trap.pc, out.trap.address);
+	for(addr_t x : out.x) {
+		ret += fmt::format(" {:X}", x);
+	}
+	return ret;
+}
+
+struct program_t {
+	const char* name;
+	std::string source;
+	int			status; // Of the last stop
+	size_t		at; // Command index of pc at the last stop, size_t(-1) if outside, as HLT leaves it
+	bool		verifiable; // Whether verify() accepts it, or the loops run it unverified
+};
+
+// Calls, recursion & most fused sequences
+static const char* const calls_source = R"(
+	.data
+arr:	.dword	1, 2, 3, 4, 5, 6, 7, 8
+	.text
+	.entry	main
+main:
+	la		x20, sum
+	la		x21, arr
+	addi	x22, zr, 3
+.rep:
+	addi	x8, zr, 0
+	push	x21
+	call	x20
+	pop		x21
+	add		x23, x23, rv
+	lui		x24, 0x12
+	addi	x24, x24, 0x345
+	add		x23, x23, x24
+	addi	x22, x22, -1
+	bne		x22, zr, .rep
+	hlt
+sum:
+	addi	x9, zr, 8
+	blt		x8, x9, .more
+	addi	rv, zr, 0
+	ret
+.more:
+	slli	x10, x8, 3
+	add		x10, x10, x21
+	ld		x11, x10, 0
+	push	x11
+	addi	x8, x8, 1
+	call	x20
+	pop		x11
+	add		rv, rv, x11
+	mov		x12, rv
+	mov		rv, x12
+	ret
+)";
+
+// The load after the loop reads the guard above the stack, with an ADD fused to it
+static const char* const load_fault_source = R"(
+	.text
+	addi	x9, zr, 5
+.loop:
+	ld		x10, sp, 0
+	ld		x11, sp, 8
+	add		x12, x10, x11
+	addi	x9, x9, -1
+	bne		x9, zr, .loop
+	addi	x8, sp, 64
+	ld		x10, x8, 0
+	add		rv, rv, x10
+	hlt
+)";
+
+// The store writes the guard below .data, after stores that succeed
+static const char* const store_fault_source = R"(
+	.data
+buf:	.dword	0, 0
+	.text
+	la		x8, buf
+	addi	x9, zr, 7
+	sd		x8, x9, 0
+	sw		x8, x9, 8
+	addi	x8, gp, -8
+	sd		x8, x9, 0
+	hlt
+)";
+
+// Each ECALL returns 4 with pc after it, the run goes on from there
+static const char* const ecall_source = R"(
+	.text
+	addi	x9, zr, 3
+.loop:
+	addi	rv, x9, 100
+	ecall
+	addi	x9, x9, -1
+	bne		x9, zr, .loop
+	ecall
+	hlt
+)";
+
+// JALR to an address outside the program stops with 1
+static const char* const jump_out_source = R"(
+	.text
+	addi	x8, zr, 0x40
+	addi	rv, zr, 1
+	jalr	zr, x8, 0
+	hlt
+)";
+
+// Falling off the end of .text stops with 1, pc just after the last command. Verify() rejects it, so the loops run unverified
+static const char* const fall_off_source = R"(
+	.text
+	addi	x9, zr, 2
+.loop:
+	addi	x9, x9, -1
+	bne		x9, zr, .loop
+	addi	rv, zr, 5
+)";
+
+// A direct jump just past the end, which verify() rejects, so the loops run unverified
+static const char* const direct_out_source = R"(
+	.text
+	addi	rv, zr, 9
+	jal		zr, 4
+	hlt
+)";
+
+// Fused sequences across the decode pages, which are VM_DECODE_PAGE bytes of byte code
+// The loop body straddles the first 2 page boundaries, a faulting LD fused with a good one straddles the third
+static std::string page_end_source() {
+	constexpr size_t page = VM_DECODE_PAGE / sizeof(word_t);
+
+	std::string source = "\t.data\narr:\t.dword\t10, 20, 30, 40, 50\n\t.text\n";
+	size_t		count  = 0;
+	const auto	emit   = [&](const char* line) {
+		   source += line;
+		   source += '\n';
+		   ++count;
+	};
+	const auto pad_to = [&](size_t index) {
+		while(count < index) {
+			emit("\taddi\tx20, x20, 1");
+		}
+	};
+	emit("\tla\t\tx21, arr");
+	++count; // LA is 2 commands
+	emit("\taddi\tx22, zr, 4");
+	source += ".loop:\n";
+	pad_to(page - 1);
+	emit("\tslli\tx10, x22, 3"); // SLLI_ADD_LD
+	emit("\tadd\t\tx10, x10, x21");
+	emit("\tld\t\tx11, x10, 0");
+	emit("\tadd\t\trv, rv, x11");
+	pad_to(2 * page - 1);
+	emit("\tld\t\tx12, x21, 8"); // LD_ADD
+	emit("\tadd\t\trv, rv, x12");
+	emit("\taddi\tx22, x22, -1");
+	emit("\tbeq\t\tx22, zr, .done");
+	emit("\tjal\t\tx26, .loop"); // Not zr, which JAL would write
+	source += ".done:\n";
+	emit("\taddi\tx8, sp, 64");
+	pad_to(3 * page - 1);
+	emit("\tld\t\tx13, x21, 0"); // LD_LD, the second one faults
+	emit("\tld\t\tx14, x8, 0");
+	emit("\thlt");
+	return source;
+}
+
+static void test_equivalence() {
+	constexpr size_t page = VM_DECODE_PAGE / sizeof(word_t);
+
+	const program_t programs[] = {
+		{ "calls", calls_source, 1, size_t(-1), true },
+		{ "load_fault", load_fault_source, 3, 7, true },
+		{ "store_fault", store_fault_source, 3, 6, true },
+		{ "ecall", ecall_source, 1, size_t(-1), true },
+		{ "jump_out", jump_out_source, 1, size_t(-1), true },
+		{ "fall_off", fall_off_source, 1, 4, false },
+		{ "direct_out", direct_out_source, 1, 3, false },
+		{ "page_end", page_end_source(), 3, 3 * page, true },
+	};
+	for(const program_t& program : programs) {
+		auto ref_vm = load(program.name, program.source);
+		expect(ref_vm != nullptr, fmt::format("{}: load", program.name));
+		if(!ref_vm) {
+			continue;
+		}
+		const outcome_t ref = run(*ref_vm, loops[0].second, 0);
+
+		// One_step() is the reference, check where it stopped first
+		const auto [status, pc] = ref.stops.back();
+		expect(status == program.status, fmt::format("{}: status {}", program.name, status));
+		if(program.at != size_t(-1)) {
+			const addr_t at = rebase(*ref_vm, DAVM_CAST(addr_t, ref_vm->code()) + program.at * sizeof(word_t));
+			expect(pc == at, fmt::format("{}: stopped at {:#X}", program.name, pc));
+			if(status == 3) {
+				expect(ref.trap.pc == at, fmt::format("{}: trap at {:#X}", program.name, ref.trap.pc));
+			}
+		}
+
+		for(size_t i = 1; i < std::size(loops); ++i) {
+			const auto& [name, func] = loops[i];
+			for(size_t slice : slices) {
+				for(bool verify : { false, true }) {
+					if(verify && !program.verifiable) {
+						continue;
+					}
+					auto vm = load(program.name, program.source);
+					if(!vm) {
+						continue;
+					}
+					if(verify) {
+						expect(vm->verify(), fmt::format("{}: verify", program.name));
+					}
+					const outcome_t out = run(*vm, func, slice);
+					expect(out == ref, fmt::format("{}: {} slice {}{} differs\n  expect {}\n  actual {}", program.name, name, slice,
+												   verify ? " verified" : "", describe(ref), describe(out)));
+				}
+			}
+		}
+	}
+}
+
+// Stores to .rodata fault in the read only mapping of the image, outside the guards of memory
+static void test_rodata_store() {
+	static constexpr std::string_view source = R"(
+	.text
+	la		x9, msg
+	addi	x8, zr, 1
+	sb		x9, x8, 0
+	hlt
+	.rodata
+msg:
+	.asciz	"hi"
+)";
+	for(const auto& [name, func] : loops) {
+		auto vm = load("rodata", source);
+		expect(vm != nullptr, "rodata: load");
+		if(!vm) {
+			return;
+		}
+		const int status = run(*vm, func, 0).stops.back().first;
+		expect(status == 3, fmt::format("rodata: {} status {}", name, status));
+		expect(vm->trap().address == vm->context().x[9], fmt::format("rodata: {} trap address {:#X}", name, vm->trap().address));
+		expect(vm->trap().pc - DAVM_CAST(addr_t, vm->code()) == 3 * sizeof(word_t), fmt::format("rodata: {} trap pc", name));
+	}
+}
+
+int main() {
+	test_rodata_store();
+	test_equivalence();
+	std::printf("%zu failures\n", failures);
+	return int(std::min<size_t>(failures, 255));
+}
@@ -0,0 +1,59 @@
+/**
+ * @file      as.cpp
+ * @brief     Assemble a source file into an image
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/assembler.h>
+using namespace da;
+
+// Usage: davm-as [-j threads] [-o image] <source>
+// The syntax is described at assemble() in vm/assembler.h, the image defaults to the source name with .img appended
+
+int main(int argc, char** argv) {
+	size_t		threads = 0;
+	std::string output;
+	int			i = 1;
+	for(; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if(argv[i] == std::string("-j")) {
+			threads = std::stoull(argv[i + 1]);
+		} else if(argv[i] == std::string("-o")) {
+			output = argv[i + 1];
+		} else {
+			break;
+		}
+	}
+	if(i + 1 != argc) {
+		std::fprintf(stderr, "Usage: %s [-j threads] [-o image] <source>\n", argv[0]);
+		return 1;
+	}
+	const std::string input = argv[i];
+	if(output.empty()) {
+		output = input + ".img";
+	}
+
+	std::ifstream file(input, std::ios::binary | std::ios::ate);
+	if(!file) {
+		std::fprintf(stderr, "Cannot open %s\n", input.c_str());
+		return 1;
+	}
+	std::string source(size_t(file.tellg()), '\0');
+	file.seekg(0);
+	file.read(source.data(), std::streamsize(source.size()));
+
+	image_source_t image;
+	std::string	   error;
+	if(!assemble(source, image, error, threads)) {
+		std::fprintf(stderr, "%s", error.c_str());
+		return 1;
+	}
+	if(!write_image(output, image)) {
+		std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+		return 1;
+	}
+	return 0;
+}
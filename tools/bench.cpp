@@ -0,0 +1,586 @@
+/**
+ * @file      bench.cpp
+ * @brief     Micro & macro benchmarks of the interpreter
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/assembler.h>
+#include <vm/vm.h>
+
+#include <common/base64.h>
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <unistd.h>
+using namespace da;
+
+// Usage: davm_bench [-r repeats] [-f filter] [-s baseline] [-b baseline] [-t percent]
+// Every benchmark runs `repeats` times (5 by default), its mean & standard deviation per unit are reported.
+// -f runs those whose name contains filter, -s saves the results to baseline, -b compares them with baseline
+// & exits with 1 if any is slower by more than `percent` (5 by default).
+// A wrong result of micro/b64dec or of a macro program exits with 1, before anything is saved or compared.
+// - micro/<table>/<command> calls each handler of the asm_table_* in common/asm.h, common/vector.h & common/float.h through a pointer, as dispatch does
+// - micro/b64enc & micro/b64dec code random bytes, per byte of raw data
+// - macro/<program>/<strategy> runs the byte code programs below to the end, per retired command
+
+inline constexpr size_t BENCH_CALLS = 4 * 1024 * 1024; // Handler calls per micro run
+inline constexpr size_t BENCH_B64	= 4 * 1024 * 1024; // Raw bytes per codec run
+
+using bench_clock_t = std::chrono::steady_clock;
+
+struct bench_result_t {
+	std::string			name;
+	const char*			unit;
+	std::vector<double> ns; // Per unit, one per run
+
+	double mean() const noexcept {
+		double sum = 0;
+		for(double x : ns) {
+			sum += x;
+		}
+		return sum / double(ns.size());
+	}
+
+	// Sample standard deviation
+	double stddev() const noexcept {
+		if(ns.size() < 2) {
+			return 0;
+		}
+		const double m	 = mean();
+		double		 sum = 0;
+		for(double x : ns) {
+			sum += (x - m) * (x - m);
+		}
+		return std::sqrt(sum / double(ns.size() - 1));
+	}
+};
+
+struct bench_t {
+	size_t						repeats = 5;
+	std::string					filter;
+	std::vector<bench_result_t> results;
+
+	bool selected(const std::string& name) const {
+		return name.find(filter) != std::string::npos;
+	}
+
+	// Run @param once @ref repeats times, it returns ns per unit
+	template<typename Func>
+	void add(std::string name, const char* unit, Func&& once) {
+		if(!selected(name)) {
+			return;
+		}
+		bench_result_t result { std::move(name), unit, {} };
+		for(size_t i = 0; i < repeats; ++i) {
+			result.ns.push_back(once());
+		}
+		const double mean = result.mean();
+		std::printf("%-32s %9.3f ns/%-4s ±%5.1f%%  %10.2f M%s/s\n", result.name.c_str(), mean, unit, mean ? 100 * result.stddev() / mean : 0, 1e3 / mean, unit);
+		std::fflush(stdout);
+		results.push_back(std::move(result));
+	}
+};
+
+static double elapsed_ns(bench_clock_t::time_point start) noexcept {
+	return double(std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock_t::now() - start).count());
+}
+
+// Micro benchmarks
+
+alignas(64) static byte_t bench_buffer[4096]; // Accessed by loads & stores
+alignas(64) static byte_t bench_stack[4096]; // Frames of stack commands, reset before each call
+
+// Operands of every handler: rd = x10, ra = x11, rb = x12, addresses in x9, targets in x13
+static vm_context_t bench_context() noexcept {
+	vm_context_t context {};
+	context.x[9]  = DAVM_CAST(da::register_t, bench_buffer);
+	context.x[11] = 12345;
+	context.x[12] = 3;
+	context.x[13] = DAVM_CAST(da::register_t, bench_buffer);
+	return context;
+}
+
+template<typename Func, typename... Args>
+static double bench_handler(Func func, Args... args) noexcept {
+	Func volatile	 handler = func; // Loaded for each call, so that it is not inlined
+	vm_context_t	 context = bench_context();
+	const da::register_t top	 = DAVM_CAST(da::register_t, bench_stack + sizeof(bench_stack) / 2);
+	const auto		 start	 = bench_clock_t::now();
+	for(size_t i = 0; i < BENCH_CALLS; ++i) {
+		DAVM_SP(context) = DAVM_BP(context) = top;
+		handler(context, args...);
+	}
+	return elapsed_ns(start) / double(BENCH_CALLS);
+}
+
+// Handlers of @param table, named as op_name from @param first on, @param count without the padding
+template<typename Func, size_t N, typename... Args>
+static void bench_table(bench_t& bench, const char* name, const Func (&table)[N], size_t count, uint8_t first, Args... args) {
+	for(size_t i = 0; i < count; ++i) {
+		bench.add(fmt::format("micro/{}/{}", name, op_name[first + i]), "call", [&] { return bench_handler(table[i], args...); });
+	}
+}
+
+static bool bench_micro(bench_t& bench) {
+	bench_table(bench, "v", asm_table_v, std::size(exec_table_v), OP_RET);
+	bench_table(bench, "r1", asm_table_r1, std::size(exec_table_r1), OP_PUSH, regid_t(13));
+	bench_table(bench, "r2", asm_table_r2, std::size(exec_table_r2), OP_MOV, regid_t(10), regid_t(11));
+	bench_table(bench, "r1i1", asm_table_r1i1, std::size(exec_table_r1i1), OP_LUI, regid_t(10), immediate_t(8));
+	bench_table(bench, "arith", asm_table_arith, std::size(exec_table_arith), OP_ADD, regid_t(10), regid_t(11), regid_t(12));
+	bench_table(bench, "load", asm_table_load, std::size(exec_table_load), OP_LB, regid_t(10), regid_t(9), immediate_t(8));
+	bench_table(bench, "save", asm_table_save, std::size(exec_table_save), OP_SB, regid_t(9), regid_t(11), immediate_t(8));
+	bench_table(bench, "imm", asm_table_imm, std::size(exec_table_imm), OP_ADDI, regid_t(10), regid_t(11), immediate_t(8));
+	bench_table(bench, "imm_shift", asm_table_imm_shift, std::size(exec_table_imm_shift), OP_SLLI, regid_t(10), regid_t(11), immediate_t(3));
+	bench_table(bench, "branch", asm_table_branch, std::size(exec_table_branch), OP_JALR, regid_t(11), regid_t(12), immediate_t(8));
+	bench_table(bench, "vector", asm_table_vector, std::size(asm_table_vector), OP_VADDB, regid_t(1), regid_t(2), regid_t(3));
+	bench_table(bench, "vector_reduce", asm_table_vector_reduce, std::size(asm_table_vector_reduce), OP_VRSUMB, regid_t(10), regid_t(2));
+	bench_table(bench, "float", asm_table_float, std::size(asm_table_float), OP_FADDS, regid_t(1), regid_t(2), regid_t(3));
+	bench_table(bench, "float_fma", asm_table_float_fma, std::size(asm_table_float_fma), OP_FMADDS, regid_t(1), regid_t(2), regid_t(3), regid_t(4));
+
+	std::vector<uint8_t> raw(BENCH_B64);
+	std::mt19937_64		 random(42);
+	for(uint8_t& b : raw) {
+		b = uint8_t(random());
+	}
+	std::vector<char> text(b64enc_len(raw.size()));
+	std::vector<uint8_t> decoded(b64dec_len(text.size()));
+	bench.add("micro/b64enc", "byte", [&] {
+		const auto start = bench_clock_t::now();
+		b64enc(text.data(), raw.data(), raw.size());
+		return elapsed_ns(start) / double(raw.size());
+	});
+	b64enc(text.data(), raw.data(), raw.size());
+	bool ok = true;
+	bench.add("micro/b64dec", "byte", [&] {
+		const auto	 start = bench_clock_t::now();
+		const size_t size  = b64dec(decoded.data(), text.data(), text.size());
+		const double ns	   = elapsed_ns(start) / double(raw.size());
+		if(size != raw.size() || std::memcmp(decoded.data(), raw.data(), size)) {
+			std::fprintf(stderr, "micro/b64dec: decoded bytes differ\n");
+			ok = false;
+		}
+		return ns;
+	});
+	return ok;
+}
+
+// Macro benchmarks, rv holds the checked result at HLT
+
+struct bench_program_t {
+	const char* name;
+	da::register_t	result;
+	const char* source;
+};
+
+static const bench_program_t bench_programs[] = {
+	{ "fib", 0x241ABABF1C960DC5, R"(; Iterative fibonacci modulo 2^64, arithmetic & a tight loop
+	.entry main
+main:
+	lui		x8, 0x800		; 8M iterations
+	addi	x9, zr, 0
+	addi	x10, zr, 1
+.loop:
+	add		x11, x9, x10
+	mov		x9, x10
+	mov		x10, x11
+	addi	x8, x8, -1
+	bne		x8, zr, .loop
+	mov		rv, x9
+	hlt
+)" },
+	{ "sieve", 82025, R"(; Sieve of Eratosthenes below 2^20, byte accesses & data dependent branches
+	.bss
+flags:	.zero	1048576
+	.text
+	.entry main
+main:
+	la		x8, flags
+	lui		x9, 0x100		; N, LUI adds to x9
+	addi	x20, zr, 4
+.rep:
+	mov		x10, x8
+	add		x11, x8, x9
+.clear:
+	sd		x10, zr, 0
+	addi	x10, x10, 8
+	bltu	x10, x11, .clear
+	addi	x12, zr, 2
+	addi	rv, zr, 0
+.outer:
+	add		x13, x8, x12
+	lbu		x14, x13, 0
+	bne		x14, zr, .next
+	addi	rv, rv, 1
+	mul		x15, x12, x12
+	bgeu	x15, x9, .next
+	addi	x16, zr, 1
+.mark:
+	add		x13, x8, x15
+	sb		x13, x16, 0
+	add		x15, x15, x12
+	bltu	x15, x9, .mark
+.next:
+	addi	x12, x12, 1
+	bltu	x12, x9, .outer
+	addi	x20, x20, -1
+	bne		x20, zr, .rep
+	hlt
+)" },
+	{ "matmul", 0x40A2A820, R"(; 64x64 matrices of 64-bit integers, C = A * B, strided loads & multiplies
+	.bss
+A:	.zero	32768
+B:	.zero	32768
+C:	.zero	32768
+	.text
+	.entry main
+main:
+	la		x8, A
+	la		x9, B
+	la		x10, C
+	addi	x11, zr, 0
+	lui		x12, 0x1		; 4096 elements
+	mov		x13, x8
+	mov		x14, x9
+.init:
+	sd		x13, x11, 0		; A[i] = i
+	add		x15, x11, x11
+	sd		x14, x15, 1		; B[i] = 2i + 1
+	addi	x13, x13, 8
+	addi	x14, x14, 8
+	addi	x11, x11, 1
+	bltu	x11, x12, .init
+	addi	x20, zr, 24
+.rep:
+	mov		x21, x10
+	mov		x16, x8
+	addi	x17, zr, 64
+.row:
+	mov		x18, x9
+	addi	x19, zr, 64
+.col:
+	addi	rv, zr, 0
+	mov		x22, x16
+	mov		x23, x18
+	addi	x24, zr, 64
+.dot:
+	ld		x25, x22, 0
+	ld		x26, x23, 0
+	mul		x25, x25, x26
+	add		rv, rv, x25
+	addi	x22, x22, 8
+	addi	x23, x23, 512
+	addi	x24, x24, -1
+	bne		x24, zr, .dot
+	sd		x21, rv, 0
+	addi	x21, x21, 8
+	addi	x18, x18, 8
+	addi	x19, x19, -1
+	bne		x19, zr, .col
+	addi	x16, x16, 512
+	addi	x17, x17, -1
+	bne		x17, zr, .row
+	addi	x20, x20, -1
+	bne		x20, zr, .rep
+	hlt
+)" },
+	{ "memcpy", 0x1FFFC000, R"(; Copy 256K between buffers, 64-bit loads & stores
+	.bss
+src:	.zero	262144
+dst:	.zero	262144
+	.text
+	.entry main
+main:
+	la		x8, src
+	la		x9, dst
+	lui		x10, 0x40		; Bytes
+	mov		x11, x8
+	add		x13, x8, x10
+	addi	x14, zr, 0
+.init:
+	sd		x11, x14, 0
+	addi	x14, x14, 1
+	addi	x11, x11, 8
+	bltu	x11, x13, .init
+	addi	x20, zr, 256
+.rep:
+	mov		x11, x8
+	mov		x12, x9
+.copy:
+	ld		x14, x11, 0
+	ld		x15, x11, 8
+	sd		x12, x14, 0
+	addi	x12, x12, 8
+	sd		x12, x15, 0
+	addi	x12, x12, 8
+	addi	x11, x11, 16
+	bltu	x11, x13, .copy
+	addi	x20, x20, -1
+	bne		x20, zr, .rep
+	mov		x11, x9			; Sum of dst
+	add		x13, x9, x10
+	addi	rv, zr, 0
+.sum:
+	ld		x14, x11, 0
+	add		rv, rv, x14
+	addi	x11, x11, 8
+	bltu	x11, x13, .sum
+	hlt
+)" },
+	{ "memcpy_bulk", 0x1FFFC000, R"(; Same copies as memcpy with one MCPY each, per retired command
+	.bss
+src:	.zero	262144
+dst:	.zero	262144
+	.text
+	.entry main
+main:
+	la		x8, src
+	la		x9, dst
+	lui		x10, 0x40		; Bytes
+	mov		x11, x8
+	add		x13, x8, x10
+	addi	x14, zr, 0
+.init:
+	sd		x11, x14, 0
+	addi	x14, x14, 1
+	addi	x11, x11, 8
+	bltu	x11, x13, .init
+	addi	x20, zr, 256
+.rep:
+	mcpy	x9, x8, x10
+	addi	x20, x20, -1
+	bne		x20, zr, .rep
+	mov		x11, x9			; Sum of dst
+	add		x13, x9, x10
+	addi	rv, zr, 0
+.sum:
+	ld		x14, x11, 0
+	add		rv, rv, x14
+	addi	x11, x11, 8
+	bltu	x11, x13, .sum
+	hlt
+)" },
+	{ "atomic", 0x80000, R"(; 256K AMOADD & 256K LR/SC increments of one counter, uncontended host atomics
+	.data
+counter:	.dword	0
+	.text
+	.entry main
+main:
+	la		x8, counter
+	lui		x20, 0x40		; Iterations
+	addi	x21, zr, 1
+.add:
+	amoaddd	x9, x8, x21
+	addi	x20, x20, -1
+	bne		x20, zr, .add
+	lui		x20, 0x40
+.lrsc:
+	lrd		x9, x8
+	addi	x9, x9, 1
+	scd		x10, x8, x9
+	bne		x10, zr, .lrsc
+	addi	x20, x20, -1
+	bne		x20, zr, .lrsc
+	ld		rv, x8, 0
+	hlt
+)" },
+	{ "checksum", 0x17E00000, R"(; Byte sum of 256K, 64 times, vector loads & reductions
+	.bss
+buf:	.zero	262144
+	.text
+	.entry main
+main:
+	la		x8, buf
+	lui		x10, 0x40		; Bytes
+	mov		x11, x8
+	add		x13, x8, x10
+	addi	x14, zr, 0
+.init:
+	sd		x11, x14, 0
+	addi	x14, x14, 1
+	addi	x11, x11, 8
+	bltu	x11, x13, .init
+	addi	x20, zr, 64
+	addi	rv, zr, 0
+.rep:
+	mov		x11, x8
+.sum:
+	vld		v1, x11, 0
+	vld		v2, x11, 16
+	vrsumb	x14, v1
+	vrsumb	x15, v2
+	add		rv, rv, x14
+	add		rv, rv, x15
+	addi	x11, x11, 32
+	bltu	x11, x13, .sum
+	addi	x20, x20, -1
+	bne		x20, zr, .rep
+	hlt
+)" },
+	{ "recursion", 832040, R"(; Recursive fibonacci(30), CALL, RET, PUSH & POP
+	.entry main
+main:
+	addi	x8, zr, 30
+	la		x20, fib
+	call	x20
+	hlt
+fib:
+	addi	x9, zr, 2
+	blt		x8, x9, .base
+	push	x8
+	addi	x8, x8, -1
+	call	x20
+	pop		x8
+	push	rv
+	addi	x8, x8, -2
+	call	x20
+	pop		x9
+	add		rv, rv, x9
+	ret
+.base:
+	mov		rv, x8
+	ret
+)" },
+};
+
+// Dispatch strategies, so that they are compared on the same programs
+struct bench_strategy_t {
+	const char* name;
+	int (VM::*run)(size_t) noexcept;
+};
+
+static const bench_strategy_t bench_strategies[] = {
+	{ "switch", &VM::run_switch },
+#if DA_COMP_GNU
+	{ "goto", &VM::run_goto },
+#endif
+#if DA_HAS_MUSTTAIL
+	{ "tail", &VM::run_tail },
+#endif
+#if DAVM_JIT
+	{ "jit", &VM::run_jit },
+#endif
+};
+
+static bool bench_macro(bench_t& bench) {
+	const std::filesystem::path dir = std::filesystem::temp_directory_path();
+	bool						ok	= true;
+	for(const bench_program_t& program : bench_programs) {
+		image_source_t source;
+		std::string	   error;
+		if(!assemble(program.source, source, error)) {
+			std::fprintf(stderr, "macro/%s: %s\n", program.name, error.c_str());
+			return false;
+		}
+		const std::string image = (dir / fmt::format("davm_bench_{}_{}.img", getpid(), program.name)).string();
+		if(!write_image(image, source)) {
+			std::fprintf(stderr, "Cannot write %s\n", image.c_str());
+			return false;
+		}
+		for(const bench_strategy_t& strategy : bench_strategies) {
+			bench.add(fmt::format("macro/{}/{}", program.name, strategy.name), "inst", [&] {
+				VM vm;
+				if(!vm.load(image)) {
+					ok = false;
+					return 0.0;
+				}
+				const auto	 start	= bench_clock_t::now();
+				const int	 status = (vm.*strategy.run)(0);
+				const double ns		= elapsed_ns(start);
+				if(status != 1 || DAVM_RV(vm.context()) != program.result) {
+					std::fprintf(stderr, "macro/%s/%s: status %d, rv %#llx instead of %#llx\n", program.name, strategy.name, status,
+								 (unsigned long long)DAVM_RV(vm.context()), (unsigned long long)program.result);
+					ok = false;
+				}
+				return ns / double(std::max<size_t>(vm.retired(), 1));
+			});
+		}
+		std::filesystem::remove(image);
+	}
+	return ok;
+}
+
+// Baseline, one line per benchmark: name, mean & standard deviation in ns per unit
+
+static bool save_baseline(const std::string& filename, const std::vector<bench_result_t>& results) {
+	std::ofstream out(filename, std::ios::trunc);
+	for(const bench_result_t& result : results) {
+		out << fmt::format("{} {:.6f} {:.6f}\n", result.name, result.mean(), result.stddev());
+	}
+	return bool(out);
+}
+
+// @return Whether none is slower than the baseline by more than @param threshold percent
+static bool compare_baseline(const std::string& filename, const std::vector<bench_result_t>& results, double threshold) {
+	std::ifstream in(filename);
+	if(!in) {
+		std::fprintf(stderr, "Cannot read %s\n", filename.c_str());
+		return false;
+	}
+	std::map<std::string, double> baseline;
+	std::string					  name;
+	double						  mean, stddev;
+	while(in >> name >> mean >> stddev) {
+		baseline[name] = mean;
+	}
+
+	bool ok = true;
+	std::printf("\nCompared with %s, threshold %.1f%%\n", filename.c_str(), threshold);
+	for(const bench_result_t& result : results) {
+		const auto it = baseline.find(result.name);
+		if(it == baseline.end() || it->second <= 0) {
+			continue;
+		}
+		const double delta = 100 * (result.mean() - it->second) / it->second;
+		const bool	 slower = delta > threshold;
+		ok &= !slower;
+		std::printf("%-32s %9.3f -> %9.3f ns/%-4s %+7.1f%%%s\n", result.name.c_str(), it->second, result.mean(), result.unit, delta,
+					slower ? "  SLOWER" : delta < -threshold ? "  faster" : "");
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	bench_t		bench;
+	std::string save, compare;
+	double		threshold = 5;
+	int			i		  = 1;
+	for(; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if(argv[i] == std::string("-r")) {
+			bench.repeats = std::max<size_t>(std::stoull(argv[i + 1]), 1);
+		} else if(argv[i] == std::string("-f")) {
+			bench.filter = argv[i + 1];
+		} else if(argv[i] == std::string("-s")) {
+			save = argv[i + 1];
+		} else if(argv[i] == std::string("-b")) {
+			compare = argv[i + 1];
+		} else if(argv[i] == std::string("-t")) {
+			threshold = std::stod(argv[i + 1]);
+		} else {
+			break;
+		}
+	}
+	if(i != argc) {
+		std::fprintf(stderr, "Usage: %s [-r repeats] [-f filter] [-s baseline] [-b baseline] [-t percent]\n", argv[0]);
+		return 1;
+	}
+
+	const bool micro = bench_micro(bench);
+	const bool ok	 = bench_macro(bench) && micro;
+	if(!ok) { // Timings of wrong results must not become the baseline
+		return 1;
+	}
+	if(!save.empty() && !save_baseline(save, bench.results)) {
+		std::fprintf(stderr, "Cannot write %s\n", save.c_str());
+		return 1;
+	}
+	if(!compare.empty() && !compare_baseline(compare, bench.results, threshold)) {
+		return 1;
+	}
+	return 0;
+}
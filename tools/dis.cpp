@@ -0,0 +1,53 @@
+/**
+ * @file      dis.cpp
+ * @brief     Disassemble the byte code of an image
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/assembler.h>
+#include <vm/image.h>
+using namespace da;
+
+// Usage: davm-dis [-j threads] [-o text] <image>
+// The .text of the image is written as dissemble() in vm/assembler.h describes, the text defaults to the image name with .s appended
+
+int main(int argc, char** argv) {
+	size_t		threads = 0;
+	std::string output;
+	int			i = 1;
+	for(; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if(argv[i] == std::string("-j")) {
+			threads = std::stoull(argv[i + 1]);
+		} else if(argv[i] == std::string("-o")) {
+			output = argv[i + 1];
+		} else {
+			break;
+		}
+	}
+	if(i + 1 != argc) {
+		std::fprintf(stderr, "Usage: %s [-j threads] [-o text] <image>\n", argv[0]);
+		return 1;
+	}
+	const std::string input = argv[i];
+	if(output.empty()) {
+		output = input + ".s";
+	}
+
+	image_t		image;
+	std::string error;
+	if(!image.open(input, error)) {
+		std::fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return 1;
+	}
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	file << "; .text of " << input << ", entry at offset " << image.header().entry << "\n";
+	if(!dissemble(image.section(IMAGE_TEXT), image.section_size(IMAGE_TEXT), file, threads)) {
+		std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file      fusion.cpp
+ * @brief     Mine the most frequent command sequences to fuse
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/vm.h>
+using namespace da;
+
+// Usage: davm-fusion [-n count] [-b budget] <program>...
+// Every program is raw byte code started at its first command, and executed for at most budget commands.
+// Executed sequences whose leading commands are straight are counted,
+// then the most frequent ones are printed as DA_X_FUSED_PAIR & DA_X_FUSED_TRIPLE to replace the lists in common/type.h
+
+struct sequence_t {
+	size_t	count;
+	uint8_t ops[3];
+};
+
+static bool run_program(const char* filename, size_t budget, std::vector<size_t>& pairs, std::vector<size_t>& triples) {
+	std::ifstream file(filename, std::ios::binary);
+	if(!file) {
+		std::fprintf(stderr, "Cannot open %s\n", filename);
+		return false;
+	}
+	VM vm;
+	vm.program().assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	vm_context_t& context = vm.context();
+	const addr_t  begin	  = DAVM_CAST(addr_t, vm.program().data());
+	const addr_t  end	  = begin + vm.program().size();
+	DAVM_PC(context)	  = begin;
+
+	uint8_t prev[2] = { OP_UNDECODED, OP_UNDECODED }; // Last two executed ops, most recent first
+	for(size_t i = 0; i < budget; ++i) {
+		const addr_t pc = DAVM_PC(context);
+		if(pc < begin || pc + sizeof(word_t) > end) {
+			break;
+		}
+		word_t code;
+		std::memcpy(&code, DAVM_CAST(const void*, pc), sizeof(code));
+		const uint8_t op = decode_inst(code).op;
+		if(vm.one_step()) {
+			break;
+		}
+		if(op > OP_GENERIC && is_straight(prev[0])) {
+			++pairs[prev[0] * OP_FUSED + op];
+			if(is_straight(prev[1])) {
+				++triples[(prev[1] * OP_FUSED + prev[0]) * OP_FUSED + op];
+			}
+		}
+		prev[1] = prev[0];
+		prev[0] = op;
+	}
+	return true;
+}
+
+static std::vector<sequence_t> top_sequences(const std::vector<size_t>& counts, size_t length, size_t n) {
+	std::vector<sequence_t> ret;
+	for(size_t i = 0; i < counts.size(); ++i) {
+		if(counts[i]) {
+			sequence_t seq { counts[i], {} };
+			for(size_t j = length, id = i; j-- > 0; id /= OP_FUSED) {
+				seq.ops[j] = uint8_t(id % OP_FUSED);
+			}
+			ret.push_back(seq);
+		}
+	}
+	std::sort(ret.begin(), ret.end(), [](const sequence_t& a, const sequence_t& b) { return a.count > b.count; });
+	ret.resize(std::min(ret.size(), n));
+	return ret;
+}
+
+static void print_list(const char* list, const std::vector<sequence_t>& seqs, size_t length) {
+	std::vector<std::string> lines;
+	for(const sequence_t& seq : seqs) {
+		std::string name, args;
+		for(size_t j = 0; j < length; ++j) {
+			name += (j ? "_" : "") + std::string(op_name[seq.ops[j]]);
+			args += ", " + std::string(op_name[seq.ops[j]]);
+		}
+		lines.push_back(fmt::format("\tDA_X({}{})", name, args));
+		std::fprintf(stderr, "%s", fmt::format("{:<24}{}\n", name, seq.count).c_str());
+	}
+	// Align the backslashes, counting the leading tab as 4 columns
+	std::string out = fmt::format("#define {}", list);
+	size_t		width = out.size();
+	for(const std::string& line : lines) {
+		width = std::max(width, line.size() + 3);
+	}
+	size_t column = out.size(); // End of the last line
+	for(const std::string& line : lines) {
+		out += fmt::format("{:<{}}\\\n{}", "", width + 1 - column, line);
+		column = line.size() + 3;
+	}
+	std::printf("%s\n\n", out.c_str());
+}
+
+int main(int argc, char** argv) {
+	size_t n	  = 16;
+	size_t budget = 100'000'000;
+	int	   i	  = 1;
+	for(; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if(argv[i] == std::string("-n")) {
+			n = std::stoull(argv[i + 1]);
+		} else if(argv[i] == std::string("-b")) {
+			budget = std::stoull(argv[i + 1]);
+		} else {
+			break;
+		}
+	}
+	if(i >= argc) {
+		std::fprintf(stderr, "Usage: %s [-n count] [-b budget] <program>...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<size_t> pairs(OP_FUSED * OP_FUSED), triples(OP_FUSED * OP_FUSED * OP_FUSED);
+	for(; i < argc; ++i) {
+		if(!run_program(argv[i], budget, pairs, triples)) {
+			return 1;
+		}
+	}
+	print_list("DA_X_FUSED_PAIR", top_sequences(pairs, 2, n), 2);
+	print_list("DA_X_FUSED_TRIPLE", top_sequences(triples, 3, n), 3);
+	return 0;
+}
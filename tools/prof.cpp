@@ -0,0 +1,90 @@
+/**
+ * @file      prof.cpp
+ * @brief     Profile an image, writing folded stacks
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/profile.h>
+#include <vm/vm.h>
+using namespace da;
+
+// Usage: davm-prof [-i commands | -t microseconds] [-o folded] <image>
+//        davm-prof -c csv | -p csv <image>
+// Runs the image until it stops, sampling every N commands (-i) or every N us of CPU time (-t, 1000 by default),
+// the folded stacks default to the image name with .folded appended, e.g. for `flamegraph.pl image.folded > image.svg`.
+// -c counts commands & blocks with VM::run_stats() instead, -p also attaches perf counters, see vm_stats_t::write_csv().
+// ECALL has no host service here, the program goes on after it.
+
+int main(int argc, char** argv) {
+	size_t		interval = 0;
+	size_t		period	 = 1000;
+	std::string output;
+	std::string counters;
+	bool		perf = false;
+	int			i	 = 1;
+	for(; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if(argv[i] == std::string("-i")) {
+			interval = std::stoull(argv[i + 1]);
+		} else if(argv[i] == std::string("-t")) {
+			period = std::stoull(argv[i + 1]);
+		} else if(argv[i] == std::string("-c") || argv[i] == std::string("-p")) {
+			counters = argv[i + 1];
+			perf	 = argv[i][1] == 'p';
+		} else if(argv[i] == std::string("-o")) {
+			output = argv[i + 1];
+		} else {
+			break;
+		}
+	}
+	if(i + 1 != argc) {
+		std::fprintf(stderr, "Usage: %s [-i commands | -t microseconds] [-o folded] <image>\n       %s -c csv | -p csv <image>\n", argv[0], argv[0]);
+		return 1;
+	}
+	const std::string input = argv[i];
+	if(output.empty()) {
+		output = input + ".folded";
+	}
+
+	VM vm;
+	if(!vm.load(input)) {
+		return 1;
+	}
+	if(!counters.empty()) {
+		vm_stats_t	stats;
+		std::string error;
+		if(perf && !stats.perf.open(error)) {
+			std::fprintf(stderr, "%s, counting commands only\n", error.c_str());
+		}
+		int status;
+		do {
+			status = vm.run_stats(stats);
+		} while(status == 4);
+		std::ofstream file(counters, std::ios::binary | std::ios::trunc);
+		stats.write_csv(file);
+		if(!file) {
+			std::fprintf(stderr, "Cannot write %s\n", counters.c_str());
+			return 1;
+		}
+		std::printf("Stopped with status %d after %zu commands in %zu blocks, counters written to %s\n", status, vm.retired(), stats.blocks.size(), counters.c_str());
+		return status > 1;
+	}
+
+	profiler_t profiler;
+	int		   status;
+	do {
+		status = interval ? profiler.run(vm, interval) : profiler.run_timer(vm, std::chrono::microseconds(period));
+	} while(status == 4);
+
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	profiler.write_folded(file, vm);
+	if(!file) {
+		std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+		return 1;
+	}
+	std::printf("Stopped with status %d after %zu commands, %zu samples written to %s\n", status, vm.retired(), profiler.samples(), output.c_str());
+	return status > 1;
+}
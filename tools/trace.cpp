@@ -0,0 +1,69 @@
+/**
+ * @file      trace.cpp
+ * @brief     Record an image into a trace with VM::run_trace(), or print a trace
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/trace.h>
+#include <vm/vm.h>
+using namespace da;
+
+// Usage: davm-trace <trace>
+//        davm-trace -r <image> <trace>
+// One line per executed command: offset in the code, accessed address as an offset in guest memory, then the command.
+// -r runs the image until it stops & records its trace instead, ECALL has no host service here, the program goes on after it.
+
+static int record(const char* image, const char* output) {
+	VM vm;
+	if(!vm.load(image)) {
+		return 1;
+	}
+	trace_writer_t writer;
+	if(!writer.open(output, vm)) {
+		std::fprintf(stderr, "Cannot create %s\n", output);
+		return 1;
+	}
+	int status;
+	do {
+		status = vm.run_trace(writer);
+	} while(status == 4);
+	if(!writer.close()) {
+		std::fprintf(stderr, "Cannot write %s\n", output);
+		return 1;
+	}
+	std::printf("Stopped with status %d after %zu commands, trace written to %s\n", status, vm.retired(), output);
+	return status > 1;
+}
+
+int main(int argc, char** argv) {
+	if(argc == 4 && argv[1] == std::string("-r")) {
+		return record(argv[2], argv[3]);
+	}
+	if(argc != 2) {
+		std::fprintf(stderr, "Usage: %s <trace>\n       %s -r <image> <trace>\n", argv[0], argv[0]);
+		return 1;
+	}
+	trace_reader_t reader;
+	std::string	   error;
+	if(!reader.open(argv[1], error)) {
+		std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+		return 1;
+	}
+	const uint64_t memory = reader.header().memory;
+	trace_step_t   step;
+	std::string	   line;
+	while(reader.next(step)) {
+		line = fmt::format("{:08X}  ", step.offset);
+		line += step.access ? fmt::format("{}[{:#010x}]  ", step.fault ? "FAULT " : "", step.address - memory) : std::string(14, ' ');
+		line += dissemble_command(step.code);
+		std::fwrite(line.data(), 1, line.size(), stdout);
+	}
+	if(reader.status() >= 0) {
+		std::printf("Stopped with status %d\n", reader.status());
+	}
+	return 0;
+}
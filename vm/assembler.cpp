@@ -0,0 +1,1106 @@
+/**
+ * @file      assembler.cpp
+ * @brief     Implemention of the assembler
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/assembler.h>
+
+#include <atomic>
+#include <charconv>
+#include <thread>
+#include <unordered_map>
+
+BEGIN_DA_NAMESPACE
+
+// Sections as seen by the assembler, .bss has no bytes in the image
+enum asm_section_t : uint8_t {
+	SECTION_TEXT   = IMAGE_TEXT,
+	SECTION_RODATA = IMAGE_RODATA,
+	SECTION_DATA   = IMAGE_DATA,
+	SECTION_BSS,
+	SECTION_COUNT,
+	SECTION_CONTINUE = SECTION_COUNT, // That of the end of the previous chunk
+};
+
+enum fixup_kind_t : uint8_t {
+	FIXUP_BRANCH, // Offset of a branch command
+	FIXUP_JAL, // Offset of JAL
+	FIXUP_LA, // Both commands of la
+	FIXUP_DWORD, // Relocated .dword
+};
+
+// Bytes of a chunk placed in a section as a whole, a chunk starts a new one at each .align
+struct fragment_t {
+	uint8_t	 buffer; // Section while parsing, possibly SECTION_CONTINUE
+	uint8_t	 section; // Set at layout
+	uint32_t line; // Where it starts
+	size_t	 align;
+	size_t	 begin; // In the buffer
+	size_t	 size = 0; // Set at the end of the chunk
+	size_t	 base = 0; // In the section, set at layout
+};
+
+struct label_t {
+	std::string_view name;
+	uint64_t		 hash;
+	uint32_t		 fragment;
+	uint32_t		 line;
+	size_t			 offset;
+};
+
+// Reference to a label, or to a literal if symbol is empty, patched once the layout is known
+struct fixup_t {
+	std::string_view symbol;
+	uint64_t		 hash; // Of symbol
+	fixup_kind_t	 kind;
+	uint8_t			 rd; // Of la
+	uint32_t		 fragment;
+	uint32_t		 line;
+	size_t			 offset;
+	int64_t			 addend; // Literal index if symbol is empty
+};
+
+struct asm_error_t {
+	size_t		line;
+	std::string reason;
+};
+
+struct chunk_t {
+	std::string_view							 source;
+	size_t										 first_line = 0; // Lines in the previous chunks
+	size_t										 lines		= 0;
+	std::vector<byte_t>							 bytes[SECTION_COUNT + 1]; // Indexed by fragment_t::buffer, .bss stays empty
+	size_t										 bss = 0; // Bytes reserved in .bss
+	uint8_t										 end_section; // Section at the end, possibly SECTION_CONTINUE
+	std::vector<fragment_t>						 fragments; // In order of creation, so of each section
+	std::vector<label_t>						 labels;
+	std::vector<fixup_t>						 fixups;
+	std::unordered_map<std::string, uint32_t>	 literal_ids;
+	std::vector<const std::string*>				 literals; // In order of first use, keys of literal_ids
+	std::vector<size_t>							 literal_offsets; // In .rodata, set at layout
+	std::vector<asm_error_t>					 errors;
+	std::vector<image_reloc_t>					 relocs;
+	std::string_view							 entry; // Last .entry of the chunk
+	size_t										 entry_line = 0;
+};
+
+struct symbol_t {
+	uint8_t section;
+	size_t	offset;
+};
+
+// Computed while parsing, so that the sequential layout only probes the table
+inline uint64_t symbol_hash(std::string_view name) noexcept {
+	return std::hash<std::string_view>()(name);
+}
+
+/**
+ * @brief Labels laid out, open addressing with linear probing
+ * @note  Filled by one thread, then only read, slots hold the hash so that probes rarely touch the source
+ */
+class symbol_table_t {
+	struct slot_t {
+		std::string_view name; // Empty if free
+		uint64_t		 hash;
+		symbol_t		 symbol;
+	};
+
+	std::vector<slot_t> m_slots;
+	size_t				m_mask = 0;
+
+public:
+	// Room for @param count labels, at most half full
+	void reserve(size_t count) {
+		size_t size = 16;
+		while(size < count * 2) {
+			size <<= 1;
+		}
+		m_slots.assign(size, slot_t {});
+		m_mask = size - 1;
+	}
+
+	// @return Whether @param name is new
+	bool insert(std::string_view name, uint64_t hash, symbol_t symbol) noexcept {
+		for(size_t i = hash & m_mask;; i = (i + 1) & m_mask) {
+			slot_t& slot = m_slots[i];
+			if(slot.name.empty()) {
+				slot = { name, hash, symbol };
+				return true;
+			}
+			if(slot.hash == hash && slot.name == name) {
+				return false;
+			}
+		}
+	}
+
+	const symbol_t* find(std::string_view name, uint64_t hash) const noexcept {
+		for(size_t i = hash & m_mask;; i = (i + 1) & m_mask) {
+			const slot_t& slot = m_slots[i];
+			if(slot.name.empty()) {
+				return nullptr;
+			}
+			if(slot.hash == hash && slot.name == name) {
+				return &slot.symbol;
+			}
+		}
+	}
+};
+
+// Run @param task for each index in [0, @param count) on up to @param threads threads
+template<typename F>
+static void parallel_for(size_t count, size_t threads, F task) {
+	std::atomic<size_t>		 next = 0;
+	auto					 work = [&] {
+		for(size_t i; (i = next++) < count;) {
+			task(i);
+		}
+	};
+	std::vector<std::thread> pool;
+	for(size_t i = 1; i < std::min(threads, count); ++i) {
+		pool.emplace_back(work);
+	}
+	work();
+	for(std::thread& thread : pool) {
+		thread.join();
+	}
+}
+
+// Encoding
+
+/**
+ * @brief  Check @param value against the immediate of plain @param op & reduce it to the width of the field
+ * @return The reason of rejection, nullptr if accepted
+ */
+static const char* encode_immediate(uint8_t op, int64_t value, uint32_t& field) noexcept {
+	auto check = [&](int64_t min, int64_t max, uint32_t mask, int shift) -> const char* {
+		DA_IF_UNLIKELY(value < min || value > max) {
+			return "Immediate out of range";
+		}
+		DA_IF_UNLIKELY(value & ((int64_t(1) << shift) - 1)) {
+			return "Odd offset";
+		}
+		field = uint32_t(value >> shift) & mask;
+		return nullptr;
+	};
+	if(op == OP_LUI || op == OP_AUIPC) {
+		return check(0, 0xFFFFF, 0xFFFFF, 0);
+	} else if(op == OP_JAL) {
+		return check(-(int64_t(1) << 20), (int64_t(1) << 20) - 2, 0xFFFFF, 1);
+	} else if(op >= OP_JALR && op <= OP_BGEU) {
+		return check(-4096, 4094, 0xFFF, 1);
+	} else if(op >= OP_SLLI && op <= OP_SRAI) {
+		return check(0, DWORD_BITS - 1, 0x3FF, 0);
+	} else if(op >= OP_SLTUI && op <= OP_XORI) { // Zero extended
+		return check(0, 4095, 0xFFF, 0);
+	} else if(op >= OP_VEXTB && op <= OP_VEXTD) { // Lane
+		return check(0, int64_t(VECTOR_BYTES >> (op - OP_VEXTB)) - 1, 0x1F, 0);
+	}
+	return check(-2048, 2047, 0xFFF, 0);
+}
+
+// Raw command of plain @param op, see decode_plain()
+static word_t encode_command(uint8_t op, uint32_t rd, uint32_t ra, uint32_t rb, uint32_t field) noexcept {
+	if(op >= OP_RET && op <= OP_ECALL) {
+		return word_t(I_RET + op - OP_RET);
+	} else if(op >= OP_PUSH && op <= OP_CALL) {
+		return word_t(I_PUSH + op - OP_PUSH) | rd << 7;
+	} else if(op == OP_MOV) {
+		return word_t(I_MOV) | rd << 7 | ra << 12;
+	} else if(op >= OP_LUI && op <= OP_JAL) {
+		return word_t(I_LUI + op - OP_LUI) | rd << 7 | field << 12;
+	} else if(op >= OP_ADD && op <= OP_XOR) {
+		return word_t(I_G_ARITH) | rd << 7 | ra << 12 | rb << 17 | uint32_t(op - OP_ADD) << 22;
+	} else if(op >= OP_SLLI && op <= OP_SRAI) {
+		return word_t(I_G_IMM) | rd << 7 | ra << 12 | uint32_t(I_G_IMM_SHIFT) << 17 | uint32_t(op - OP_SLLI) << 20 | field << 22;
+	} else if(op >= OP_VADDB && op <= OP_VSPLATD) { // The lane of VEXT goes to rb
+		const uint32_t lane = op >= OP_VEXTB && op <= OP_VEXTD ? field : rb;
+		return word_t(I_G_VECTOR) | rd << 7 | ra << 12 | uint32_t(I_G_VECTOR_R3) << 17 | lane << 20 | uint32_t(op - OP_VADDB) << 25;
+	} else if(op >= OP_FMADDS && op <= OP_FNMSUBD) { // rc is in field
+		const uint32_t id = op - OP_FMADDS;
+		return word_t(I_G_FLOAT) | rd << 7 | ra << 12 | (I_G_FLOAT_FMA_S + id / 4) << 17 | rb << 20 | field << 25 | (id % 4) << 30;
+	} else if(op >= OP_FADDS && op <= OP_FMVDX) {
+		return word_t(I_G_FLOAT) | rd << 7 | ra << 12 | uint32_t(I_G_FLOAT_R3) << 17 | rb << 20 | uint32_t(op - OP_FADDS) << 25;
+	} else if(op >= OP_MCPY && op <= OP_MLEN) { // rc is in field
+		return word_t(I_G_BULK) | rd << 7 | ra << 12 | uint32_t(op - OP_MCPY) << 17 | rb << 20 | field << 25;
+	} else if(op >= OP_LRW && op <= OP_AMOCASD) {
+		return word_t(I_G_BULK) | rd << 7 | ra << 12 | uint32_t(I_G_BULK_ATOMIC) << 17 | rb << 20 | uint32_t(op - OP_LRW) << 25;
+	}
+	uint32_t group, op2;
+	if(op >= OP_LB && op <= OP_LWU) {
+		group = I_G_LOAD, op2 = op - OP_LB;
+	} else if(op >= OP_SB && op <= OP_SD) {
+		group = I_G_SAVE, op2 = op - OP_SB;
+	} else if(op >= OP_ADDI && op <= OP_XORI) {
+		group = I_G_IMM, op2 = op - OP_ADDI;
+	} else if(op >= OP_VLD && op <= OP_VST) {
+		group = I_G_VECTOR, op2 = op - OP_VLD;
+	} else if(op >= OP_FLW && op <= OP_FSD) {
+		group = I_G_FLOAT, op2 = op - OP_FLW;
+	} else {
+		group = I_G_BRANCH, op2 = op - OP_JALR;
+	}
+	return group | rd << 7 | ra << 12 | op2 << 17 | field << 20;
+}
+
+// Raw command assemble() makes of the text of @param inst, @return Whether it accepts the immediate
+static bool encode_inst(const asm_inst_t& inst, word_t& code) noexcept {
+	const inst_type_t type = op_type[inst.op];
+	uint32_t		  field = 0;
+	if(inst.op == OP_LUI || inst.op == OP_AUIPC) { // Decoded as the upper 20 bits
+		field = uint32_t(inst.imm) >> 12;
+	} else if(type == INST_R1I1 || type == INST_R2I1) {
+		DA_IF_UNLIKELY(encode_immediate(inst.op, inst.imm, field)) {
+			return false;
+		}
+	} else if(type == INST_R4) { // rc is kept in the immediate
+		field = uint32_t(inst.imm);
+	}
+	// Only the registers in the text, as parser_t::command() reads them
+	const bool has_ra = type != INST_V && type != INST_R1 && type != INST_R1I1;
+	const bool has_rb = type == INST_R3 || type == INST_R4;
+	code			  = encode_command(inst.op, type == INST_V ? 0 : inst.rd, has_ra ? inst.ra : 0, has_rb ? inst.rb : 0, field);
+	return true;
+}
+
+// Parsing
+
+// Cursor over one line
+class line_t {
+	const char* m_pos;
+	const char* m_end;
+
+public:
+	line_t(const char* begin, const char* end) noexcept
+		: m_pos(begin)
+		, m_end(end) { }
+
+	void skip_space() noexcept {
+		while(m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t' || *m_pos == '\r')) {
+			++m_pos;
+		}
+	}
+
+	bool empty() noexcept {
+		skip_space();
+		return m_pos == m_end;
+	}
+
+	char peek() noexcept {
+		skip_space();
+		return m_pos < m_end ? *m_pos : '\0';
+	}
+
+	// Skip @param c if it comes next
+	bool accept(char c) noexcept {
+		DA_IF_LIKELY(peek() == c) {
+			++m_pos;
+			return true;
+		}
+		return false;
+	}
+
+	// Name of a label, command, register or directive, empty if none comes next
+	std::string_view word() noexcept {
+		skip_space();
+		const char* begin = m_pos;
+		while(m_pos < m_end
+			  && ((*m_pos >= 'a' && *m_pos <= 'z') || (*m_pos >= 'A' && *m_pos <= 'Z') || (*m_pos >= '0' && *m_pos <= '9')
+				  || *m_pos == '_' || *m_pos == '.' || *m_pos == '$')) {
+			++m_pos;
+		}
+		return std::string_view(begin, size_t(m_pos - begin));
+	}
+
+	// Decimal, 0x hexadecimal or 0b binary integer, optionally signed, wrapping to 64 bits
+	bool number(int64_t& value) noexcept {
+		skip_space();
+		const bool negative = m_pos < m_end && *m_pos == '-';
+		if(m_pos < m_end && (*m_pos == '-' || *m_pos == '+')) {
+			++m_pos;
+		}
+		int base = 10;
+		if(m_end - m_pos > 2 && m_pos[0] == '0' && (m_pos[1] | 0x20) == 'x') {
+			base = 16;
+			m_pos += 2;
+		} else if(m_end - m_pos > 2 && m_pos[0] == '0' && (m_pos[1] | 0x20) == 'b') {
+			base = 2;
+			m_pos += 2;
+		}
+		uint64_t magnitude;
+		const auto [end, ec] = std::from_chars(m_pos, m_end, magnitude, base);
+		DA_IF_UNLIKELY(ec != std::errc()) {
+			return false;
+		}
+		m_pos = end;
+		value = int64_t(negative ? 0 - magnitude : magnitude);
+		return true;
+	}
+
+	// Quoted string with escapes, appended to @param out
+	bool string(std::string& out) {
+		if(!accept('"')) {
+			return false;
+		}
+		while(m_pos < m_end && *m_pos != '"') {
+			char c = *m_pos++;
+			if(c == '\\') {
+				DA_IF_UNLIKELY(m_pos == m_end) {
+					return false;
+				}
+				switch(*m_pos++) {
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				case 'r': c = '\r'; break;
+				case '0': c = '\0'; break;
+				case '\\': c = '\\'; break;
+				case '"': c = '"'; break;
+				default: return false;
+				}
+			}
+			out += c;
+		}
+		return m_pos++ < m_end;
+	}
+
+	// Whether a number comes next, rather than a name
+	bool numeric() noexcept {
+		const char c = peek();
+		return (c >= '0' && c <= '9') || c == '-' || c == '+';
+	}
+};
+
+class parser_t {
+	chunk_t& m_chunk;
+	uint8_t	 m_section;
+	uint32_t m_fragment; // Current one
+	uint32_t m_last[SECTION_COUNT + 1]; // Last fragment of each section, resumed when switching back
+	uint32_t m_line = 0;
+
+public:
+	explicit parser_t(chunk_t& chunk) noexcept
+		: m_chunk(chunk) { }
+
+	void parse(bool first) {
+		std::fill(std::begin(m_last), std::end(m_last), UINT32_MAX);
+		m_section = first ? SECTION_TEXT : SECTION_CONTINUE;
+		start(1);
+		const char* pos = m_chunk.source.data();
+		const char* end = pos + m_chunk.source.size();
+		while(pos < end) {
+			const char* eol = static_cast<const char*>(std::memchr(pos, '\n', size_t(end - pos)));
+			eol				= eol ? eol : end;
+			const char* cut = pos;
+			while(cut < eol && *cut != ';' && *cut != '#' && *cut != '"') {
+				++cut;
+			}
+			if(cut < eol && *cut == '"') { // Comment chars may be quoted, look for them after the last quote
+				const char* quote = eol;
+				while(*--quote != '"') { }
+				cut = quote;
+				while(cut < eol && *cut != ';' && *cut != '#') {
+					++cut;
+				}
+			}
+			line_t line(pos, cut);
+			statement(line);
+			++m_line;
+			pos = eol + 1;
+		}
+		m_chunk.lines		= m_line;
+		m_chunk.end_section = m_section;
+		size_t next[SECTION_COUNT + 1]; // Each fragment ends where the next one of its section starts
+		for(uint8_t i = 0; i <= SECTION_COUNT; ++i) {
+			next[i] = position(i);
+		}
+		for(size_t i = m_chunk.fragments.size(); i-- > 0;) {
+			fragment_t& fragment  = m_chunk.fragments[i];
+			fragment.size		  = next[fragment.buffer] - fragment.begin;
+			next[fragment.buffer] = fragment.begin;
+		}
+	}
+
+private:
+	// Record the first error of the line
+	void fail(std::string reason) {
+		if(m_chunk.errors.size() < ASSEMBLER_ERRORS && (m_chunk.errors.empty() || m_chunk.errors.back().line != m_line)) {
+			m_chunk.errors.push_back({ m_line, std::move(reason) });
+		}
+	}
+
+	size_t position(uint8_t section) const noexcept {
+		return section == SECTION_BSS ? m_chunk.bss : m_chunk.bytes[section].size();
+	}
+
+	// Start a fragment in the current section
+	void start(size_t align) {
+		m_fragment			= uint32_t(m_chunk.fragments.size());
+		m_last[m_section]	= m_fragment;
+		fragment_t& created = m_chunk.fragments.emplace_back();
+		created.buffer		= m_section;
+		created.line		= m_line;
+		created.align		= align;
+		created.begin		= position(m_section);
+	}
+
+	// Switch to @param section, resuming its last fragment in this chunk
+	void enter(uint8_t section) {
+		m_section = section;
+		if(m_last[section] == UINT32_MAX) {
+			start(1);
+		} else {
+			m_fragment = m_last[section];
+		}
+	}
+
+	// In the current fragment
+	size_t offset() const noexcept {
+		return position(m_section) - m_chunk.fragments[m_fragment].begin;
+	}
+
+	bool writable() {
+		DA_IF_UNLIKELY(m_section == SECTION_BSS) {
+			fail("Only .zero is allowed in .bss");
+			return false;
+		}
+		return true;
+	}
+
+	// Append @param size bytes of @param value, little endian
+	bool emit(uint64_t value, size_t size) {
+		if(!writable()) {
+			return false;
+		}
+		std::vector<byte_t>& bytes = m_chunk.bytes[m_section];
+		for(size_t i = 0; i < size; ++i) {
+			bytes.push_back(byte_t(value >> (i * BYTE_BITS)));
+		}
+		return true;
+	}
+
+	void statement(line_t& line) {
+		std::string_view name = line.word();
+		while(!name.empty() && line.accept(':')) {
+			m_chunk.labels.push_back({ name, symbol_hash(name), m_fragment, m_line, offset() });
+			name = line.word();
+		}
+		if(name.empty()) {
+			if(!line.empty()) {
+				fail("Expect a command or a directive");
+			}
+			return;
+		}
+		if(name[0] == '.') {
+			directive(name, line);
+		} else {
+			command(name, line);
+		}
+		if(!line.empty()) {
+			fail("Unexpected characters at end of line");
+		}
+	}
+
+	bool reg(line_t& line, uint32_t& id, reg_file_t file = FILE_X) {
+		const std::string_view name = line.word();
+		id							= file == FILE_V ? vreg_id(name) : file == FILE_F ? freg_id(name) : reg_id(name);
+		DA_IF_UNLIKELY(id == 0xFF) {
+			fail(fmt::format("Unknown register '{}'", name));
+			return false;
+		}
+		return true;
+	}
+
+	bool comma(line_t& line) {
+		DA_IF_UNLIKELY(!line.accept(',')) {
+			fail("Expect ','");
+			return false;
+		}
+		return true;
+	}
+
+	bool number(line_t& line, int64_t& value) {
+		DA_IF_UNLIKELY(!line.number(value)) {
+			fail("Expect a number");
+			return false;
+		}
+		return true;
+	}
+
+	// Label optionally followed by +N or -N
+	bool symbol(line_t& line, std::string_view& name, int64_t& addend) {
+		name   = line.word();
+		addend = 0;
+		DA_IF_UNLIKELY(name.empty()) {
+			fail("Expect a label");
+			return false;
+		}
+		const char c = line.peek();
+		return (c != '+' && c != '-') || number(line, addend);
+	}
+
+	void fixup(fixup_kind_t kind, std::string_view symbol, int64_t addend, uint8_t rd = 0) {
+		m_chunk.fixups.push_back({ symbol, symbol.empty() ? 0 : symbol_hash(symbol), kind, rd, m_fragment, m_line, offset(), addend });
+	}
+
+	void command(std::string_view name, line_t& line) {
+		if(pack_name(name) == pack_name("LA")) {
+			return load_address(line);
+		}
+		const uint8_t op = asm_id(name);
+		DA_IF_UNLIKELY(op == OP_ERROR) {
+			return fail(fmt::format("Unknown command '{}'", name));
+		}
+		uint32_t		 rd = 0, ra = 0, rb = 0, field = 0;
+		int64_t			 value = 0;
+		std::string_view target;
+		const op_files_t files = op_files[op];
+		switch(op_type[op]) {
+		case INST_V:
+			break;
+		case INST_R1:
+			if(!reg(line, rd, files.rd)) {
+				return;
+			}
+			break;
+		case INST_R2:
+			if(!reg(line, rd, files.rd) || !comma(line) || !reg(line, ra, files.ra)) {
+				return;
+			}
+			break;
+		case INST_R3:
+			if(!reg(line, rd, files.rd) || !comma(line) || !reg(line, ra, files.ra) || !comma(line) || !reg(line, rb, files.rb)) {
+				return;
+			}
+			break;
+		case INST_R4: // rc goes to field, in the file of rb
+			if(!reg(line, rd, files.rd) || !comma(line) || !reg(line, ra, files.ra) || !comma(line) || !reg(line, rb, files.rb) || !comma(line)
+			   || !reg(line, field, files.rb)) {
+				return;
+			}
+			break;
+		case INST_R1I1:
+			if(!reg(line, rd, files.rd) || !comma(line)) {
+				return;
+			}
+			if(op == OP_JAL && !line.numeric()) {
+				target = line.word();
+			} else if(!number(line, value)) {
+				return;
+			}
+			break;
+		case INST_R2I1:
+			if(!reg(line, rd, files.rd) || !comma(line) || !reg(line, ra, files.ra) || !comma(line)) {
+				return;
+			}
+			if(op >= OP_BEQ && op <= OP_BGEU && !line.numeric()) {
+				target = line.word();
+			} else if(!number(line, value)) {
+				return;
+			}
+			break;
+		}
+		if(!target.empty()) {
+			fixup(op == OP_JAL ? FIXUP_JAL : FIXUP_BRANCH, target, 0);
+		} else if(op_type[op] == INST_R1I1 || op_type[op] == INST_R2I1) {
+			if(const char* reason = encode_immediate(op, value, field)) {
+				return fail(reason);
+			}
+		}
+		emit(encode_command(op, rd, ra, rb, field), sizeof(word_t));
+	}
+
+	// Both commands are written at layout, which tells the section of the target
+	void load_address(line_t& line) {
+		uint32_t		 rd;
+		std::string_view target;
+		int64_t			 addend;
+		if(!reg(line, rd) || !comma(line)) {
+			return;
+		}
+		if(line.peek() == '"') {
+			std::string literal;
+			if(!line.string(literal)) {
+				return fail("Bad string");
+			}
+			literal += '\0';
+			const auto [it, added] = m_chunk.literal_ids.try_emplace(std::move(literal), uint32_t(m_chunk.literals.size()));
+			if(added) {
+				m_chunk.literals.push_back(&it->first);
+			}
+			addend = it->second;
+		} else if(!symbol(line, target, addend)) {
+			return;
+		}
+		fixup(FIXUP_LA, target, addend, uint8_t(rd));
+		emit(0, sizeof(word_t) * 2);
+	}
+
+	void directive(std::string_view name, line_t& line) {
+		switch(pack_name(name.substr(1))) {
+		case pack_name("TEXT"):
+			return enter(SECTION_TEXT);
+		case pack_name("RODATA"):
+			return enter(SECTION_RODATA);
+		case pack_name("DATA"):
+			return enter(SECTION_DATA);
+		case pack_name("BSS"):
+			return enter(SECTION_BSS);
+		case pack_name("BYTE"):
+			return values(line, sizeof(byte_t));
+		case pack_name("HALF"):
+			return values(line, sizeof(hword_t));
+		case pack_name("WORD"):
+			return values(line, sizeof(word_t));
+		case pack_name("DWORD"):
+			return values(line, sizeof(dword_t));
+		case pack_name("ASCII"):
+		case pack_name("ASCIZ"): {
+			std::string text;
+			if(!line.string(text)) {
+				return fail("Bad string");
+			}
+			if(pack_name(name) == pack_name(".ASCIZ")) {
+				text += '\0';
+			}
+			if(writable()) {
+				m_chunk.bytes[m_section].insert(m_chunk.bytes[m_section].end(), text.begin(), text.end());
+			}
+			return;
+		}
+		case pack_name("ZERO"): {
+			int64_t count;
+			if(!number(line, count)) {
+				return;
+			}
+			DA_IF_UNLIKELY(count < 0 || count > int64_t(WORD_MASK)) {
+				return fail("Bad size");
+			}
+			if(m_section == SECTION_BSS) {
+				m_chunk.bss += size_t(count);
+			} else {
+				m_chunk.bytes[m_section].resize(m_chunk.bytes[m_section].size() + size_t(count));
+			}
+			return;
+		}
+		case pack_name("ALIGN"): {
+			int64_t align;
+			if(!number(line, align)) {
+				return;
+			}
+			DA_IF_UNLIKELY(align <= 0 || align > int64_t(IMAGE_ALIGN) || (align & (align - 1))) {
+				return fail("Alignment must be a power of two up to 4096");
+			}
+			return start(size_t(align));
+		}
+		case pack_name("ENTRY"):
+			m_chunk.entry	   = line.word();
+			m_chunk.entry_line = m_line;
+			if(m_chunk.entry.empty()) {
+				fail("Expect a label");
+			}
+			return;
+		default:
+			return fail(fmt::format("Unknown directive '{}'", name));
+		}
+	}
+
+	void values(line_t& line, size_t size) {
+		do {
+			int64_t value = 0;
+			if(size == sizeof(dword_t) && !line.numeric()) {
+				std::string_view target;
+				if(!symbol(line, target, value)) {
+					return;
+				}
+				fixup(FIXUP_DWORD, target, value);
+			} else if(!number(line, value)) {
+				return;
+			} else if(size < sizeof(dword_t) && (value < -(int64_t(1) << (size * BYTE_BITS - 1)) || value >= int64_t(1) << (size * BYTE_BITS))) {
+				return fail("Value out of range");
+			}
+			if(!emit(uint64_t(value), size)) {
+				return;
+			}
+		} while(line.accept(','));
+	}
+};
+
+// Layout & fixups
+
+class linker_t {
+	std::vector<chunk_t>& m_chunks;
+	image_source_t&		  m_image;
+	symbol_table_t		  m_symbols;
+	size_t				  m_sizes[SECTION_COUNT] {};
+
+public:
+	linker_t(std::vector<chunk_t>& chunks, image_source_t& image) noexcept
+		: m_chunks(chunks)
+		, m_image(image) { }
+
+	// Place fragments & literals, then collect labels, sequentially
+	void layout() {
+		uint8_t section = SECTION_TEXT; // At the end of the previous chunk
+		size_t	labels	= 0;
+		for(chunk_t& chunk : m_chunks) {
+			labels += chunk.labels.size();
+			for(fragment_t& fragment : chunk.fragments) {
+				fragment.section = fragment.buffer == SECTION_CONTINUE ? section : fragment.buffer;
+				if(fragment.section == SECTION_BSS && fragment.buffer != SECTION_BSS) {
+					const byte_t* bytes = chunk.bytes[fragment.buffer].data() + fragment.begin;
+					if(std::any_of(bytes, bytes + fragment.size, [](byte_t b) { return b != 0; })) {
+						chunk.errors.push_back({ fragment.line, "Only .zero is allowed in .bss" });
+					}
+				}
+				size_t& size  = m_sizes[fragment.section];
+				size		  = (size + fragment.align - 1) & ~(fragment.align - 1);
+				fragment.base = size;
+				size += fragment.size;
+			}
+			section = chunk.end_section == SECTION_CONTINUE ? section : chunk.end_section;
+		}
+
+		std::unordered_map<std::string_view, size_t> literals;
+		for(chunk_t& chunk : m_chunks) {
+			for(const std::string* literal : chunk.literals) {
+				const auto [it, added] = literals.try_emplace(*literal, m_sizes[SECTION_RODATA]);
+				if(added) {
+					m_sizes[SECTION_RODATA] += literal->size();
+				}
+				chunk.literal_offsets.push_back(it->second);
+			}
+		}
+
+		m_symbols.reserve(labels);
+		for(chunk_t& chunk : m_chunks) {
+			for(const label_t& label : chunk.labels) {
+				const fragment_t& fragment = chunk.fragments[label.fragment];
+				if(!m_symbols.insert(label.name, label.hash, { fragment.section, fragment.base + label.offset })) {
+					chunk.errors.push_back({ label.line, fmt::format("Label '{}' redefined", label.name) });
+				} else if(fragment.section == SECTION_TEXT && label.name[0] != '.') {
+					m_image.symbols.emplace_back(fragment.base + label.offset, label.name);
+				}
+			}
+		}
+
+		for(size_t i = 0; i < IMAGE_SECTIONS; ++i) {
+			m_image.sections[i].assign(m_sizes[i], 0);
+		}
+		m_image.bss = m_sizes[SECTION_BSS];
+		for(const chunk_t& chunk : m_chunks) {
+			for(size_t i = 0; i < chunk.literals.size(); ++i) {
+				std::copy(chunk.literals[i]->begin(), chunk.literals[i]->end(), m_image.sections[IMAGE_RODATA].begin() + ptrdiff_t(chunk.literal_offsets[i]));
+			}
+		}
+	}
+
+	// Copy the fragments of @param chunk into the image & patch its fixups, chunks may be linked in parallel
+	void link(chunk_t& chunk) const {
+		for(const fragment_t& fragment : chunk.fragments) {
+			if(fragment.section != SECTION_BSS) {
+				std::memcpy(m_image.sections[fragment.section].data() + fragment.base, chunk.bytes[fragment.buffer].data() + fragment.begin, fragment.size);
+			}
+		}
+		for(const fixup_t& fixup : chunk.fixups) {
+			const fragment_t& fragment = chunk.fragments[fixup.fragment];
+			symbol_t		  target { SECTION_RODATA, 0 };
+			int64_t			  addend = fixup.addend;
+			if(fixup.symbol.empty()) {
+				target.offset = chunk.literal_offsets[size_t(addend)];
+				addend		  = 0;
+			} else if(const symbol_t* symbol = m_symbols.find(fixup.symbol, fixup.hash)) {
+				target = *symbol;
+			} else {
+				chunk.errors.push_back({ fixup.line, fmt::format("Undefined label '{}'", fixup.symbol) });
+				continue;
+			}
+			if(const char* reason = patch(fixup, fragment, target, addend, chunk)) {
+				chunk.errors.push_back({ fixup.line, reason });
+			}
+		}
+	}
+
+	// Entry point, the last .entry wins
+	bool entry(std::string_view name, std::string& reason) const {
+		const symbol_t* symbol = m_symbols.find(name, symbol_hash(name));
+		if(!symbol || symbol->section != SECTION_TEXT || symbol->offset % sizeof(word_t)) {
+			reason = fmt::format("Entry '{}' is not a command in .text", name);
+			return false;
+		}
+		m_image.entry = symbol->offset;
+		return true;
+	}
+
+private:
+	// Offset of @param target from .text, as the image lays sections out
+	int64_t address(symbol_t target) const noexcept {
+		return int64_t(target.section == SECTION_RODATA ? image_rodata_distance(m_sizes[SECTION_TEXT]) + target.offset : target.offset);
+	}
+
+	// Offset of @param target from .data, .bss follows it
+	int64_t data_offset(symbol_t target) const noexcept {
+		return int64_t(target.section == SECTION_BSS ? m_sizes[SECTION_DATA] + target.offset : target.offset);
+	}
+
+	// @return The reason of rejection, nullptr if patched
+	const char* patch(const fixup_t& fixup, const fragment_t& fragment, symbol_t target, int64_t addend, chunk_t& chunk) const {
+		const size_t position = fragment.base + fixup.offset;
+		byte_t*		 where	  = m_image.sections[fragment.section].data() + position;
+		const bool	 data	  = target.section == SECTION_DATA || target.section == SECTION_BSS;
+		if(fixup.kind == FIXUP_DWORD) { // Offset into the section, the loader adds its address
+			DA_IF_UNLIKELY(fragment.section != SECTION_DATA) {
+				return "Labels can only be stored in .data";
+			}
+			const int64_t value = (data ? data_offset(target) : int64_t(target.offset)) + addend;
+			std::memcpy(where, &value, sizeof(value));
+			chunk.relocs.push_back({ position, data ? uint32_t(IMAGE_DATA) : uint32_t(target.section), 0 });
+			return nullptr;
+		}
+		DA_IF_UNLIKELY(fragment.section != SECTION_TEXT) {
+			return "Commands referring to labels must lie in .text";
+		}
+		word_t command[2];
+		std::memcpy(command, where, sizeof(command));
+		const int64_t next = int64_t(position + sizeof(word_t)); // pc while running the command
+		if(fixup.kind == FIXUP_LA) {
+			const uint32_t rd	 = fixup.rd;
+			const int64_t  value = data ? data_offset(target) + addend : address(target) + addend - next;
+			const int64_t  hi	 = (value + 0x800) >> 12;
+			const uint32_t lo	 = uint32_t(value - (hi << 12)) & 0xFFF;
+			DA_IF_UNLIKELY(hi < 0 || hi > 0xFFFFF) {
+				return "Target of la out of reach";
+			}
+			if(data) { // ADDI rd, gp, lo; LUI rd, hi, as LUI adds to rd
+				command[0] = encode_command(OP_ADDI, rd, 4, 0, lo);
+				command[1] = encode_command(OP_LUI, rd, 0, 0, uint32_t(hi));
+			} else { // AUIPC rd, hi; ADDI rd, rd, lo
+				command[0] = encode_command(OP_AUIPC, rd, 0, 0, uint32_t(hi));
+				command[1] = encode_command(OP_ADDI, rd, rd, 0, lo);
+			}
+		} else {
+			DA_IF_UNLIKELY(target.section != SECTION_TEXT) {
+				return "Branch target must be a label in .text";
+			}
+			uint32_t field;
+			if(const char* reason = encode_immediate(fixup.kind == FIXUP_JAL ? OP_JAL : OP_BEQ, address(target) - next, field)) {
+				return reason;
+			}
+			command[0] |= fixup.kind == FIXUP_JAL ? field << 12 : field << 20;
+		}
+		std::memcpy(where, command, fixup.kind == FIXUP_LA ? sizeof(command) : sizeof(word_t));
+		return nullptr;
+	}
+};
+
+bool assemble(std::string_view source, image_source_t& image, std::string& error, size_t threads) {
+	if(threads == 0) {
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// Split at line boundaries
+	std::vector<chunk_t> chunks;
+	const size_t		 count = std::max<size_t>(std::min(threads * 4, source.size() / ASSEMBLER_CHUNK), 1);
+	for(size_t begin = 0; begin < source.size() || chunks.empty();) {
+		size_t end = std::min(begin + source.size() / count + 1, source.size());
+		end		   = std::min(source.find('\n', end == 0 ? 0 : end - 1), source.size());
+		end += end < source.size();
+		chunks.emplace_back().source = source.substr(begin, end - begin);
+		begin						 = end;
+	}
+
+	parallel_for(chunks.size(), threads, [&](size_t i) { parser_t(chunks[i]).parse(i == 0); });
+	for(size_t i = 1; i < chunks.size(); ++i) {
+		chunks[i].first_line = chunks[i - 1].first_line + chunks[i - 1].lines;
+	}
+
+	image = image_source_t();
+	linker_t linker(chunks, image);
+	linker.layout();
+	parallel_for(chunks.size(), threads, [&](size_t i) { linker.link(chunks[i]); });
+
+	std::vector<asm_error_t> errors;
+	std::string_view		 entry;
+	size_t					 entry_line = 0;
+	for(chunk_t& chunk : chunks) {
+		for(asm_error_t& e : chunk.errors) {
+			errors.push_back({ chunk.first_line + e.line + 1, std::move(e.reason) });
+		}
+		if(!chunk.entry.empty()) {
+			entry	   = chunk.entry;
+			entry_line = chunk.first_line + chunk.entry_line + 1;
+		}
+		image.relocs.insert(image.relocs.end(), chunk.relocs.begin(), chunk.relocs.end());
+	}
+	if(std::string reason; !entry.empty() && !linker.entry(entry, reason)) {
+		errors.push_back({ entry_line, std::move(reason) });
+	}
+
+	error.clear();
+	std::stable_sort(errors.begin(), errors.end(), [](const asm_error_t& a, const asm_error_t& b) { return a.line < b.line; });
+	for(size_t i = 0; i < std::min(errors.size(), ASSEMBLER_ERRORS); ++i) {
+		error += fmt::format("line {}: {}\n", errors[i].line, errors[i].reason);
+	}
+	return errors.empty();
+}
+
+// Disassembling
+
+class disassembler_t {
+	const byte_t*					   m_program;
+	size_t							   m_size;
+	size_t							   m_count; // Whole commands
+	size_t							   m_digits = 8; // Of offsets
+	std::vector<std::atomic<uint64_t>> m_labels; // Bit per command, set if a jump targets it
+
+	word_t code(size_t index) const noexcept {
+		word_t code;
+		std::memcpy(&code, m_program + index * sizeof(word_t), sizeof(code));
+		return code;
+	}
+
+	// Offset targeted by command @param inst at @param index, or m_size if it is not a direct jump
+	uint64_t target(const asm_inst_t& inst, size_t index) const noexcept {
+		DA_IF_LIKELY(inst.op != OP_JAL && (inst.op < OP_BEQ || inst.op > OP_BGEU)) {
+			return m_size;
+		}
+		return (index + 1) * sizeof(word_t) + uint64_t(inst.imm);
+	}
+
+	bool labeled(uint64_t offset) const noexcept {
+		return offset < m_count * sizeof(word_t) && offset % sizeof(word_t) == 0
+			&& (m_labels[offset / sizeof(word_t) / DWORD_BITS].load(std::memory_order_relaxed) >> (offset / sizeof(word_t) % DWORD_BITS) & 1);
+	}
+
+	char* label(char* out, uint64_t offset) const noexcept {
+		*out++ = 'L';
+		*out++ = '_';
+		return dissemble_hex(out, offset, m_digits);
+	}
+
+public:
+	disassembler_t(const byte_t* program, size_t size)
+		: m_program(program)
+		, m_size(size)
+		, m_count(size / sizeof(word_t))
+		, m_labels((m_count + DWORD_BITS - 1) / DWORD_BITS) {
+		while(m_digits < DWORD_BITS / 4 && (size >> (m_digits * 4))) {
+			++m_digits;
+		}
+	}
+
+	size_t chunks() const noexcept {
+		return std::max<size_t>((m_count + DISASSEMBLER_CHUNK - 1) / DISASSEMBLER_CHUNK, 1);
+	}
+
+	// Chars written for @param chunk at most
+	size_t chunk_bound(size_t chunk) const noexcept {
+		return (std::min(m_count - std::min(m_count, chunk * DISASSEMBLER_CHUNK), DISASSEMBLER_CHUNK) + 1) * DISASSEMBLER_LINE;
+	}
+
+	// Find the targets of the jumps in @param chunk
+	void mark(size_t chunk) noexcept {
+		const size_t end = std::min((chunk + 1) * DISASSEMBLER_CHUNK, m_count);
+		for(size_t i = chunk * DISASSEMBLER_CHUNK; i < end; ++i) {
+			const uint64_t offset = target(decode_plain(code(i)), i);
+			if(offset < m_count * sizeof(word_t) && offset % sizeof(word_t) == 0) {
+				const size_t index = offset / sizeof(word_t);
+				m_labels[index / DWORD_BITS].fetch_or(uint64_t(1) << (index % DWORD_BITS), std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Write @param chunk once every chunk is marked, @return End of the text
+	char* write(size_t chunk, char* out) const noexcept {
+		const size_t end = std::min((chunk + 1) * DISASSEMBLER_CHUNK, m_count);
+		char		 name[DWORD_BITS / 4 + 2];
+		for(size_t i = chunk * DISASSEMBLER_CHUNK; i < end; ++i) {
+			const word_t	 raw	= code(i);
+			const asm_inst_t inst	= decode_plain(raw);
+			const uint64_t	 offset = i * sizeof(word_t);
+			word_t			 encoded;
+			if(labeled(offset)) {
+				out	   = label(out, offset);
+				*out++ = ':';
+				*out++ = '\n';
+			}
+			*out++ = '\t';
+			// Commands with bits decode_plain() ignores would come back as other words, like shifts by more than 63 that assemble() rejects
+			DA_IF_UNLIKELY(inst.op == OP_ERROR || !encode_inst(inst, encoded) || encoded != raw) {
+				std::memcpy(out, ".word\t0X", 8);
+				out = dissemble_hex(out + 8, raw, 8);
+			} else {
+				const uint64_t jump = target(inst, i);
+				out					= dissemble_inst(out, inst, labeled(jump) ? std::string_view(name, size_t(label(name, jump) - name)) : std::string_view());
+			}
+			std::memcpy(out, "\t; ", 3);
+			out	   = dissemble_hex(out + 3, offset, m_digits);
+			*out++ = ' ';
+			out	   = dissemble_hex(out, raw, 8);
+			*out++ = '\n';
+		}
+		if(end == m_count && m_size % sizeof(word_t)) { // Partial command
+			std::memcpy(out, "\t.byte\t", 7);
+			out += 7;
+			for(size_t offset = end * sizeof(word_t); offset < m_size; ++offset) {
+				std::memcpy(out, "0X", 2);
+				out = dissemble_hex(out + 2, m_program[offset], 2);
+				if(offset + 1 < m_size) {
+					*out++ = ',';
+					*out++ = ' ';
+				}
+			}
+			*out++ = '\n';
+		}
+		return out;
+	}
+};
+
+static size_t dissemble_threads(size_t threads) noexcept {
+	return threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+size_t dissemble(const byte_t* program, size_t size, char* out, size_t threads) {
+	disassembler_t disassembler(program, size);
+	const size_t   chunks = disassembler.chunks();
+	threads				  = dissemble_threads(threads);
+	parallel_for(chunks, threads, [&](size_t i) { disassembler.mark(i); });
+
+	// Chunk i is written at its bound from the start, then moved next to the previous one
+	std::vector<size_t> sizes(chunks);
+	parallel_for(chunks, threads, [&](size_t i) {
+		char* begin = out + i * DISASSEMBLER_CHUNK * DISASSEMBLER_LINE;
+		sizes[i]	= size_t(disassembler.write(i, begin) - begin);
+	});
+	size_t written = 0;
+	for(size_t i = 0; i < chunks; ++i) {
+		std::memmove(out + written, out + i * DISASSEMBLER_CHUNK * DISASSEMBLER_LINE, sizes[i]);
+		written += sizes[i];
+	}
+	return written;
+}
+
+bool dissemble(const byte_t* program, size_t size, std::ostream& out, size_t threads) {
+	disassembler_t disassembler(program, size);
+	const size_t   chunks = disassembler.chunks();
+	threads				  = dissemble_threads(threads);
+	parallel_for(chunks, threads, [&](size_t i) { disassembler.mark(i); });
+
+	// A batch of one chunk per thread is written at once, then output in order
+	const size_t					batch = std::min(threads, chunks);
+	std::vector<std::vector<char>>	buffers(batch, std::vector<char>(disassembler.chunk_bound(0)));
+	std::vector<size_t>				sizes(batch);
+	for(size_t first = 0; first < chunks && out; first += batch) {
+		const size_t count = std::min(batch, chunks - first);
+		parallel_for(count, threads, [&](size_t i) { sizes[i] = size_t(disassembler.write(first + i, buffers[i].data()) - buffers[i].data()); });
+		for(size_t i = 0; i < count; ++i) {
+			out.write(buffers[i].data(), std::streamsize(sizes[i]));
+		}
+	}
+	return bool(out);
+}
+
+END_DA_NAMESPACE
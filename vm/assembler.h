@@ -0,0 +1,82 @@
+/**
+ * @file      assembler.h
+ * @brief     Text assembler producing images & bulk disassembler
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_ASSEMBLER_H_
+#define _DAVM_VM_ASSEMBLER_H_
+
+#include <vm/pch.h>
+#include <vm/image.h>
+
+#include <ostream>
+#include <string_view>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr size_t ASSEMBLER_CHUNK	 = 1024 * 1024; // Bytes of source assembled by one task, at least
+inline constexpr size_t ASSEMBLER_ERRORS = 20; // Errors reported at most
+inline constexpr size_t DISASSEMBLER_CHUNK = 16 * 1024; // Commands written by one task
+inline constexpr size_t DISASSEMBLER_LINE  = 128; // Longest text of one command, with its label
+
+/**
+ * @brief  Assemble @param source into @param image
+ * @param  error   One line per error, "line N: reason", for the first ASSEMBLER_ERRORS errors
+ * @param  threads Threads to assemble with, 0 for one per core
+ * @return Whether @param source is assembled, @param image is unspecified otherwise
+ *
+ * One statement per line, names of commands, registers & directives are case insensitive
+ * - `label:` defines a label at the current position, a label may precede a statement on the same line.
+ *   Labels in .text are kept as symbols of the image, naming functions for profilers, unless they start with '.'
+ * - `; comment` or `# comment` lasts until the end of the line
+ * - Commands take their operands as dissemble_inst() writes them, e.g. `addi x8, zr, -1`.
+ *   Registers are named as in reg_name or x0 - x31, vector operands as in vreg_name or v0 - v31,
+ *   floating point operands as in freg_name or f0 - f31.
+ *   Branches & JAL take a label in .text, or a byte offset from the following command.
+ * - `la rd, target` loads the address of target with 2 commands, target is either
+ *   - a label, optionally followed by +N or -N
+ *     - in .text or .rodata, relative to pc, the label must lie at most 2K before the command as AUIPC only adds
+ *     - in .data or .bss, relative to gp, which points to .data at entry
+ *   - a string literal, kept once in .rodata & NUL terminated
+ * - Directives
+ *   - `.text`, `.rodata`, `.data`, `.bss` switch the section, .text at first
+ *   - `.byte`, `.half`, `.word`, `.dword` values separated by commas, .dword also takes labels in .data, which are relocated
+ *   - `.ascii "string"`, `.asciz "string"` with escapes `\n \t \r \0 \\ \"`
+ *   - `.zero N`, the only data allowed in .bss with labels
+ *   - `.align N` to a power of two up to IMAGE_ALIGN
+ *   - `.entry label` in .text, where the program starts, offset 0 by default
+ *
+ * Large sources are split at line boundaries & parsed in parallel, then the pieces are laid out in order,
+ * so the result does not depend on @param threads.
+ */
+bool assemble(std::string_view source, image_source_t& image, std::string& error, size_t threads = 0);
+
+// Chars dissemble() writes at most for @param size bytes of byte code
+inline constexpr size_t dissemble_bound(size_t size) noexcept {
+	return (size / sizeof(word_t) + 1) * DISASSEMBLER_LINE;
+}
+
+/**
+ * @brief  Write the text of byte code @param program of @param size bytes to @param out
+ * @param  out     Holds dissemble_bound(@param size) chars
+ * @param  threads Threads to write with, 0 for one per core
+ * @return Chars written
+ *
+ * Every command takes one line `\tNAME\toperands\t; offset code`, invalid ones, shifts by more than 63 & commands with bits that decoding ignores are written as `.word`.
+ * Targets of JAL & branches inside @param program get a label `L_offset` on the line before,
+ * so that assemble() takes the text back to the same byte code.
+ * Commands are formatted through tables into the output, without allocation per command,
+ * & large programs are split into chunks written in parallel.
+ */
+size_t dissemble(const byte_t* program, size_t size, char* out, size_t threads = 0);
+
+// Same as above, but written to @param out a few chunks at a time, @return Whether @param out is still good
+bool dissemble(const byte_t* program, size_t size, std::ostream& out, size_t threads = 0);
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_ASSEMBLER_H_
@@ -0,0 +1,77 @@
+/**
+ * @file      async.cpp
+ * @brief     Implemention of the coroutine API
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/async.h>
+#include <vm/vm.h>
+
+#include <cerrno>
+
+#if DAVM_ASYNC
+
+BEGIN_DA_NAMESPACE
+
+void vm_loop_t::post(std::coroutine_handle<> handle) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queue.push_back(handle);
+}
+
+size_t vm_loop_t::run() {
+	size_t count = 0;
+	for(;;) {
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_queue.empty()) {
+				return count;
+			}
+			handle = m_queue.front();
+			m_queue.pop_front();
+		}
+		handle.resume();
+		++count;
+	}
+}
+
+void vm_services_t::add(register_t id, vm_host_t service) {
+	if(id >= m_table.size()) {
+		m_table.resize(id + 1);
+	}
+	m_table[id] = std::move(service);
+}
+
+static vm_task_t<void> unknown_service(VM& vm) {
+	DAVM_RV(vm.context()) = register_t(-ENOSYS);
+	co_return;
+}
+
+vm_task_t<void> vm_services_t::operator()(VM& vm) const {
+	const register_t id = DAVM_RV(vm.context());
+	DA_IF_UNLIKELY(id >= m_table.size() || !m_table[id]) {
+		return unknown_service(vm);
+	}
+	return m_table[id](vm);
+}
+
+vm_task_t<int> VM::run_async(vm_executor_t& executor, vm_host_t host, size_t slice) {
+	for(;;) {
+		const int status = run(slice);
+		if(status == 0) {
+			co_await vm_yield_t { executor };
+		} else if(status == 4 && host) {
+			co_await host(*this);
+		} else {
+			co_return status;
+		}
+	}
+}
+
+END_DA_NAMESPACE
+
+#endif // DAVM_ASYNC
@@ -0,0 +1,243 @@
+/**
+ * @file      async.h
+ * @brief     Coroutine API suspending VMs between slices & on host calls
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_ASYNC_H_
+#define _DAVM_VM_ASYNC_H_
+
+#include <vm/pch.h>
+
+#if DA_CPP_20 && DA_HAS_INCLUDE(<coroutine>)
+	#define DAVM_ASYNC 1
+#else
+	#define DAVM_ASYNC 0
+#endif
+
+#if DAVM_ASYNC
+	#include <coroutine>
+	#include <deque>
+	#include <exception>
+	#include <functional>
+	#include <mutex>
+	#include <optional>
+	#include <utility>
+
+BEGIN_DA_NAMESPACE
+
+class VM;
+
+inline constexpr size_t VM_ASYNC_SLICE = 100000; // Commands run before a VM yields to the executor
+
+// Resumes suspended coroutines later, on any thread
+struct vm_executor_t {
+	virtual ~vm_executor_t() = default;
+
+	// Must be thread safe, @param handle is resumed exactly once
+	virtual void post(std::coroutine_handle<> handle) = 0;
+};
+
+/**
+ * @brief Lazy coroutine returning T
+ *
+ * Nothing runs until the task is awaited, or started by start() from outside any coroutine.
+ * On completion the awaiting coroutine is resumed on the same thread, the frame lives until the task is destroyed.
+ */
+template<typename T = void>
+class vm_task_t;
+
+template<typename T>
+struct vm_promise_base_t {
+	std::coroutine_handle<> continuation; // Awaiting coroutine, empty if started
+	std::exception_ptr		error;
+
+	struct final_awaiter_t {
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		template<typename P>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<P> self) noexcept {
+			const std::coroutine_handle<> next = self.promise().continuation;
+			return next ? next : std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept { }
+	};
+
+	std::suspend_always initial_suspend() const noexcept {
+		return {};
+	}
+
+	final_awaiter_t final_suspend() const noexcept {
+		return {};
+	}
+
+	void unhandled_exception() noexcept {
+		error = std::current_exception();
+	}
+};
+
+template<typename T>
+struct vm_promise_t : vm_promise_base_t<T> {
+	std::optional<T> value;
+
+	vm_task_t<T> get_return_object() noexcept;
+
+	void return_value(T result) {
+		value.emplace(std::move(result));
+	}
+
+	T result() {
+		if(this->error) {
+			std::rethrow_exception(this->error);
+		}
+		return std::move(*value);
+	}
+};
+
+template<>
+struct vm_promise_t<void> : vm_promise_base_t<void> {
+	vm_task_t<void> get_return_object() noexcept;
+
+	void return_void() const noexcept { }
+
+	void result() {
+		if(this->error) {
+			std::rethrow_exception(this->error);
+		}
+	}
+};
+
+template<typename T>
+class vm_task_t {
+public:
+	using promise_type = vm_promise_t<T>;
+	using handle_t	   = std::coroutine_handle<promise_type>;
+
+private:
+	handle_t m_handle;
+
+public:
+	explicit vm_task_t(handle_t handle) noexcept
+		: m_handle(handle) {
+	}
+
+	vm_task_t(vm_task_t&& other) noexcept
+		: m_handle(std::exchange(other.m_handle, nullptr)) {
+	}
+
+	vm_task_t& operator=(vm_task_t&& other) noexcept {
+		if(this != &other) {
+			if(m_handle) {
+				m_handle.destroy();
+			}
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	~vm_task_t() {
+		if(m_handle) {
+			m_handle.destroy();
+		}
+	}
+
+	// Run the task until its first suspension, for the root task of an executor
+	void start() noexcept {
+		m_handle.resume();
+	}
+
+	bool done() const noexcept {
+		return !m_handle || m_handle.done();
+	}
+
+	// Result of a done task, rethrowing its exception if any
+	T result() {
+		return m_handle.promise().result();
+	}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		m_handle.promise().continuation = awaiting;
+		return m_handle;
+	}
+
+	T await_resume() {
+		return m_handle.promise().result();
+	}
+};
+
+template<typename T>
+vm_task_t<T> vm_promise_t<T>::get_return_object() noexcept {
+	return vm_task_t<T>(std::coroutine_handle<vm_promise_t>::from_promise(*this));
+}
+
+inline vm_task_t<void> vm_promise_t<void>::get_return_object() noexcept {
+	return vm_task_t<void>(std::coroutine_handle<vm_promise_t>::from_promise(*this));
+}
+
+// Suspend the awaiting coroutine & queue it to @ref executor
+struct vm_yield_t {
+	vm_executor_t& executor;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) const {
+		executor.post(handle);
+	}
+
+	void await_resume() const noexcept { }
+};
+
+/**
+ * @brief Serves a host call, see asm_ecall()
+ * @note  Awaiting anything in it suspends the VM until the service completes, e.g. until I/O arrives
+ */
+using vm_host_t = std::function<vm_task_t<void>(VM&)>;
+
+/**
+ * @brief Table of host services, ECALL calls the one numbered by rv
+ * @note  Pass it as vm_host_t through std::ref(), an unknown service only sets rv to -ENOSYS
+ */
+class vm_services_t {
+	std::vector<vm_host_t> m_table;
+
+public:
+	void add(register_t id, vm_host_t service);
+
+	vm_task_t<void> operator()(VM& vm) const;
+};
+
+/**
+ * @brief Executor resuming queued coroutines on the thread calling run()
+ * @note  post() may be called from any thread, e.g. by completions of host services
+ */
+class vm_loop_t : public vm_executor_t {
+	std::mutex							m_mutex;
+	std::deque<std::coroutine_handle<>> m_queue;
+
+public:
+	void post(std::coroutine_handle<> handle) override;
+
+	/**
+	 * @brief  Resume queued coroutines until the queue is empty
+	 * @return Count of coroutines resumed
+	 */
+	size_t run();
+};
+
+END_DA_NAMESPACE
+
+#endif // DAVM_ASYNC
+
+#endif // _DAVM_VM_ASYNC_H_
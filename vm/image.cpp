@@ -0,0 +1,162 @@
+/**
+ * @file      image.cpp
+ * @brief     Implemention of executable images
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/image.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BEGIN_DA_NAMESPACE
+
+// Whether [@param offset, @param offset + @param size) lies in @param total bytes
+inline bool in_range(uint64_t offset, uint64_t size, uint64_t total) noexcept {
+	return offset <= total && size <= total - offset;
+}
+
+image_t::~image_t() {
+	if(m_base) {
+		munmap(const_cast<byte_t*>(m_base), m_size);
+	}
+}
+
+bool image_t::open(const std::string& filename, std::string& error) {
+	const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		error = fmt::format("Cannot open {}", filename);
+		return false;
+	}
+	struct stat info;
+	if(fstat(fd, &info) || size_t(info.st_size) < IMAGE_HEADER_V1) {
+		close(fd);
+		error = "File too small to be an image";
+		return false;
+	}
+	void* base = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps the file
+	if(base == MAP_FAILED) {
+		error = "Cannot map the image";
+		return false;
+	}
+	m_base = static_cast<const byte_t*>(base);
+	m_size = size_t(info.st_size);
+	m_header = {};
+	std::memcpy(&m_header, m_base, std::min(m_size, sizeof(m_header)));
+
+	if(m_header.magic != IMAGE_MAGIC || m_header.version == 0 || m_header.version > IMAGE_VERSION
+	   || (m_header.version > 1 && m_size < sizeof(m_header))) {
+		error = "Bad magic or unsupported version";
+		return false;
+	}
+	if(m_header.version == 1) {
+		m_header.symbols = m_header.symbol_count = 0;
+	}
+	for(const image_section_t& section : m_header.sections) {
+		if(!in_range(section.offset, section.size, m_size) || (section.size && section.offset % IMAGE_ALIGN)) {
+			error = "Section outside the file or misaligned";
+			return false;
+		}
+	}
+	const uint64_t text = m_header.sections[IMAGE_TEXT].size;
+	if(text % sizeof(word_t) || m_header.entry >= text || m_header.entry % sizeof(word_t)) {
+		error = "Partial command in .text or entry outside it";
+		return false;
+	}
+	if(m_header.reloc_count > m_size / sizeof(image_reloc_t) || m_header.relocs % alignof(image_reloc_t)
+	   || !in_range(m_header.relocs, m_header.reloc_count * sizeof(image_reloc_t), m_size)) {
+		error = "Relocation table outside the file";
+		return false;
+	}
+	const uint64_t data = m_header.sections[IMAGE_DATA].size;
+	for(size_t i = 0; i < m_header.reloc_count; ++i) {
+		const image_reloc_t& reloc = relocs()[i];
+		if(reloc.section >= IMAGE_SECTIONS || !in_range(reloc.offset, sizeof(uint64_t), data)) {
+			error = fmt::format("Relocation {} outside .data", i);
+			return false;
+		}
+	}
+	if(m_header.symbol_count > m_size / sizeof(image_symbol_t) || m_header.symbols % alignof(image_symbol_t)
+	   || !in_range(m_header.symbols, m_header.symbol_count * sizeof(image_symbol_t), m_size)) {
+		error = "Symbol table outside the file";
+		return false;
+	}
+	for(size_t i = 0; i < m_header.symbol_count; ++i) {
+		const image_symbol_t& symbol = symbols()[i];
+		if(symbol.offset >= text || !in_range(symbol.name, symbol.size, m_size) || (i && symbol.offset < symbols()[i - 1].offset)) {
+			error = fmt::format("Symbol {} outside .text or unsorted", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string_view image_t::symbol(uint64_t offset) const noexcept {
+	const image_symbol_t* begin = symbols();
+	const image_symbol_t* end	= begin + m_header.symbol_count;
+	const image_symbol_t* it	= std::upper_bound(begin, end, offset, [](uint64_t offset, const image_symbol_t& symbol) {
+		   return offset < symbol.offset;
+	   });
+	if(it == begin) {
+		return {};
+	}
+	--it;
+	return std::string_view(DAVM_CAST(const char*, m_base + it->name), it->size);
+}
+
+bool write_image(const std::string& filename, const image_source_t& source) {
+	image_header_t header {};
+	header.magic   = IMAGE_MAGIC;
+	header.version = IMAGE_VERSION;
+	header.entry   = source.entry;
+	header.bss	   = source.bss;
+	uint64_t end   = sizeof(header);
+	for(size_t i = 0; i < IMAGE_SECTIONS; ++i) {
+		header.sections[i] = { image_align(end), source.sections[i].size() };
+		end				   = header.sections[i].offset + header.sections[i].size;
+	}
+	header.relocs		= (end + alignof(image_reloc_t) - 1) & ~uint64_t(alignof(image_reloc_t) - 1);
+	header.reloc_count	= source.relocs.size();
+	header.symbols		= header.relocs + header.reloc_count * sizeof(image_reloc_t);
+	header.symbol_count = source.symbols.size();
+
+	// Names follow the table
+	std::vector<image_symbol_t> symbols;
+	uint64_t					names = header.symbols + header.symbol_count * sizeof(image_symbol_t);
+	for(const auto& [offset, name] : source.symbols) {
+		symbols.push_back({ offset, uint32_t(names), uint32_t(name.size()) });
+		names += name.size();
+	}
+	DA_IF_UNLIKELY(names > UINT32_MAX) {
+		return false;
+	}
+	std::vector<byte_t> file(names);
+	std::memcpy(file.data(), &header, sizeof(header));
+	for(size_t i = 0; i < IMAGE_SECTIONS; ++i) {
+		std::copy(source.sections[i].begin(), source.sections[i].end(), file.begin() + ptrdiff_t(header.sections[i].offset));
+	}
+	if(!source.relocs.empty()) {
+		std::memcpy(file.data() + header.relocs, source.relocs.data(), source.relocs.size() * sizeof(image_reloc_t));
+	}
+	for(size_t i = 0; i < symbols.size(); ++i) {
+		const std::string& name = source.symbols[i].second;
+		std::memcpy(file.data() + symbols[i].name, name.data(), name.size());
+	}
+	std::stable_sort(symbols.begin(), symbols.end(), [](const image_symbol_t& a, const image_symbol_t& b) { return a.offset < b.offset; });
+	if(!symbols.empty()) {
+		std::memcpy(file.data() + header.symbols, symbols.data(), symbols.size() * sizeof(image_symbol_t));
+	}
+
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	out.write(DAVM_CAST(const char*, file.data()), std::streamsize(file.size()));
+	return bool(out);
+}
+
+END_DA_NAMESPACE
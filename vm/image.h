@@ -0,0 +1,150 @@
+/**
+ * @file      image.h
+ * @brief     Sectioned executable image, mapped instead of read
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_IMAGE_H_
+#define _DAVM_VM_IMAGE_H_
+
+#include <vm/pch.h>
+
+#include <cstddef>
+#include <string_view>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr uint32_t IMAGE_MAGIC	= 0x4D564144; // "DAVM" in little endian
+inline constexpr uint16_t IMAGE_VERSION = 2; // Version 1 lacks the symbol table, still accepted
+inline constexpr size_t	  IMAGE_ALIGN	= 4096; // Alignment of sections in the file
+
+enum image_section_id_t : uint32_t {
+	IMAGE_TEXT, // Byte code, mapped read only
+	IMAGE_RODATA, // Mapped read only, at a fixed distance from .text so that AUIPC reaches it
+	IMAGE_DATA, // Copied to the start of guest memory, gp points to it at entry
+	IMAGE_SECTIONS
+};
+
+struct image_section_t {
+	uint64_t offset; // In the file, aligned to IMAGE_ALIGN
+	uint64_t size;
+};
+
+/**
+ * @brief Header at the start of an image, all fields little endian
+ *
+ * Sections are page aligned, so that identical images mapped by many processes share the page cache.
+ * Empty sections may have any offset.
+ */
+struct image_header_t {
+	uint32_t		magic; // IMAGE_MAGIC
+	uint16_t		version; // IMAGE_VERSION
+	uint16_t		flags; // Reserved, 0
+	uint64_t		entry; // Offset of the first command in .text
+	image_section_t sections[IMAGE_SECTIONS];
+	uint64_t		bss; // Zeroed bytes following .data in memory
+	uint64_t		relocs; // Offset of the relocation table in the file, aligned to 8
+	uint64_t		reloc_count;
+	uint64_t		symbols; // Offset of the symbol table in the file, aligned to 8, since version 2
+	uint64_t		symbol_count;
+};
+
+// Size of the header of version 1 images
+inline constexpr size_t IMAGE_HEADER_V1 = offsetof(image_header_t, symbols);
+
+// Relocation, the load address of a section is added to a 64-bit value in .data
+struct image_reloc_t {
+	uint64_t offset; // Of the value in .data
+	uint32_t section; // image_section_id_t the value is an offset into
+	uint32_t pad;
+};
+
+// Symbol, a function starting in .text, sorted by offset & lasting until the next one
+struct image_symbol_t {
+	uint64_t offset; // In .text
+	uint32_t name; // Offset of the name in the file, not NUL terminated
+	uint32_t size; // Chars of the name
+};
+
+/**
+ * @brief Image mapped read only as a whole, the mapping lives as long as the image
+ */
+class image_t {
+	const byte_t*  m_base = nullptr;
+	size_t		   m_size = 0;
+	image_header_t m_header {};
+
+public:
+	image_t() = default;
+	~image_t();
+
+	image_t(const image_t&)			   = delete;
+	image_t& operator=(const image_t&) = delete;
+
+	/**
+	 * @brief  Map @param filename & check its layout
+	 * @param  error Reason of rejection
+	 * @return Whether the image is mapped, which requires
+	 *         - the magic & version match
+	 *         - every section & the relocation table lie in the file, sections aligned to IMAGE_ALIGN
+	 *         - .text is made of whole commands & the entry is a command in it
+	 *         - every relocation patches a value inside .data
+	 *         - every symbol lies in .text, its name in the file, sorted by offset
+	 */
+	bool open(const std::string& filename, std::string& error);
+
+	const image_header_t& header() const noexcept {
+		return m_header;
+	}
+
+	const byte_t* section(image_section_id_t id) const noexcept {
+		return m_base + m_header.sections[id].offset;
+	}
+
+	size_t section_size(image_section_id_t id) const noexcept {
+		return m_header.sections[id].size;
+	}
+
+	const image_reloc_t* relocs() const noexcept {
+		return DAVM_CAST(const image_reloc_t*, m_base + m_header.relocs);
+	}
+
+	const image_symbol_t* symbols() const noexcept {
+		return DAVM_CAST(const image_symbol_t*, m_base + m_header.symbols);
+	}
+
+	// Name of the symbol @param offset in .text belongs to, empty if none precedes it
+	std::string_view symbol(uint64_t offset) const noexcept;
+};
+
+// Content of an image to write
+struct image_source_t {
+	std::vector<byte_t>		   sections[IMAGE_SECTIONS];
+	uint64_t				   bss	 = 0;
+	uint64_t				   entry = 0;
+	std::vector<image_reloc_t> relocs;
+	std::vector<std::pair<uint64_t, std::string>> symbols; // Offsets in .text & names, in any order
+};
+
+// Offset of @param offset rounded up to a section boundary
+inline constexpr uint64_t image_align(uint64_t offset) noexcept {
+	return (offset + IMAGE_ALIGN - 1) & ~uint64_t(IMAGE_ALIGN - 1);
+}
+
+// Distance from .text to .rodata in images laid out by write_image(), sections follow each other in order
+inline constexpr uint64_t image_rodata_distance(uint64_t text_size) noexcept {
+	return image_align(text_size);
+}
+
+/**
+ * @brief  Lay out @param source as an image & write it to @param filename
+ * @return Whether the file is written
+ */
+bool write_image(const std::string& filename, const image_source_t& source);
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_IMAGE_H_
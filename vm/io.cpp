@@ -0,0 +1,475 @@
+/**
+ * @file      io.cpp
+ * @brief     Implemention of batched asynchronous guest I/O
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/io.h>
+#include <vm/vm.h>
+
+#if DAVM_IO
+
+	#include <atomic>
+	#include <cerrno>
+	#include <linux/io_uring.h>
+	#include <linux/openat2.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+
+BEGIN_DA_NAMESPACE
+
+// io_uring through raw syscalls, the rings are shared with the kernel
+struct vm_io_t::uring_t {
+	int			   fd	   = -1;
+	byte_t*		   sq_ring = nullptr;
+	byte_t*		   cq_ring = nullptr;
+	io_uring_sqe*  sqes	   = nullptr;
+	size_t		   sq_size = 0;
+	size_t		   cq_size = 0;
+	io_uring_params params {};
+	uint32_t	   pending = 0; // Queued but not submitted yet
+
+	uint32_t* sq_field(uint32_t offset) const noexcept {
+		return DAVM_CAST(uint32_t*, sq_ring + offset);
+	}
+
+	uint32_t* cq_field(uint32_t offset) const noexcept {
+		return DAVM_CAST(uint32_t*, cq_ring + offset);
+	}
+
+	// Whether the kernel supports io_uring & the rings are mapped
+	bool open(uint32_t entries) noexcept {
+		fd = int(syscall(__NR_io_uring_setup, entries, &params));
+		DA_IF_UNLIKELY(fd < 0) {
+			return false;
+		}
+		sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+		if(single) {
+			sq_size = cq_size = std::max(sq_size, cq_size);
+		}
+		void* sq = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		DA_IF_UNLIKELY(sq == MAP_FAILED) {
+			return false;
+		}
+		sq_ring = static_cast<byte_t*>(sq);
+		if(single) {
+			cq_ring = sq_ring;
+		} else {
+			void* cq = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			DA_IF_UNLIKELY(cq == MAP_FAILED) {
+				return false;
+			}
+			cq_ring = static_cast<byte_t*>(cq);
+		}
+		void* s = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		DA_IF_UNLIKELY(s == MAP_FAILED) {
+			return false;
+		}
+		sqes = static_cast<io_uring_sqe*>(s);
+		return true;
+	}
+
+	~uring_t() {
+		if(sqes) {
+			munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+		}
+		if(cq_ring && cq_ring != sq_ring) {
+			munmap(cq_ring, cq_size);
+		}
+		if(sq_ring) {
+			munmap(sq_ring, sq_size);
+		}
+		if(fd >= 0) {
+			close(fd);
+		}
+	}
+
+	// Hand queued entries to the kernel, waiting for @param wait completions
+	void enter(uint32_t wait) noexcept {
+		for(;;) {
+			const int n = int(syscall(__NR_io_uring_enter, fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+			if(n >= 0) {
+				pending -= std::min(pending, uint32_t(n));
+				return;
+			}
+			DA_IF_UNLIKELY(errno != EINTR) {
+				return; // Left pending for the next call
+			}
+		}
+	}
+
+	// Next free entry, submitting the queued ones first if the ring is full
+	io_uring_sqe* next() noexcept {
+		std::atomic_ref<uint32_t> head(*sq_field(params.sq_off.head));
+		const uint32_t			  tail = *sq_field(params.sq_off.tail);
+		while(tail - head.load(std::memory_order_acquire) >= params.sq_entries) {
+			enter(0);
+		}
+		io_uring_sqe* sqe = &sqes[tail & *sq_field(params.sq_off.ring_mask)];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	// Publish the entry returned by next()
+	void push() noexcept {
+		const uint32_t tail = *sq_field(params.sq_off.tail);
+		const uint32_t mask = *sq_field(params.sq_off.ring_mask);
+		sq_field(params.sq_off.array)[tail & mask] = tail & mask;
+		std::atomic_ref<uint32_t>(*sq_field(params.sq_off.tail)).store(tail + 1, std::memory_order_release);
+		++pending;
+	}
+
+	// Call @param f with every completion
+	template<typename F>
+	size_t reap(F&& f) {
+		std::atomic_ref<uint32_t> head(*cq_field(params.cq_off.head));
+		std::atomic_ref<uint32_t> tail(*cq_field(params.cq_off.tail));
+		const uint32_t			  mask	= *cq_field(params.cq_off.ring_mask);
+		const io_uring_cqe*		  cqes	= DAVM_CAST(const io_uring_cqe*, cq_ring + params.cq_off.cqes);
+		size_t					  count = 0;
+		for(uint32_t i = head.load(std::memory_order_relaxed); i != tail.load(std::memory_order_acquire); ++i, ++count) {
+			const io_uring_cqe cqe = cqes[i & mask];
+			head.store(i + 1, std::memory_order_release);
+			f(cqe);
+		}
+		return count;
+	}
+};
+
+// Ring & files of one VM
+struct vm_io_t::guest_t {
+	VM*						vm;
+	vm_ring_t*				ring	 = nullptr;
+	uint32_t				entries	 = 0; // Of the ring, kept here as the guest may rewrite its own copy
+	uint32_t				inflight = 0;
+	uint32_t				wanted	 = 0; // Completions the parked guest waits for
+	std::coroutine_handle<> parked; // Empty if not parked
+	std::vector<int>		files; // Guest file -> host file, -1 if free
+
+	vm_sqe_t* sq() const noexcept {
+		return DAVM_CAST(vm_sqe_t*, ring + 1);
+	}
+
+	vm_cqe_t* cq() const noexcept {
+		return DAVM_CAST(vm_cqe_t*, sq() + entries);
+	}
+
+	// Completions not consumed yet, cq_head is trusted no further than the ring size
+	uint32_t ready() const noexcept {
+		return std::min(ring->cq_tail - ring->cq_head, entries);
+	}
+
+	// Whether a new request may be taken, so that its completion never overwrites an unconsumed one
+	bool room() const noexcept {
+		return inflight + ready() < entries;
+	}
+};
+
+// Request in flight, owned by the kernel until its completion
+struct vm_io_t::op_t {
+	guest_t* guest;
+	uint64_t user_data;
+	uint8_t	 code; // vm_io_op_t
+	int		 fd	  = -1; // Host file
+	int		 slot = -1; // Guest file reserved by VM_IO_OPEN
+	uint64_t addr = 0;
+	uint32_t len  = 0;
+	uint64_t offset = 0;
+	open_how how {};
+};
+
+// Suspend the guest until it has the completions it waits for
+struct vm_io_t::park_t {
+	guest_t& guest;
+
+	bool await_ready() const noexcept {
+		return guest.ready() >= guest.wanted;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) const noexcept {
+		guest.parked = handle;
+	}
+
+	void await_resume() const noexcept { }
+};
+
+// Whether [@param addr, @param addr + @param len) lies in the memory of @param vm
+static bool in_memory(VM& vm, uint64_t addr, uint64_t len) noexcept {
+	const uint64_t begin = DAVM_CAST(uint64_t, vm.memory().begin());
+	const uint64_t end	 = DAVM_CAST(uint64_t, vm.memory().end());
+	return addr >= begin && addr <= end && len <= end - addr;
+}
+
+vm_io_t::vm_io_t(vm_executor_t& executor, int root)
+	: m_executor(executor)
+	, m_root(root)
+	, m_uring(std::make_unique<uring_t>()) {
+	if(!m_uring->open(VM_IO_URING_SIZE)) {
+		m_uring.reset();
+	}
+}
+
+vm_io_t::~vm_io_t() {
+	while(m_inflight) {
+		poll(true);
+	}
+	for(auto& [vm, guest] : m_guests) {
+		for(int fd : guest->files) {
+			if(fd >= 0) {
+				close(fd);
+			}
+		}
+	}
+}
+
+void vm_io_t::install(vm_services_t& services) {
+	services.add(VM_SERVICE_IO_SETUP, [this](VM& vm) { return setup(vm); });
+	services.add(VM_SERVICE_IO_ENTER, [this](VM& vm) { return enter(vm); });
+}
+
+vm_io_t::guest_t& vm_io_t::guest(VM& vm) {
+	std::unique_ptr<guest_t>& guest = m_guests[&vm];
+	if(!guest) {
+		guest	  = std::make_unique<guest_t>();
+		guest->vm = &vm;
+	}
+	return *guest;
+}
+
+int vm_io_t::grant(VM& vm, int fd) {
+	guest_t& g = guest(vm);
+	auto	 slot = std::find(g.files.begin(), g.files.end(), -1);
+	DA_IF_UNLIKELY(slot == g.files.end() && g.files.size() >= VM_IO_MAX_FILES) {
+		return -EMFILE;
+	}
+	const int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	DA_IF_UNLIKELY(copy < 0) {
+		return -errno;
+	}
+	if(slot == g.files.end()) {
+		g.files.push_back(copy);
+		return int(g.files.size() - 1);
+	}
+	*slot = copy;
+	return int(slot - g.files.begin());
+}
+
+void vm_io_t::detach(VM& vm) {
+	auto it = m_guests.find(&vm);
+	if(it == m_guests.end()) {
+		return;
+	}
+	while(it->second->inflight) {
+		poll(true);
+	}
+	for(int fd : it->second->files) {
+		if(fd >= 0) {
+			close(fd);
+		}
+	}
+	m_guests.erase(it);
+}
+
+size_t vm_io_t::poll(bool wait) {
+	if(!m_uring) {
+		return 0; // Completed at submission
+	}
+	if(m_uring->pending || (wait && m_inflight)) {
+		m_uring->enter(wait && m_inflight ? 1 : 0);
+	}
+	return m_uring->reap([this](const io_uring_cqe& cqe) {
+		finish(DAVM_CAST(op_t*, cqe.user_data), cqe.res);
+	});
+}
+
+vm_task_t<void> vm_io_t::setup(VM& vm) {
+	vm_context_t&  context = vm.context();
+	const uint64_t addr	   = context.x[8];
+	const uint64_t entries = context.x[9];
+	guest_t&	   g	   = guest(vm);
+	DA_IF_UNLIKELY(g.inflight) {
+		DAVM_RV(context) = register_t(-EBUSY);
+		co_return;
+	}
+	DA_IF_UNLIKELY(entries == 0 || entries > VM_IO_MAX_ENTRIES || (entries & (entries - 1)) || (addr & 7)
+				   || !in_memory(vm, addr, sizeof(vm_ring_t) + entries * (sizeof(vm_sqe_t) + sizeof(vm_cqe_t)))) {
+		DAVM_RV(context) = register_t(-EINVAL);
+		co_return;
+	}
+	g.ring			 = DAVM_CAST(vm_ring_t*, addr);
+	g.entries		 = uint32_t(entries);
+	*g.ring			 = { 0, 0, 0, 0, g.entries, 0 };
+	DAVM_RV(context) = 0;
+}
+
+vm_task_t<void> vm_io_t::enter(VM& vm) {
+	vm_context_t& context = vm.context();
+	auto		  it	  = m_guests.find(&vm);
+	DA_IF_UNLIKELY(it == m_guests.end() || !it->second->ring) {
+		DAVM_RV(context) = register_t(-EINVAL);
+		co_return;
+	}
+	guest_t&   g	= *it->second;
+	vm_ring_t& ring = *g.ring;
+	vm.memory(); // Completions write memory
+	const size_t capacity = m_uring ? m_uring->params.cq_entries : SIZE_MAX; // Never overflow the host ring
+	uint32_t	 submitted = 0;
+	while(ring.sq_head != ring.sq_tail && submitted < g.entries && g.room() && m_inflight < capacity) {
+		const vm_sqe_t sqe = g.sq()[ring.sq_head & (g.entries - 1)];
+		++ring.sq_head;
+		submit(g, sqe);
+		++submitted;
+	}
+	if(m_uring && m_uring->pending) {
+		m_uring->enter(0);
+	}
+	g.wanted = uint32_t(std::min<uint64_t>(context.x[8], g.ready() + g.inflight));
+	co_await park_t { g };
+	DAVM_RV(context) = submitted;
+}
+
+void vm_io_t::submit(guest_t& g, const vm_sqe_t& sqe) {
+	op_t* op = new op_t { &g, sqe.user_data, sqe.op };
+	++g.inflight;
+	++m_inflight;
+	const int64_t error = prepare(g, sqe, *op);
+	DA_IF_UNLIKELY(error) {
+		finish(op, error);
+		return;
+	}
+	if(!m_uring) {
+		finish(op, execute(*op));
+		return;
+	}
+	io_uring_sqe* s = m_uring->next();
+	s->user_data	= DAVM_CAST(uint64_t, op);
+	switch(op->code) {
+	case VM_IO_NOP:
+		s->opcode = IORING_OP_NOP;
+		break;
+	case VM_IO_OPEN:
+		s->opcode = IORING_OP_OPENAT2;
+		s->fd	  = m_root;
+		s->addr	  = op->addr;
+		s->len	  = sizeof(open_how);
+		s->off	  = DAVM_CAST(uint64_t, &op->how);
+		break;
+	case VM_IO_CLOSE:
+		s->opcode = IORING_OP_CLOSE;
+		s->fd	  = op->fd;
+		break;
+	case VM_IO_READ:
+	case VM_IO_WRITE:
+		s->opcode = op->code == VM_IO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+		s->fd	  = op->fd;
+		s->addr	  = op->addr;
+		s->len	  = op->len;
+		s->off	  = op->offset;
+		break;
+	}
+	m_uring->push();
+}
+
+// Check a request & translate it to host terms, @return -errno if it fails without running
+int64_t vm_io_t::prepare(guest_t& g, const vm_sqe_t& sqe, op_t& op) {
+	VM& vm = *g.vm;
+	switch(sqe.op) {
+	case VM_IO_NOP:
+		return 0;
+	case VM_IO_OPEN: {
+		const byte_t* path = DAVM_CAST(const byte_t*, sqe.addr);
+		DA_IF_UNLIKELY(!in_memory(vm, sqe.addr, 0) || !std::memchr(path, 0, size_t(vm.memory().end() - path))) {
+			return -EFAULT;
+		}
+		auto slot = std::find(g.files.begin(), g.files.end(), -1);
+		if(slot == g.files.end()) {
+			DA_IF_UNLIKELY(g.files.size() >= VM_IO_MAX_FILES) {
+				return -EMFILE;
+			}
+			slot = g.files.insert(slot, -1);
+		}
+		*slot	  = -2; // Reserved until opened
+		op.slot	  = int(slot - g.files.begin());
+		op.addr	  = sqe.addr;
+		op.how	  = {};
+		op.how.flags = (sqe.len & (O_ACCMODE | O_CREAT | O_EXCL | O_TRUNC | O_APPEND | O_DIRECTORY | O_NOFOLLOW)) | O_CLOEXEC;
+		op.how.mode	 = op.how.flags & O_CREAT ? sqe.offset & 07777 : 0;
+		op.how.resolve = m_root == AT_FDCWD ? 0 : RESOLVE_BENEATH;
+		return 0;
+	}
+	case VM_IO_CLOSE:
+	case VM_IO_READ:
+	case VM_IO_WRITE: {
+		DA_IF_UNLIKELY(sqe.fd < 0 || size_t(sqe.fd) >= g.files.size() || g.files[size_t(sqe.fd)] < 0) {
+			return -EBADF;
+		}
+		op.fd = g.files[size_t(sqe.fd)];
+		if(sqe.op == VM_IO_CLOSE) {
+			g.files[size_t(sqe.fd)] = -1;
+			return 0;
+		}
+		op.addr	  = sqe.addr;
+		op.len	  = uint32_t(std::min<uint64_t>(sqe.len, VM_IO_MAX_LENGTH));
+		op.offset = sqe.offset;
+		DA_IF_UNLIKELY(!in_memory(vm, op.addr, op.len)) {
+			return -EFAULT;
+		}
+		return 0;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+// Run a prepared request synchronously, for hosts without io_uring
+int64_t vm_io_t::execute(op_t& op) {
+	int64_t res = 0;
+	switch(op.code) {
+	case VM_IO_OPEN:
+		res = syscall(SYS_openat2, m_root, DAVM_CAST(const char*, op.addr), &op.how, sizeof(open_how));
+		break;
+	case VM_IO_CLOSE:
+		res = close(op.fd);
+		break;
+	case VM_IO_READ:
+		res = op.offset == ~uint64_t(0) ? read(op.fd, DAVM_CAST(void*, op.addr), op.len)
+										: pread(op.fd, DAVM_CAST(void*, op.addr), op.len, off_t(op.offset));
+		break;
+	case VM_IO_WRITE:
+		res = op.offset == ~uint64_t(0) ? write(op.fd, DAVM_CAST(const void*, op.addr), op.len)
+										: pwrite(op.fd, DAVM_CAST(const void*, op.addr), op.len, off_t(op.offset));
+		break;
+	}
+	return res < 0 ? -errno : res;
+}
+
+// Post the completion of @param op to its guest, & resume the guest once it has all it waits for
+void vm_io_t::finish(op_t* op, int64_t res) {
+	guest_t& g = *op->guest;
+	if(op->slot >= 0) {
+		g.files[size_t(op->slot)] = res >= 0 ? int(res) : -1;
+		if(res >= 0) {
+			res = op->slot;
+		}
+	}
+	vm_ring_t& ring							= *g.ring;
+	g.cq()[ring.cq_tail & (g.entries - 1)]	= { op->user_data, res };
+	++ring.cq_tail;
+	--g.inflight;
+	--m_inflight;
+	delete op;
+	if(g.parked && g.ready() >= g.wanted) {
+		m_executor.post(std::exchange(g.parked, nullptr));
+	}
+}
+
+END_DA_NAMESPACE
+
+#endif // DAVM_IO
@@ -0,0 +1,161 @@
+/**
+ * @file      io.h
+ * @brief     Batched asynchronous guest I/O through a ring in guest memory
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_IO_H_
+#define _DAVM_VM_IO_H_
+
+#include <vm/pch.h>
+#include <vm/async.h>
+
+#if DAVM_ASYNC && defined(__linux__)
+	#define DAVM_IO 1
+#else
+	#define DAVM_IO 0
+#endif
+
+#if DAVM_IO
+	#include <fcntl.h>
+	#include <unordered_map>
+
+BEGIN_DA_NAMESPACE
+
+class VM;
+
+// Services installed by vm_io_t::install(), rv is -errno on failure
+inline constexpr register_t VM_SERVICE_IO_SETUP = 1; // x8 = ring, x9 = entries, rv = 0
+inline constexpr register_t VM_SERVICE_IO_ENTER = 2; // x8 = completions to wait for, rv = requests submitted
+
+inline constexpr uint32_t VM_IO_MAX_ENTRIES = 4096; // Entries of one guest ring
+inline constexpr uint32_t VM_IO_MAX_FILES	= 1024; // Files opened by one guest
+inline constexpr uint32_t VM_IO_MAX_LENGTH	= 0x7FFFF000; // Larger requests complete short, as read(2) does
+inline constexpr uint32_t VM_IO_URING_SIZE	= 256; // Entries of the host ring
+
+enum vm_io_op_t : uint8_t {
+	VM_IO_NOP,
+	VM_IO_OPEN, // addr = NUL terminated path, len = flags, offset = mode, res = guest fd
+	VM_IO_CLOSE,
+	VM_IO_READ, // addr = buffer, offset = file offset, or -1 for the current position
+	VM_IO_WRITE,
+};
+
+// Request, written by the guest
+struct vm_sqe_t {
+	uint8_t	 op; // vm_io_op_t
+	uint8_t	 pad[3];
+	int32_t	 fd; // Guest file
+	uint64_t addr;
+	uint64_t len;
+	uint64_t offset;
+	uint64_t user_data; // Copied to the completion
+};
+
+// Completion, written by the host
+struct vm_cqe_t {
+	uint64_t user_data;
+	int64_t	 res; // Result, -errno on failure
+};
+
+/**
+ * @brief Header of a ring in guest memory, followed by @ref entries vm_sqe_t, then @ref entries vm_cqe_t
+ *
+ * Indexes wrap freely, the entry of an index is at index & (entries - 1).
+ * The guest queues requests up to sq_tail & calls VM_SERVICE_IO_ENTER,
+ * which takes them from sq_head while the completion queue has room for them all.
+ * Completions are appended at cq_tail, the guest consumes them up to cq_head.
+ */
+struct vm_ring_t {
+	uint32_t sq_head; // Written by the host
+	uint32_t sq_tail; // Written by the guest
+	uint32_t cq_head; // Written by the guest
+	uint32_t cq_tail; // Written by the host
+	uint32_t entries; // Power of two, set by VM_SERVICE_IO_SETUP
+	uint32_t pad;
+};
+
+/**
+ * @brief Runs guest I/O requests through io_uring
+ *
+ * Requests point the kernel straight at guest memory, nothing is copied.
+ * A guest calling VM_SERVICE_IO_ENTER is parked until enough completions arrive,
+ * poll() reaps them & posts the guest back to the executor.
+ * Without io_uring (old kernel, disabled by sysctl, ...) requests are run synchronously at submission instead.
+ * Guests see their own file numbers only, opening files beneath @ref root.
+ * @note Not thread safe: the services & poll() must run on one thread, e.g. that of vm_loop_t::run()
+ */
+class vm_io_t {
+	struct uring_t;
+	struct guest_t;
+	struct op_t;
+	struct park_t;
+
+	vm_executor_t&											m_executor;
+	int														m_root;
+	std::unique_ptr<uring_t>								m_uring; // nullptr if io_uring is unavailable
+	std::unordered_map<const VM*, std::unique_ptr<guest_t>> m_guests;
+	size_t													m_inflight = 0;
+
+public:
+	/**
+	 * @param executor Receives the guests whose completions arrived
+	 * @param root     Directory guests open files beneath, AT_FDCWD for no restriction
+	 */
+	explicit vm_io_t(vm_executor_t& executor, int root = AT_FDCWD);
+
+	// Wait for all requests in flight, then close the files of all guests
+	~vm_io_t();
+
+	vm_io_t(const vm_io_t&)			   = delete;
+	vm_io_t& operator=(const vm_io_t&) = delete;
+
+	// Add VM_SERVICE_IO_SETUP & VM_SERVICE_IO_ENTER to @param services
+	void install(vm_services_t& services);
+
+	/**
+	 * @brief  Give @param vm a duplicate of host file @param fd
+	 * @return Guest file number, -errno on failure
+	 */
+	int grant(VM& vm, int fd);
+
+	/**
+	 * @brief Forget @param vm & close its files, waiting for its requests in flight
+	 * @note  Must be called before destroying a VM which used the services
+	 */
+	void detach(VM& vm);
+
+	/**
+	 * @brief  Reap completions & resume the guests parked for them
+	 * @param  wait Block until at least one completion if any request is in flight
+	 * @return Count of completions
+	 */
+	size_t poll(bool wait = false);
+
+	bool uring() const noexcept {
+		return m_uring != nullptr;
+	}
+
+	size_t inflight() const noexcept {
+		return m_inflight;
+	}
+
+private:
+	vm_task_t<void> setup(VM& vm);
+	vm_task_t<void> enter(VM& vm);
+
+	guest_t& guest(VM& vm);
+	void	 submit(guest_t& guest, const vm_sqe_t& sqe);
+	int64_t	 prepare(guest_t& guest, const vm_sqe_t& sqe, op_t& op);
+	int64_t	 execute(op_t& op);
+	void	 finish(op_t* op, int64_t res);
+};
+
+END_DA_NAMESPACE
+
+#endif // DAVM_IO
+
+#endif // _DAVM_VM_IO_H_
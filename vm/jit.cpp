@@ -0,0 +1,778 @@
+/**
+ * @file      jit.cpp
+ * @brief     Implemention of the x86-64 JIT compiler
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/jit.h>
+#include <vm/run.h>
+#include <vm/vm.h>
+
+#if DAVM_JIT
+
+	#include <sys/mman.h>
+
+BEGIN_DA_NAMESPACE
+
+// Host registers
+enum x64_reg_t : uint8_t {
+	RAX,
+	RCX,
+	RDX,
+	RBX,
+	RSP,
+	RBP,
+	RSI,
+	RDI,
+	R8,
+	R9,
+	R10,
+	R11,
+	R12,
+	R13,
+	R14,
+	R15,
+	NO_REG = 0xFF,
+};
+
+// Condition codes
+enum x64_cond_t : uint8_t {
+	CC_B  = 0x2,
+	CC_AE = 0x3,
+	CC_E  = 0x4,
+	CC_NE = 0x5,
+	CC_L  = 0xC,
+	CC_GE = 0xD,
+};
+
+// Extensions of the group-1 instructions (ADD r/m64, imm32 ...), and the matching r/m64, r64 opcode is ext * 8 + 1
+enum x64_alu_t : uint8_t {
+	ALU_ADD = 0,
+	ALU_OR	= 1,
+	ALU_AND = 4,
+	ALU_SUB = 5,
+	ALU_XOR = 6,
+	ALU_CMP = 7,
+};
+
+// Extensions of the group-2 shifts
+enum x64_shift_t : uint8_t {
+	SHIFT_SHL = 4,
+	SHIFT_SHR = 5,
+	SHIFT_SAR = 7,
+};
+
+// RAX is the scratch register, RDI holds the context & R11 counts the rounds left, guest registers are mapped onto the rest
+static constexpr x64_reg_t host_pool[] = { RBX, RBP, R12, R13, R14, R15, RCX, RDX, RSI, R8, R9, R10 };
+
+inline constexpr bool is_callee_saved(x64_reg_t reg) noexcept {
+	return reg == RBX || reg == RBP || reg >= R12;
+}
+
+class x64_emitter_t {
+	std::vector<byte_t> m_code;
+
+public:
+	const std::vector<byte_t>& code() const noexcept {
+		return m_code;
+	}
+
+	size_t size() const noexcept {
+		return m_code.size();
+	}
+
+	void byte(uint8_t b) {
+		m_code.push_back(b);
+	}
+
+	void dword(uint32_t d) {
+		for(int i = 0; i < 4; ++i) {
+			byte(uint8_t(d >> (i * 8)));
+		}
+	}
+
+	void qword(uint64_t q) {
+		dword(uint32_t(q));
+		dword(uint32_t(q >> 32));
+	}
+
+	// REX prefix, omitted when not needed
+	void rex(bool w, uint8_t reg, uint8_t base) {
+		const uint8_t r = 0x40 | (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+		if(r != 0x40) {
+			byte(r);
+		}
+	}
+
+	void modrm_reg(uint8_t reg, uint8_t rm) {
+		byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	// [base + disp32]
+	void modrm_mem(uint8_t reg, uint8_t base, int32_t disp) {
+		byte(0x80 | ((reg & 7) << 3) | (base & 7));
+		if((base & 7) == RSP) { // RSP & R12 need SIB
+			byte(0x24);
+		}
+		dword(uint32_t(disp));
+	}
+
+	void mov(x64_reg_t dst, x64_reg_t src) {
+		rex(true, src, dst);
+		byte(0x89);
+		modrm_reg(src, dst);
+	}
+
+	void mov_imm(x64_reg_t dst, uint64_t imm) {
+		if(imm <= WORD_MASK) { // MOV r32, imm32 zero extends
+			rex(false, 0, dst);
+			byte(0xB8 | (dst & 7));
+			dword(uint32_t(imm));
+		} else {
+			rex(true, 0, dst);
+			byte(0xB8 | (dst & 7));
+			qword(imm);
+		}
+	}
+
+	void load(x64_reg_t dst, x64_reg_t base, int32_t disp) {
+		rex(true, dst, base);
+		byte(0x8B);
+		modrm_mem(dst, base, disp);
+	}
+
+	void store(x64_reg_t base, int32_t disp, x64_reg_t src) {
+		rex(true, src, base);
+		byte(0x89);
+		modrm_mem(src, base, disp);
+	}
+
+	// Load @param size bytes into RAX, with sign or zero extension
+	void load_rax(x64_reg_t base, int32_t disp, size_t size, bool sign) {
+		switch(size) {
+		case 1:
+			rex(sign, 0, base);
+			byte(0x0F);
+			byte(sign ? 0xBE : 0xB6);
+			break;
+		case 2:
+			rex(sign, 0, base);
+			byte(0x0F);
+			byte(sign ? 0xBF : 0xB7);
+			break;
+		case 4:
+			rex(sign, 0, base);
+			byte(sign ? 0x63 : 0x8B);
+			break;
+		default:
+			rex(true, 0, base);
+			byte(0x8B);
+			break;
+		}
+		modrm_mem(RAX, base, disp);
+	}
+
+	// Store the low @param size bytes of RAX
+	void store_rax(x64_reg_t base, size_t size) {
+		if(size == 2) {
+			byte(0x66);
+		}
+		rex(size == 8, 0, base);
+		byte(size == 1 ? 0x88 : 0x89);
+		modrm_mem(RAX, base, 0);
+	}
+
+	void lea_rax(x64_reg_t base, int32_t disp) {
+		rex(true, 0, base);
+		byte(0x8D);
+		modrm_mem(RAX, base, disp);
+	}
+
+	void alu(x64_alu_t op, x64_reg_t dst, x64_reg_t src) {
+		rex(true, src, dst);
+		byte(op * 8 + 1);
+		modrm_reg(src, dst);
+	}
+
+	void alu_imm(x64_alu_t op, x64_reg_t dst, int32_t imm) {
+		rex(true, 0, dst);
+		byte(0x81);
+		modrm_reg(op, dst);
+		dword(uint32_t(imm));
+	}
+
+	void imul(x64_reg_t dst, x64_reg_t src) {
+		rex(true, dst, src);
+		byte(0x0F);
+		byte(0xAF);
+		modrm_reg(dst, src);
+	}
+
+	void imul_imm(x64_reg_t dst, x64_reg_t src, int32_t imm) {
+		rex(true, dst, src);
+		byte(0x69);
+		modrm_reg(dst, src);
+		dword(uint32_t(imm));
+	}
+
+	void shift_imm(x64_shift_t op, x64_reg_t dst, uint8_t imm) {
+		rex(true, 0, dst);
+		byte(0xC1);
+		modrm_reg(op, dst);
+		byte(imm);
+	}
+
+	// RAX = cond ? 1 : 0
+	void setcc_rax(x64_cond_t cc) {
+		byte(0x0F);
+		byte(0x90 | cc);
+		byte(0xC0); // SETcc AL
+		byte(0x0F);
+		byte(0xB6);
+		byte(0xC0); // MOVZX EAX, AL
+	}
+
+	// Returns the offset of rel32 to patch
+	size_t jcc(x64_cond_t cc) {
+		byte(0x0F);
+		byte(0x80 | cc);
+		dword(0);
+		return size() - 4;
+	}
+
+	// Jcc back to @param to
+	void jcc_back(x64_cond_t cc, size_t to) {
+		byte(0x0F);
+		byte(0x80 | cc);
+		dword(uint32_t(to - (size() + 4)));
+	}
+
+	void dec(x64_reg_t reg) {
+		rex(true, 0, reg);
+		byte(0xFF);
+		modrm_reg(1, reg);
+	}
+
+	void test(x64_reg_t reg) {
+		rex(true, reg, reg);
+		byte(0x85);
+		modrm_reg(reg, reg);
+	}
+
+	void patch(size_t at) {
+		const uint32_t rel = uint32_t(size() - (at + 4));
+		std::memcpy(&m_code[at], &rel, sizeof(rel));
+	}
+
+	void push(x64_reg_t reg) {
+		rex(false, 0, reg);
+		byte(0x50 | (reg & 7));
+	}
+
+	void pop(x64_reg_t reg) {
+		rex(false, 0, reg);
+		byte(0x58 | (reg & 7));
+	}
+
+	void ret() {
+		byte(0xC3);
+	}
+};
+
+// Guest register -> host register mapping of a block
+class jit_regs_t {
+	x64_reg_t m_host[32];
+	size_t	  m_used = 0;
+	uint32_t  m_dirty = 0;
+
+public:
+	jit_regs_t() {
+		std::memset(m_host, NO_REG, sizeof(m_host));
+	}
+
+	// Map @param guest if needed, false if out of host registers
+	bool map(regid_t guest) noexcept {
+		if(m_host[guest] != NO_REG) {
+			return true;
+		}
+		if(m_used == std::size(host_pool)) {
+			return false;
+		}
+		m_host[guest] = host_pool[m_used++];
+		return true;
+	}
+
+	x64_reg_t operator[](regid_t guest) const noexcept {
+		return m_host[guest];
+	}
+
+	void write(regid_t guest) noexcept {
+		m_dirty |= 1u << guest;
+	}
+
+	void enter(x64_emitter_t& e) const {
+		e.mov(R11, RSI);
+		for(size_t i = 0; i < m_used; ++i) {
+			if(is_callee_saved(host_pool[i])) {
+				e.push(host_pool[i]);
+			}
+		}
+		for(regid_t g = 0; g < 32; ++g) {
+			if(m_host[g] != NO_REG) {
+				e.load(m_host[g], RDI, int32_t(g * sizeof(register_t)));
+			}
+		}
+	}
+
+	void leave(x64_emitter_t& e, const asm_inst_t* next) const {
+		for(regid_t g = 0; g < 32; ++g) {
+			if(m_dirty & (1u << g)) {
+				e.store(RDI, int32_t(g * sizeof(register_t)), m_host[g]);
+			}
+		}
+		for(size_t i = m_used; i-- > 0;) {
+			if(is_callee_saved(host_pool[i])) {
+				e.pop(host_pool[i]);
+			}
+		}
+		e.mov_imm(RAX, DAVM_CAST(uint64_t, next));
+		e.mov(RDX, R11);
+		e.ret();
+	}
+};
+
+// Map registers of a supported command, false if it cannot be compiled
+static bool jit_prepare(jit_regs_t& regs, run_state_t& state, const asm_inst_t* inst) noexcept {
+	switch(inst->op) {
+	case OP_ADD:
+	case OP_SUB:
+	case OP_SLT:
+	case OP_SLTU:
+	case OP_MUL:
+	case OP_AND:
+	case OP_OR:
+	case OP_XOR:
+		return regs.map(inst->rd) && regs.map(inst->ra) && regs.map(inst->rb);
+	case OP_BEQ:
+	case OP_BNE:
+	case OP_BLT:
+	case OP_BGE:
+	case OP_BLTU:
+	case OP_BGEU:
+		DA_IF_UNLIKELY(!state.target(inst)) {
+			return false;
+		}
+		[[fallthrough]];
+	case OP_MOV:
+	case OP_ADDI:
+	case OP_MULI:
+	case OP_SLTI:
+	case OP_SLTUI:
+	case OP_ANDI:
+	case OP_ORI:
+	case OP_XORI:
+	case OP_SLLI:
+	case OP_SRLI:
+	case OP_SRAI:
+	case OP_LB:
+	case OP_LH:
+	case OP_LW:
+	case OP_LD:
+	case OP_LBU:
+	case OP_LHU:
+	case OP_LWU:
+	case OP_SB:
+	case OP_SH:
+	case OP_SW:
+	case OP_SD:
+		return regs.map(inst->rd) && regs.map(inst->ra);
+	case OP_PUSH:
+	case OP_POP:
+		return regs.map(inst->rd) && regs.map(3);
+	case OP_JAL:
+		DA_IF_UNLIKELY(!state.target(inst)) {
+			return false;
+		}
+		[[fallthrough]];
+	case OP_LUI:
+		return regs.map(inst->rd);
+	default:
+		return false;
+	}
+}
+
+// Emit one command, the block ends after a branch or JAL
+// @param start & @param head are the first record of the block & the offset of its loop head
+static void jit_emit(x64_emitter_t& e, jit_regs_t& regs, run_state_t& state, const asm_inst_t* inst, const asm_inst_t* start, size_t head) {
+	const x64_reg_t rd	= regs[inst->rd];
+	const x64_reg_t ra	= regs[inst->ra];
+	const int32_t	imm = int32_t(inst->imm);
+
+	auto arith = [&](x64_alu_t op) {
+		e.mov(RAX, ra);
+		e.alu(op, RAX, regs[inst->rb]);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto arith_imm = [&](x64_alu_t op) {
+		e.mov(RAX, ra);
+		e.alu_imm(op, RAX, imm);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto compare = [&](x64_reg_t a, x64_reg_t b, x64_cond_t cc) {
+		e.alu(ALU_CMP, a, b);
+		e.setcc_rax(cc);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto compare_imm = [&](x64_cond_t cc) {
+		e.alu_imm(ALU_CMP, ra, imm);
+		e.setcc_rax(cc);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto shift = [&](x64_shift_t op) {
+		e.mov(RAX, ra);
+		e.shift_imm(op, RAX, uint8_t(imm));
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto load = [&](size_t size, bool sign) {
+		e.load_rax(ra, imm, size, sign);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+	};
+	auto save = [&](size_t size) {
+		e.lea_rax(ra, imm);
+		e.store_rax(rd, size);
+	};
+	auto branch = [&](x64_cond_t cc) {
+		e.alu(ALU_CMP, rd, ra);
+		const size_t taken = e.jcc(cc);
+		regs.leave(e, inst + 1);
+		e.patch(taken);
+		if(state.target(inst) == start) {
+			e.test(R11);
+			e.jcc_back(CC_NE, head);
+		}
+		regs.leave(e, state.target(inst));
+	};
+
+	switch(inst->op) {
+	case OP_ADD:
+		return arith(ALU_ADD);
+	case OP_SUB:
+		return arith(ALU_SUB);
+	case OP_AND:
+		return arith(ALU_AND);
+	case OP_OR:
+		return arith(ALU_OR);
+	case OP_XOR:
+		return arith(ALU_XOR);
+	case OP_SLT:
+		return compare(ra, regs[inst->rb], CC_L);
+	case OP_SLTU:
+		return compare(ra, regs[inst->rb], CC_B);
+	case OP_MUL:
+		e.mov(RAX, ra);
+		e.imul(RAX, regs[inst->rb]);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+		return;
+	case OP_MOV:
+		e.mov(rd, ra);
+		regs.write(inst->rd);
+		return;
+	case OP_ADDI:
+		return arith_imm(ALU_ADD);
+	case OP_ANDI:
+		return arith_imm(ALU_AND);
+	case OP_ORI:
+		return arith_imm(ALU_OR);
+	case OP_XORI:
+		return arith_imm(ALU_XOR);
+	case OP_MULI:
+		e.imul_imm(RAX, ra, imm);
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+		return;
+	case OP_SLTI:
+		return compare_imm(CC_L);
+	case OP_SLTUI:
+		return compare_imm(CC_B);
+	case OP_SLLI:
+		return shift(SHIFT_SHL);
+	case OP_SRLI:
+		return shift(SHIFT_SHR);
+	case OP_SRAI:
+		return shift(SHIFT_SAR);
+	case OP_LB:
+		return load(1, true);
+	case OP_LH:
+		return load(2, true);
+	case OP_LW:
+		return load(4, true);
+	case OP_LD:
+		return load(8, true);
+	case OP_LBU:
+		return load(1, false);
+	case OP_LHU:
+		return load(2, false);
+	case OP_LWU:
+		return load(4, false);
+	case OP_SB:
+		return save(1);
+	case OP_SH:
+		return save(2);
+	case OP_SW:
+		return save(4);
+	case OP_SD:
+		return save(8);
+	case OP_PUSH:
+		if(inst->rd == 3) { // Pushes the decremented sp, see asm_push()
+			e.mov(RAX, rd);
+			e.alu_imm(ALU_SUB, RAX, sizeof(register_t));
+			e.store(regs[3], -int32_t(sizeof(register_t)), RAX);
+		} else {
+			e.store(regs[3], -int32_t(sizeof(register_t)), rd);
+		}
+		e.alu_imm(ALU_SUB, regs[3], sizeof(register_t));
+		regs.write(3);
+		return;
+	case OP_POP:
+		e.load(RAX, regs[3], 0);
+		e.mov(rd, RAX);
+		e.alu_imm(ALU_ADD, regs[3], sizeof(register_t));
+		regs.write(inst->rd);
+		regs.write(3);
+		return;
+	case OP_LUI:
+		e.mov_imm(RAX, uint64_t(inst->imm));
+		e.alu(ALU_ADD, rd, RAX);
+		regs.write(inst->rd);
+		return;
+	case OP_JAL:
+		e.mov_imm(RAX, state.pc_of(inst + 1));
+		e.mov(rd, RAX);
+		regs.write(inst->rd);
+		regs.leave(e, state.target(inst));
+		return;
+	case OP_BEQ:
+		return branch(CC_E);
+	case OP_BNE:
+		return branch(CC_NE);
+	case OP_BLT:
+		return branch(CC_L);
+	case OP_BGE:
+		return branch(CC_GE);
+	case OP_BLTU:
+		return branch(CC_B);
+	case OP_BGEU:
+		return branch(CC_AE);
+	}
+}
+
+inline bool ends_block(const asm_inst_t* inst) noexcept {
+	return inst->op == OP_JAL || (inst->op >= OP_BEQ && inst->op <= OP_BGEU);
+}
+
+jit_t::jit_t() {
+	void* code = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	m_code	   = code == MAP_FAILED ? nullptr : static_cast<byte_t*>(code);
+}
+
+jit_t::~jit_t() {
+	if(m_code) {
+		munmap(m_code, JIT_CODE_SIZE);
+	}
+}
+
+void jit_t::clear() noexcept {
+	m_used = 0;
+	m_blocks.clear();
+	m_index.clear();
+	m_heat.clear();
+	m_watch.clear();
+}
+
+const jit_t::block_t* jit_t::lookup(run_state_t& state, const asm_inst_t* inst) {
+	const size_t index = size_t(inst - state.base);
+	DA_IF_UNLIKELY(m_index.size() != state.count) {
+		clear();
+		m_index.resize(state.count);
+		m_heat.resize(state.count);
+		m_watch.resize(state.count, 1);
+	}
+	DA_IF_LIKELY(m_index[index]) {
+		return &m_blocks[m_index[index] - 1];
+	}
+	DA_IF_UNLIKELY(m_heat[index] != UINT16_MAX && ++m_heat[index] == JIT_HOT_THRESHOLD) {
+		const block_t* block = compile(state, index);
+		if(!block) {
+			m_heat[index]  = UINT16_MAX; // Never retry
+			m_watch[index] = 0;
+		}
+		return block;
+	}
+	return nullptr;
+}
+
+const jit_t::block_t* jit_t::compile(run_state_t& state, size_t index) {
+	DA_IF_UNLIKELY(!m_code) {
+		return nullptr;
+	}
+
+	// First pass: find the length of the block & map registers
+	jit_regs_t regs;
+	size_t	   length = 0;
+	bool	   closed = false; // Ends with a branch or JAL
+	for(const asm_inst_t* inst = state.base + index; length < JIT_MAX_BLOCK; ++inst) {
+		if(inst->id == OP_UNDECODED) {
+			inst = state.decode(inst);
+		}
+		if(!jit_prepare(regs, state, inst)) {
+			break;
+		}
+		++length;
+		if(ends_block(inst)) {
+			closed = true;
+			break;
+		}
+	}
+	// Entering & leaving costs more than a few commands save, unless the block loops natively
+	const bool loops = closed && state.target(state.base + index + length - 1) == state.base + index;
+	DA_IF_UNLIKELY(length < JIT_MIN_BLOCK && !loops) {
+		return nullptr;
+	}
+
+	// Second pass: emit
+	x64_emitter_t e;
+	regs.enter(e);
+	const size_t head = e.size();
+	e.dec(R11);
+	const asm_inst_t* start = state.base + index;
+	const asm_inst_t* inst	= start;
+	block_t			  block { nullptr, length, {}, {} };
+	for(size_t i = 0; i < length; ++i, ++inst) {
+		block.offsets.push_back(uint32_t(e.size()));
+		jit_emit(e, regs, state, inst, start, head);
+	}
+	if(!closed) {
+		regs.leave(e, inst);
+	}
+	block.offsets.push_back(uint32_t(e.size()));
+	for(regid_t g = 0; g < 32; ++g) {
+		block.host[g] = regs[g];
+	}
+
+	DA_IF_UNLIKELY(m_used + e.size() > JIT_CODE_SIZE) {
+		const size_t count = m_index.size();
+		clear();
+		m_index.resize(count);
+		m_heat.resize(count);
+		m_watch.resize(count, 1);
+	}
+	byte_t* entry = m_code + m_used;
+	mprotect(m_code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+	std::memcpy(entry, e.code().data(), e.size());
+	mprotect(m_code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+	m_used += (e.size() + 15) & ~size_t(15);
+
+	block.entry = DAVM_CAST(entry_t, entry);
+	m_blocks.push_back(std::move(block));
+	m_index[index] = uint32_t(m_blocks.size());
+	return &m_blocks.back();
+}
+
+const asm_inst_t* jit_t::fault(run_state_t& state, const trap_frame_t& frame, size_t& done) const noexcept {
+	static constexpr int greg_of[] = {
+		REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+		REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+	};
+
+	const size_t index = frame.inst ? size_t(frame.inst - state.base) : m_index.size();
+	DA_IF_UNLIKELY(index >= m_index.size() || !m_index[index]) {
+		return nullptr;
+	}
+	const block_t& block = m_blocks[m_index[index] - 1];
+	const size_t   rip	 = size_t(frame.gregs[REG_RIP] - DAVM_CAST(greg_t, block.entry));
+	DA_IF_UNLIKELY(rip < block.offsets.front() || rip >= block.offsets.back()) {
+		return nullptr;
+	}
+	const size_t i = size_t(std::upper_bound(block.offsets.begin(), block.offsets.end(), uint32_t(rip)) - block.offsets.begin()) - 1;
+
+	// R11 counts the rounds left after the current one
+	const size_t rounds = frame.remaining / block.length;
+	done				= (rounds - 1 - size_t(frame.gregs[REG_R11])) * block.length + i;
+	for(regid_t g = 0; g < 32; ++g) {
+		if(block.host[g] != NO_REG) {
+			state.vm.context().x[g] = register_t(frame.gregs[greg_of[block.host[g]]]);
+		}
+	}
+	return frame.inst + i;
+}
+
+// Commands no block starts at run in the threaded loop until it jumps to a block or to a command still counted,
+// so that uncompiled code runs nearly as fast as without the JIT
+int VM::run_jit(size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return 2;
+	}
+	trap_frame_t	frame(m_memory, m_context.bounds);
+	run_state_t		state(*this, target, frame);
+	run_state_t		segment = state; // Given to the threaded loop
+	volatile size_t limit	= 0; // Of segment, read back after a fault
+	if(sigsetjmp(frame.jump, 0)) {
+		size_t			  done = 0;
+		const asm_inst_t* inst = m_jit->fault(state, frame, done);
+		DA_IF_UNLIKELY(!inst) { // Outside the block, the fault comes from the threaded loop
+			segment.limit = limit;
+			return segment.fault();
+		}
+		m_retired += done;
+		DAVM_PC(m_context) = state.pc_of(inst);
+		m_trap			   = { DAVM_PC(m_context), frame.address };
+		return 3;
+	}
+	size_t budget = state.limit;
+	if(!m_jit) {
+		m_jit = std::make_unique<jit_t>();
+	}
+	while(budget) {
+		const asm_inst_t* inst = state.fetch(DAVM_PC(m_context));
+		DA_IF_UNLIKELY(!inst) {
+			return 1;
+		}
+		const jit_t::block_t* block = m_jit->lookup(state, inst);
+		const size_t rounds = block ? budget / block->length : 0;
+		if(rounds) {
+			state.publish(inst, budget);
+			const jit_exit_t result = block->entry(&m_context, rounds);
+			const size_t	 done = (rounds - result.rounds) * block->length;
+			DAVM_PC(m_context)	  = state.pc_of(result.next);
+			budget -= done;
+			m_retired += done;
+			continue;
+		}
+		// Not compiled, leave it to the threaded loop
+		const size_t retired = m_retired;
+		limit				 = budget;
+		segment.limit		 = budget;
+		segment.watch		 = m_jit->watch();
+		const int status	 = m_verified ? loop_goto<true, true>(segment) : loop_goto<false, true>(segment);
+		DA_IF_UNLIKELY(status) {
+			return status;
+		}
+		budget -= m_retired - retired;
+	}
+	return 0;
+}
+
+END_DA_NAMESPACE
+
+#endif // DAVM_JIT
@@ -0,0 +1,107 @@
+/**
+ * @file      jit.h
+ * @brief     Baseline x86-64 JIT compiler for basic blocks
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_JIT_H_
+#define _DAVM_VM_JIT_H_
+
+#include <vm/pch.h>
+#include <vm/memory.h>
+
+// Enabled by CMake on x86-64 Linux, disable it with -DDAVM_JIT=OFF
+#ifndef DAVM_JIT
+	#define DAVM_JIT 0
+#endif
+
+#if DAVM_JIT && !(defined(__x86_64__) && defined(__linux__) && DA_COMP_GNU)
+	#error "DAVM JIT only supports x86-64 Linux with GCC or Clang"
+#endif
+
+#if DAVM_JIT
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr size_t JIT_CODE_SIZE	 = 16 * 1024 * 1024; // 16M, all blocks are dropped when full
+inline constexpr size_t JIT_MAX_BLOCK	 = 256; // Maximum commands in one block
+inline constexpr size_t JIT_HOT_THRESHOLD = 16; // Executions before a block gets compiled
+inline constexpr size_t JIT_MIN_BLOCK	 = 4; // Commands in a block which does not loop, shorter runs stay in the interpreter
+
+struct run_state_t;
+
+struct jit_exit_t {
+	const asm_inst_t* next; // Record to continue with
+	size_t			  rounds; // Rounds left
+};
+
+/**
+ * @brief Compiles straight-line runs of predecoded commands into native code
+ *
+ * A block starts at any command and ends at the first branch or JAL (included),
+ * or before the first command it does not support, which is left to the interpreter.
+ * Commands outside blocks run in the threaded loop of the interpreter, which gives back the blocks it jumps to.
+ * Registers used by the block are loaded into host registers on entry and written back on exit.
+ * A block branching back to its own start loops natively for at most the given rounds.
+ */
+class jit_t {
+public:
+	using entry_t = jit_exit_t (*)(vm_context_t*, size_t rounds) noexcept;
+
+	struct block_t {
+		entry_t				  entry;
+		size_t				  length; // Count of commands executed by every round
+		std::vector<uint32_t> offsets; // Command -> offset of its native code, with the end of the block appended
+		uint8_t				  host[32]; // Guest register -> host register holding it, 0xFF if none
+	};
+
+private:
+	byte_t*				  m_code; // Executable region
+	size_t				  m_used = 0;
+	std::vector<block_t>  m_blocks;
+	std::vector<uint32_t> m_index; // Record index -> block id + 1, 0 if not compiled
+	std::vector<uint16_t> m_heat; // Record index -> executions, UINT16_MAX if not compilable
+	std::vector<uint8_t>  m_watch; // Record index -> 1 if compiled or still counted, the interpreter gives those back
+
+public:
+	jit_t();
+	~jit_t();
+
+	jit_t(const jit_t&)			   = delete;
+	jit_t& operator=(const jit_t&) = delete;
+
+	/**
+	 * @brief  Find the block starting at @param inst, compiling it once hot enough
+	 * @return The block, nullptr if it is not compiled (yet)
+	 */
+	const block_t* lookup(run_state_t& state, const asm_inst_t* inst);
+
+	// Drop all blocks, must be called when the records they refer to change
+	void clear() noexcept;
+
+	// Records to give back to lookup() when jumped to, valid until the next lookup()
+	const uint8_t* watch() const noexcept {
+		return m_watch.data();
+	}
+
+	/**
+	 * @brief  Map a fault caught by @param frame back to the guest, restoring the registers held by the host
+	 * @param  frame Published the first record & budget before entering the block
+	 * @param  done  Filled with the commands completed in the block
+	 * @return The faulting record, nullptr if the fault is not inside the block
+	 * @note   Blocks access memory before changing any register, so the guest state is precise
+	 */
+	const asm_inst_t* fault(run_state_t& state, const trap_frame_t& frame, size_t& done) const noexcept;
+
+private:
+	const block_t* compile(run_state_t& state, size_t index);
+};
+
+END_DA_NAMESPACE
+
+#endif // DAVM_JIT
+
+#endif // _DAVM_VM_JIT_H_
@@ -0,0 +1,255 @@
+/**
+ * @file      memory.cpp
+ * @brief     Implemention of guarded guest memory & memory fault traps
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/memory.h>
+
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+BEGIN_DA_NAMESPACE
+
+inline size_t round_page(size_t size) noexcept {
+	return (size + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1);
+}
+
+// Owner of a memfd, shared by all memories mapping it
+struct memory_file_t {
+	int fd;
+
+	explicit memory_file_t(int fd) noexcept
+		: fd(fd) {
+	}
+
+	~memory_file_t() {
+		close(fd);
+	}
+};
+
+memory_t::memory_t(size_t size, size_t stack) {
+	DA_IF_UNLIKELY(size > SIZE_MAX / 2 || stack > size) {
+		throw std::bad_alloc();
+	}
+	reserve(round_page(size), round_page(stack));
+	DA_IF_UNLIKELY(mprotect(m_data, heap_size(), PROT_READ | PROT_WRITE) || mprotect(end() - m_stack, m_stack, PROT_READ | PROT_WRITE)) {
+		munmap(m_base, VM_GUARD_SIZE * 2 + m_size);
+		throw std::bad_alloc();
+	}
+}
+
+memory_t::memory_t(std::shared_ptr<memory_file_t> file, size_t size, size_t stack)
+	: m_file(std::move(file)) {
+	reserve(size, stack);
+	try {
+		map_file(m_file->fd);
+	} catch(...) {
+		munmap(m_base, VM_GUARD_SIZE * 2 + m_size);
+		throw;
+	}
+}
+
+memory_t::memory_t(memory_t&& other) noexcept
+	: m_base(std::exchange(other.m_base, nullptr))
+	, m_data(other.m_data)
+	, m_size(other.m_size)
+	, m_stack(other.m_stack)
+	, m_file(std::move(other.m_file))
+	, m_dirty(other.m_dirty) {
+}
+
+memory_t::~memory_t() {
+	if(m_base) {
+		munmap(m_base, VM_GUARD_SIZE * 2 + m_size);
+	}
+}
+
+// Reserve everything inaccessible, the memory is opened up by the caller except the stack guard
+void memory_t::reserve(size_t size, size_t stack) {
+	DA_IF_UNLIKELY(size < stack + VM_PAGE_SIZE * 2) {
+		throw std::bad_alloc();
+	}
+	void* base = mmap(nullptr, VM_GUARD_SIZE * 2 + size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	DA_IF_UNLIKELY(base == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	m_base	= static_cast<byte_t*>(base);
+	m_data	= m_base + VM_GUARD_SIZE;
+	m_size	= size;
+	m_stack = stack;
+}
+
+// Map @param fd privately over the heap & the stack, at the same offsets
+void memory_t::map_file(int fd) {
+	constexpr int flags = MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE;
+	DA_IF_UNLIKELY(mmap(m_data, heap_size(), PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED
+				   || mmap(end() - m_stack, m_stack, PROT_READ | PROT_WRITE, flags, fd, off_t(m_size - m_stack)) == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+}
+
+// Copy the content into a new memfd & map it instead, only pages which may hold data are copied:
+// those in the page table or swapped according to /proc/self/pagemap, & those in the previous snapshot
+void memory_t::snapshot() {
+	const int fd = memfd_create("davm", MFD_CLOEXEC);
+	DA_IF_UNLIKELY(fd < 0) {
+		throw std::bad_alloc();
+	}
+	auto file = std::make_shared<memory_file_t>(fd);
+	DA_IF_UNLIKELY(ftruncate(fd, off_t(m_size))) {
+		throw std::bad_alloc();
+	}
+	auto copy = [&](size_t offset, size_t length) {
+		for(size_t done = 0; done < length;) {
+			const ssize_t n = pwrite(fd, m_data + offset + done, length - done, off_t(offset + done));
+			DA_IF_UNLIKELY(n <= 0) {
+				throw std::bad_alloc();
+			}
+			done += size_t(n);
+		}
+	};
+
+	if(m_file) {
+		for(off_t begin = 0; (begin = lseek(m_file->fd, begin, SEEK_DATA)) >= 0;) {
+			const off_t last = lseek(m_file->fd, begin, SEEK_HOLE);
+			copy(size_t(begin), size_t(last - begin));
+			begin = last;
+		}
+	}
+	const int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if(pagemap < 0) { // Copy everything instead
+		copy(0, heap_size());
+		copy(m_size - m_stack, m_stack);
+	} else {
+		constexpr uint64_t in_use = (uint64_t(1) << 63) | (uint64_t(1) << 62); // Present or swapped
+		const size_t	   pages  = m_size / VM_PAGE_SIZE;
+		uint64_t		   entries[512];
+		size_t			   run = 0; // Pages in use before page
+		for(size_t page = 0; page < pages;) {
+			const size_t count = std::min(pages - page, std::size(entries));
+			const off_t	 at	   = off_t((DAVM_CAST(size_t, m_data) / VM_PAGE_SIZE + page) * sizeof(uint64_t));
+			DA_IF_UNLIKELY(pread(pagemap, entries, count * sizeof(uint64_t), at) != ssize_t(count * sizeof(uint64_t))) {
+				close(pagemap);
+				throw std::bad_alloc();
+			}
+			for(size_t i = 0; i < count; ++i, ++page) {
+				if(entries[i] & in_use) {
+					++run;
+				} else if(run) {
+					copy((page - run) * VM_PAGE_SIZE, run * VM_PAGE_SIZE);
+					run = 0;
+				}
+			}
+		}
+		close(pagemap);
+		if(run) {
+			copy((pages - run) * VM_PAGE_SIZE, run * VM_PAGE_SIZE);
+		}
+	}
+
+	map_file(fd);
+	m_file	= std::move(file);
+	m_dirty = false;
+}
+
+memory_t memory_t::fork() {
+	DA_IF_UNLIKELY(!m_base) { // Remapping a view would remap its owner
+		throw std::bad_alloc();
+	}
+	if(!m_file || m_dirty) {
+		snapshot();
+	}
+	return memory_t(m_file, m_size, m_stack);
+}
+
+memory_t memory_t::share() noexcept {
+	m_dirty = true;
+	return memory_t(m_data, m_size, m_stack);
+}
+
+// Traps
+
+static thread_local trap_frame_t* active_frame = nullptr;
+static struct sigaction			  prev_segv, prev_bus;
+
+// Hand a fault which is not the guest's to the handler installed before ours
+static void chain_trap(int sig, siginfo_t* info, void* ucontext) {
+	const struct sigaction& prev = sig == SIGBUS ? prev_bus : prev_segv;
+	if(prev.sa_flags & SA_SIGINFO) {
+		prev.sa_sigaction(sig, info, ucontext);
+	} else if(prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+		prev.sa_handler(sig);
+	} else { // The command faults again & kills the process as if we were never installed
+		signal(sig, SIG_DFL);
+	}
+}
+
+// Guest memory with its guards, or the read only mapping of the image, faults elsewhere are host bugs
+static bool is_guest_fault(const trap_frame_t& frame, addr_t address) noexcept {
+	const guest_bounds_t& bounds = *frame.bounds;
+	return address - frame.low < frame.high - frame.low || address - bounds.ro_begin < bounds.ro_end - bounds.ro_begin;
+}
+
+static void trap_handler(int sig, siginfo_t* info, void* ucontext) {
+	trap_frame_t* frame	  = active_frame;
+	const addr_t  address = DAVM_CAST(addr_t, info->si_addr);
+	DA_IF_UNLIKELY(!frame || info->si_code <= 0 || !is_guest_fault(*frame, address)) {
+		chain_trap(sig, info, ucontext);
+		return;
+	}
+	frame->address = address;
+#if DAVM_JIT
+	std::memcpy(frame->gregs, static_cast<ucontext_t*>(ucontext)->uc_mcontext.gregs, sizeof(frame->gregs));
+#else
+	(void)ucontext;
+#endif
+	siglongjmp(frame->jump, 1);
+}
+
+// SA_NODEFER keeps the signals unblocked after jumping out of the handler, so sigsetjmp() needs not save the mask
+static void install_trap_handler() {
+	struct sigaction action = {};
+	action.sa_sigaction		= trap_handler;
+	action.sa_flags			= SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGSEGV, &action, &prev_segv);
+	sigaction(SIGBUS, &action, &prev_bus);
+}
+
+trap_frame_t::trap_frame_t(const memory_t& memory, const guest_bounds_t& bounds) noexcept
+	: low(DAVM_CAST(addr_t, memory.data()) - VM_GUARD_SIZE)
+	, high(DAVM_CAST(addr_t, memory.end()) + VM_GUARD_SIZE)
+	, bounds(&bounds)
+	, prev(active_frame) {
+	static const bool installed = (install_trap_handler(), true);
+	(void)installed;
+	active_frame = this;
+}
+
+trap_frame_t::~trap_frame_t() {
+	active_frame = prev;
+}
+
+void raise_guest_fault(addr_t address) noexcept {
+	trap_frame_t* frame = active_frame;
+	DA_IF_UNLIKELY(!frame) {
+		DAVM_LOG_ERROR("Guest memory fault at {:#X} outside any trap frame", address);
+		logger_t::instance().flush(); // The writer thread dies with the process
+		std::abort();
+	}
+	frame->address = address;
+#if DAVM_JIT
+	std::memset(frame->gregs, 0, sizeof(frame->gregs)); // Not in a compiled block
+#endif
+	siglongjmp(frame->jump, 1);
+}
+
+END_DA_NAMESPACE
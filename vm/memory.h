@@ -0,0 +1,216 @@
+/**
+ * @file      memory.h
+ * @brief     Guarded guest memory & memory fault traps
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_MEMORY_H_
+#define _DAVM_VM_MEMORY_H_
+
+#include <vm/pch.h>
+
+#include <atomic>
+#include <csetjmp>
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+#include <utility>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr size_t VM_DEFAULT_MEMORY = 64 * 1024 * 1024; // 64M
+inline constexpr size_t VM_DEFAULT_STACK  = 1024 * 1024; // 1M, at the top of memory
+inline constexpr size_t VM_GUARD_SIZE	  = 1024 * 1024; // 1M, inaccessible below & above memory
+inline constexpr size_t VM_PAGE_SIZE	  = 4096;
+
+struct memory_file_t;
+
+/**
+ * @brief Guest memory reserved as one mapping, laid out as
+ *
+ * |guard|heap ...|stack guard|... stack|guard|
+ *       ^ data()                       ^ end()
+ *
+ * Guards are mapped PROT_NONE, so any access to them faults instead of touching host memory.
+ * The stack guard is one page, catching stack overflows before they reach the heap.
+ * Nothing is committed up front: the kernel commits zeroed pages on first touch,
+ * so a reservation far larger than the memory actually used costs only address space.
+ *
+ * Memory starts anonymous. fork() first snapshots it into a memfd, which the memory & all its forks then map
+ * privately, so that pages are shared until written. Further forks reuse the snapshot until mark_dirty().
+ */
+class memory_t {
+	byte_t*						   m_base = nullptr; // Start of the mapping, nullptr for a view
+	byte_t*						   m_data = nullptr; // Start of the accessible memory
+	size_t						   m_size  = 0;
+	size_t						   m_stack = 0; // Bytes above the stack guard
+	std::shared_ptr<memory_file_t> m_file; // Snapshot mapped privately, nullptr if anonymous
+	bool						   m_dirty = false; // May differ from the snapshot
+
+public:
+	/**
+	 * @param size  Accessible bytes, rounded up to pages
+	 * @param stack Bytes above the stack guard, rounded up to pages
+	 * @throw std::bad_alloc if the sizes do not fit or the mapping fails
+	 */
+	explicit memory_t(size_t size = VM_DEFAULT_MEMORY, size_t stack = VM_DEFAULT_STACK);
+	~memory_t();
+
+	memory_t(memory_t&& other) noexcept;
+	memory_t(const memory_t&)			 = delete;
+	memory_t& operator=(const memory_t&) = delete;
+	memory_t& operator=(memory_t&&)		 = delete;
+
+	/**
+	 * @brief  Clone the memory copy-on-write, at another address
+	 * @return Memory sharing every page with this one until either side writes it
+	 * @throw  std::bad_alloc if the snapshot or the mapping fails, or if this is a view from share()
+	 * @note   Snapshotting copies the pages in use, it is skipped if not marked dirty since the last one
+	 */
+	memory_t fork();
+
+	/**
+	 * @brief  View of this memory at the same address, for a guest thread, see vm/thread.h
+	 * @return Memory which neither unmaps nor forks, marking this one dirty as the view may write it anytime
+	 * @note   This memory must outlive its views & must not be forked while they run
+	 */
+	memory_t share() noexcept;
+
+	// Must be called before the memory may be written, so that the next fork() snapshots it again
+	void mark_dirty() noexcept {
+		m_dirty = true;
+	}
+
+	byte_t* data() const noexcept {
+		return m_data;
+	}
+
+	size_t size() const noexcept {
+		return m_size;
+	}
+
+	byte_t* begin() const noexcept {
+		return m_data;
+	}
+
+	byte_t* end() const noexcept {
+		return m_data + m_size;
+	}
+
+	// Bytes above the stack guard
+	size_t stack_size() const noexcept {
+		return m_stack;
+	}
+
+	// Bytes below the stack guard
+	size_t heap_size() const noexcept {
+		return m_size - m_stack - VM_PAGE_SIZE;
+	}
+
+private:
+	memory_t(std::shared_ptr<memory_file_t> file, size_t size, size_t stack);
+
+	// View, see share()
+	memory_t(byte_t* data, size_t size, size_t stack) noexcept
+		: m_data(data)
+		, m_size(size)
+		, m_stack(stack) {
+	}
+
+	void reserve(size_t size, size_t stack);
+	void map_file(int fd);
+	void snapshot();
+};
+
+/**
+ * @brief Allocator of memory the kernel zeroes, so that large arrays cost only address space until touched
+ * @note  Default construction is skipped, T must be valid as all zero bytes
+ */
+template<typename T>
+struct zero_allocator_t {
+	using value_type = T;
+
+	static constexpr size_t MAP_THRESHOLD = 64 * 1024; // Smaller blocks come from calloc()
+
+	zero_allocator_t() noexcept = default;
+
+	template<typename U>
+	zero_allocator_t(const zero_allocator_t<U>&) noexcept {
+	}
+
+	T* allocate(size_t count) {
+		const size_t bytes = count * sizeof(T);
+		void*		 p	   = bytes < MAP_THRESHOLD ? std::calloc(count, sizeof(T))
+												   : mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		DA_IF_UNLIKELY(!p || p == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t count) noexcept {
+		const size_t bytes = count * sizeof(T);
+		if(bytes < MAP_THRESHOLD) {
+			std::free(p);
+		} else {
+			munmap(p, bytes);
+		}
+	}
+
+	template<typename U>
+	void construct(DA_MAYBE_UNUSED U* p) noexcept { // Already zero
+	}
+
+	template<typename U, typename... Args>
+	void construct(U* p, Args&&... args) {
+		::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	bool operator==(const zero_allocator_t&) const noexcept {
+		return true;
+	}
+
+	bool operator!=(const zero_allocator_t&) const noexcept {
+		return false;
+	}
+};
+
+// Guest memory fault, reported by run() with status 3
+struct vm_trap_t {
+	register_t pc; // Faulting command
+	addr_t	   address; // Faulting address
+};
+
+/**
+ * @brief Scope in which memory faults are guest faults
+ *
+ * While a frame is alive, SIGSEGV & SIGBUS on its thread within the guards of its memory, or on the read only code & data of @ref bounds,
+ * jump back to the sigsetjmp() on @ref jump, the innermost frame wins. Other faults go to the previous handler.
+ * Commands which may fault publish themselves first, so that the fault is precise.
+ */
+struct trap_frame_t {
+	sigjmp_buf		  jump; // Set with sigsetjmp(jump, 0) in the function owning the frame
+	const asm_inst_t* inst		= nullptr; // Last published command
+	size_t			  remaining = 0; // Budget before it
+	addr_t			  address	= 0; // Faulting address, filled by the handler
+#if DAVM_JIT
+	greg_t gregs[NGREG]; // Host registers at the fault, filled by the handler
+#endif
+	addr_t				  low, high; // Guest memory & its guards
+	const guest_bounds_t* bounds; // Read only at the fault, as VM::bind_bounds() may run after the frame is set up
+	trap_frame_t*		  prev; // Enclosing frame
+
+	trap_frame_t(const memory_t& memory, const guest_bounds_t& bounds) noexcept;
+	~trap_frame_t();
+
+	trap_frame_t(const trap_frame_t&)			 = delete;
+	trap_frame_t& operator=(const trap_frame_t&) = delete;
+};
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_MEMORY_H_
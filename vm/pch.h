@@ -13,9 +13,15 @@
 #include <common/pch.h>
 
 #include <common/asm.h>
+#include <common/decode.h>
 #include <common/log.h>
 #include <common/type.h>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <vector>
 
 #endif // _DAVM_VM_PCH_H_
@@ -0,0 +1,143 @@
+/**
+ * @file      pool.cpp
+ * @brief     Implemention of VMPool
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/pool.h>
+
+BEGIN_DA_NAMESPACE
+
+VMPool::VMPool(size_t workers, size_t slice)
+	: m_slice(slice ? slice : VM_POOL_SLICE)
+	, m_start(clock_t::now()) {
+	if(workers == 0) {
+		workers = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	for(size_t i = 0; i < workers; ++i) {
+		m_workers.push_back(std::make_unique<worker_t>());
+	}
+	for(size_t i = 0; i < workers; ++i) {
+		m_threads.emplace_back(&VMPool::work, this, i);
+	}
+}
+
+VMPool::~VMPool() {
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for(std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void VMPool::submit(std::unique_ptr<VM> vm, callback_t done) {
+	++m_submitted;
+	push(m_next++ % m_workers.size(), { std::move(vm), std::move(done), clock_t::now() });
+	{
+		std::lock_guard<std::mutex> lock(m_mutex); // Not lost by a worker about to sleep
+	}
+	m_wake.notify_one();
+}
+
+void VMPool::wait() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_completed == m_submitted; });
+}
+
+pool_stats_t VMPool::stats() const noexcept {
+	pool_stats_t stats;
+	size_t		 waits = 0;
+	stats.submitted	   = m_submitted;
+	for(const auto& worker : m_workers) {
+		stats.completed += worker->completed;
+		stats.slices += worker->slices;
+		stats.steals += worker->steals;
+		stats.retired += worker->retired;
+		waits += worker->waits;
+		stats.wait_max = std::max(stats.wait_max, double(worker->wait_max) * 1e-9);
+	}
+	stats.elapsed  = std::chrono::duration<double>(clock_t::now() - m_start).count();
+	stats.wait_avg = stats.slices ? double(waits) * 1e-9 / double(stats.slices) : 0;
+	return stats;
+}
+
+void VMPool::push(size_t worker, job_t&& job) {
+	std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+	m_workers[worker]->jobs.push_back(std::move(job));
+	++m_queued;
+}
+
+// Own deque first, then steal from the others
+bool VMPool::take(size_t self, job_t& job) {
+	const size_t count = m_workers.size();
+	for(size_t i = 0; i < count; ++i) {
+		worker_t&					victim = *m_workers[(self + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(victim.jobs.empty()) {
+			continue;
+		}
+		if(i == 0) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+		} else {
+			job = std::move(victim.jobs.back());
+			victim.jobs.pop_back();
+			++m_workers[self]->steals;
+		}
+		--m_queued;
+		return true;
+	}
+	return false;
+}
+
+void VMPool::work(size_t self) {
+	worker_t& me = *m_workers[self];
+	for(;;) {
+		job_t job;
+		if(!take(self, job)) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+			if(m_stop && m_queued == 0) {
+				return;
+			}
+			continue;
+		}
+
+		const clock_t::time_point now	 = clock_t::now();
+		const size_t			  waited = size_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.queued).count());
+		me.waits += waited;
+		if(waited > me.wait_max) {
+			me.wait_max = waited; // Only this worker writes it
+		}
+
+		const size_t before = job.vm->retired();
+		const int	 status = job.vm->run(m_slice);
+		++me.slices;
+		me.retired += job.vm->retired() - before;
+		if(status == 0) { // Preempted
+			job.queued = clock_t::now();
+			push(self, std::move(job));
+			continue;
+		}
+
+		if(job.done) {
+			job.done(std::move(job.vm), status);
+		}
+		job.vm.reset();
+		++me.completed;
+		if(++m_completed == m_submitted) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_idle.notify_all();
+		}
+	}
+}
+
+END_DA_NAMESPACE
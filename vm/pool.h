@@ -0,0 +1,128 @@
+/**
+ * @file      pool.h
+ * @brief     Work-stealing executor running many VMs on a few threads
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_POOL_H_
+#define _DAVM_VM_POOL_H_
+
+#include <vm/pch.h>
+#include <vm/vm.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr size_t VM_POOL_SLICE = 100000; // Commands run before a VM is preempted
+
+struct pool_stats_t {
+	size_t submitted = 0; // VMs submitted
+	size_t completed = 0; // VMs finished
+	size_t slices	 = 0; // Calls to VM::run()
+	size_t steals	 = 0; // VMs taken from another worker
+	size_t retired	 = 0; // Commands executed
+	double elapsed	 = 0; // Seconds since the pool started
+	double wait_avg	 = 0; // Average seconds a VM waited in a queue before each slice
+	double wait_max	 = 0; // Longest such wait
+
+	double jobs_per_second() const noexcept {
+		return elapsed > 0 ? double(completed) / elapsed : 0;
+	}
+
+	double commands_per_second() const noexcept {
+		return elapsed > 0 ? double(retired) / elapsed : 0;
+	}
+};
+
+/**
+ * @brief Runs submitted VMs on a fixed set of worker threads
+ *
+ * Every worker owns a deque, taking VMs from its front & putting preempted ones at its back,
+ * so that the VMs of a worker run round-robin, one slice of VM::run() each.
+ * A worker with an empty deque steals from the back of the others', or sleeps if all are empty.
+ */
+class VMPool {
+public:
+	using clock_t	 = std::chrono::steady_clock;
+	using callback_t = std::function<void(std::unique_ptr<VM>, int status)>;
+
+private:
+	struct job_t {
+		std::unique_ptr<VM> vm;
+		callback_t			done;
+		clock_t::time_point queued;
+	};
+
+	// Padded so that workers never share a cache line
+	struct alignas(64) worker_t {
+		std::mutex		   mutex;
+		std::deque<job_t>  jobs;
+		std::atomic_size_t completed { 0 };
+		std::atomic_size_t slices { 0 };
+		std::atomic_size_t steals { 0 };
+		std::atomic_size_t retired { 0 };
+		std::atomic_size_t waits { 0 }; // Nanoseconds waited in queues
+		std::atomic_size_t wait_max { 0 };
+	};
+
+	std::vector<std::unique_ptr<worker_t>> m_workers;
+	std::vector<std::thread>			   m_threads;
+	size_t								   m_slice;
+	clock_t::time_point					   m_start;
+
+	std::mutex				m_mutex; // Guards sleeping & waiting
+	std::condition_variable m_wake; // Jobs queued or stopping
+	std::condition_variable m_idle; // All submitted jobs completed
+	std::atomic_size_t		m_queued { 0 }; // Jobs in all deques
+	std::atomic_size_t		m_submitted { 0 };
+	std::atomic_size_t		m_completed { 0 };
+	std::atomic_size_t		m_next { 0 }; // Worker receiving the next submitted job
+	bool					m_stop = false;
+
+public:
+	/**
+	 * @param workers Count of worker threads, 0 for one per core
+	 * @param slice   Commands a VM runs before yielding to the next one
+	 */
+	explicit VMPool(size_t workers = 0, size_t slice = VM_POOL_SLICE);
+
+	// Wait for all submitted VMs, then stop the workers
+	~VMPool();
+
+	VMPool(const VMPool&)			 = delete;
+	VMPool& operator=(const VMPool&) = delete;
+
+	/**
+	 * @brief Queue @param vm to run until VM::run() returns non-zero
+	 * @param done Called on a worker thread with the VM & the final status, the VM is destroyed if omitted
+	 */
+	void submit(std::unique_ptr<VM> vm, callback_t done = {});
+
+	// Block until every submitted VM has completed
+	void wait();
+
+	size_t workers() const noexcept {
+		return m_workers.size();
+	}
+
+	pool_stats_t stats() const noexcept;
+
+private:
+	void work(size_t self);
+	bool take(size_t self, job_t& job);
+	void push(size_t worker, job_t&& job);
+};
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_POOL_H_
@@ -0,0 +1,150 @@
+/**
+ * @file      profile.cpp
+ * @brief     Implemention of the sampling profiler
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/profile.h>
+#include <vm/vm.h>
+
+#include <csignal>
+#include <ctime>
+#include <mutex>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id // Missing from older glibc
+	#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+BEGIN_DA_NAMESPACE
+
+void profiler_t::sample(const VM& vm) {
+	const register_t code	= DAVM_CAST(register_t, vm.code());
+	const register_t size	= vm.code_size();
+	auto			 offset = [&](register_t pc) { return pc - code < size ? pc - code : UNKNOWN; };
+
+	m_frames.clear();
+	m_frames.push_back(offset(DAVM_PC(vm.context())));
+	// Same walk as VM::fork(), the frame set by init_stack() holds a null return address
+	const memory_t&	 memory = vm.memory();
+	const register_t low	= DAVM_CAST(register_t, memory.end() - memory.stack_size());
+	const register_t top	= memory.stack_size() - 2 * sizeof(register_t);
+	for(register_t bp = DAVM_BP(vm.context()); bp - low <= top && !(bp & (sizeof(register_t) - 1)) && m_frames.size() < PROFILE_DEPTH;) {
+		const register_t* frame = DAVM_CAST(const register_t*, bp);
+		DA_IF_UNLIKELY(!frame[1]) {
+			break;
+		}
+		m_frames.push_back(offset(frame[1] - sizeof(word_t))); // The CALL, so that the caller is named
+		DA_IF_UNLIKELY(frame[0] <= bp) {
+			break;
+		}
+		bp = frame[0];
+	}
+	++m_stacks[m_frames];
+	++m_samples;
+}
+
+int profiler_t::run(VM& vm, size_t interval, size_t target) {
+	interval = std::max<size_t>(interval, 1);
+	for(size_t left = target;;) {
+		const size_t slice	= target ? std::min(interval, left) : interval;
+		const int	 status = vm.run(slice);
+		if(status) {
+			return status;
+		}
+		sample(vm);
+		if(target && !(left -= slice)) {
+			return 0;
+		}
+	}
+}
+
+// SIGPROF of the timer of run_timer(), which passes the flag to set
+static void profile_signal(int, siginfo_t* info, void*) {
+	if(info->si_code == SI_TIMER && info->si_value.sival_ptr) {
+		static_cast<std::atomic<bool>*>(info->si_value.sival_ptr)->store(true, std::memory_order_relaxed);
+	}
+}
+
+int profiler_t::run_timer(VM& vm, std::chrono::microseconds period, size_t target) {
+	static std::once_flag installed;
+	std::call_once(installed, [] {
+		struct sigaction action {};
+		action.sa_sigaction = profile_signal;
+		action.sa_flags		= SA_SIGINFO | SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGPROF, &action, nullptr);
+	});
+
+	// CPU time of this thread, delivered to it, so that VMs profiled by other threads keep their own timers
+	sigevent event {};
+	event.sigev_notify			 = SIGEV_THREAD_ID;
+	event.sigev_signo			 = SIGPROF;
+	event.sigev_value.sival_ptr	 = &m_fired;
+	event.sigev_notify_thread_id = gettid();
+	timer_t timer;
+	DA_IF_UNLIKELY(timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer)) {
+		DAVM_LOG_ERROR("Cannot create the timer of the profiler, errno {}", errno);
+		return run(vm, PROFILE_INTERVAL, target);
+	}
+	const auto		  us	= std::max<int64_t>(period.count(), 1);
+	const timespec	  every = { time_t(us / 1000000), long(us % 1000000 * 1000) };
+	const itimerspec  spec	= { every, every };
+	timer_settime(timer, 0, &spec, nullptr);
+
+	m_fired.store(false, std::memory_order_relaxed);
+	int status = 0;
+	for(size_t left = target;;) {
+		const size_t slice = target ? std::min(PROFILE_SLICE, left) : PROFILE_SLICE;
+		status			   = vm.run(slice);
+		if(status) {
+			break;
+		}
+		if(m_fired.exchange(false, std::memory_order_relaxed)) {
+			sample(vm);
+		}
+		if(target && !(left -= slice)) {
+			break;
+		}
+	}
+	timer_delete(timer);
+	return status;
+}
+
+void profiler_t::write_folded(std::ostream& out, const VM& vm) const {
+	const image_t* image = vm.image();
+	auto		   name	 = [&](uint64_t offset) -> std::string {
+		  if(offset == UNKNOWN) {
+			  return "[unknown]";
+		  }
+		  if(image && offset < image->section_size(IMAGE_TEXT)) {
+			  if(const std::string_view symbol = image->symbol(offset); !symbol.empty()) {
+				  return std::string(symbol);
+			  }
+		  }
+		  return fmt::format("{:#x}", offset);
+	};
+
+	// Stacks of different pc in the same functions merge
+	std::map<std::string, size_t> folded;
+	std::string					  line;
+	for(const auto& [frames, count] : m_stacks) {
+		line.clear();
+		for(auto it = frames.rbegin(); it != frames.rend(); ++it) {
+			if(!line.empty()) {
+				line += ';';
+			}
+			line += name(*it);
+		}
+		folded[line] += count;
+	}
+	for(const auto& [stack, count] : folded) {
+		out << stack << ' ' << count << '\n';
+	}
+}
+
+END_DA_NAMESPACE
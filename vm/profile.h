@@ -0,0 +1,79 @@
+/**
+ * @file      profile.h
+ * @brief     Sampling profiler of guest call stacks
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_PROFILE_H_
+#define _DAVM_VM_PROFILE_H_
+
+#include <vm/pch.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <ostream>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr size_t PROFILE_INTERVAL = 10000; // Commands between samples by default
+inline constexpr size_t PROFILE_SLICE	 = 4096; // Commands run between checks of the timer
+inline constexpr size_t PROFILE_DEPTH	 = 256; // Frames unwound at most
+
+class VM;
+
+/**
+ * @brief Samples the pc of a VM & the frames chained from bp, then writes them as folded stacks
+ *
+ * CALL saves bp at [bp] & the return address at [bp + 8], so the stack is walked without unwinding tables,
+ * until the frame set by the VM, or one not above the previous in the stack.
+ * Samples are taken between the slices of run(), so that the loops of the VM stay untouched & run at full speed.
+ */
+class profiler_t {
+	std::map<std::vector<uint64_t>, size_t> m_stacks; // Offsets in the code, innermost first, & their samples
+	std::vector<uint64_t>					 m_frames; // Stack being sampled
+	size_t									 m_samples = 0;
+	std::atomic<bool>						 m_fired { false }; // Set by the timer
+
+public:
+	static constexpr uint64_t UNKNOWN = ~uint64_t(0); // Offset of a pc outside the code
+
+	// Record the stack of @param vm as it stands
+	void sample(const VM& vm);
+
+	/**
+	 * @brief  Run @param vm, sampling it every @param interval commands
+	 * @param  target Maximum count of commands to execute, 0 for unlimited
+	 * @return Status of VM::run(), 0 once @param target commands are executed
+	 */
+	int run(VM& vm, size_t interval = PROFILE_INTERVAL, size_t target = 0);
+
+	/**
+	 * @brief  Same as above, but sampling every @param period of CPU time of the calling thread
+	 * @note   SIGPROF delivered by a POSIX timer flags the sample, which is taken after the slice running,
+	 *         so samples lag by at most PROFILE_SLICE commands. The handler is installed on first use & kept
+	 */
+	int run_timer(VM& vm, std::chrono::microseconds period, size_t target = 0);
+
+	/**
+	 * @brief Write one line per distinct stack, `outer;...;inner count`, as read by flamegraph.pl & others
+	 * @param vm Resolves offsets to the symbols of its image, hexadecimal offsets are written without one
+	 */
+	void write_folded(std::ostream& out, const VM& vm) const;
+
+	size_t samples() const noexcept {
+		return m_samples;
+	}
+
+	void clear() noexcept {
+		m_stacks.clear();
+		m_samples = 0;
+	}
+};
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_PROFILE_H_
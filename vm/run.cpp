@@ -0,0 +1,734 @@
+/**
+ * @file      run.cpp
+ * @brief     Execution loops of VM
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/run.h>
+#include <vm/vm.h>
+
+BEGIN_DA_NAMESPACE
+
+// Branch conditions
+inline bool cond_beq(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return context.x[inst->rd] == context.x[inst->ra];
+}
+
+inline bool cond_bne(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return context.x[inst->rd] != context.x[inst->ra];
+}
+
+inline bool cond_blt(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return sregister_t(context.x[inst->rd]) < sregister_t(context.x[inst->ra]);
+}
+
+inline bool cond_bge(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return sregister_t(context.x[inst->rd]) >= sregister_t(context.x[inst->ra]);
+}
+
+inline bool cond_bltu(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return context.x[inst->rd] < context.x[inst->ra];
+}
+
+inline bool cond_bgeu(const vm_context_t& context, const asm_inst_t* inst) noexcept {
+	return context.x[inst->rd] >= context.x[inst->ra];
+}
+
+// Plain switch
+
+template<bool Verified>
+int VM::loop_switch(run_state_t state) noexcept {
+	vm_context_t&	  context = m_context;
+	const asm_inst_t* inst	  = state.fetch(DAVM_PC(context));
+	size_t			  budget  = state.limit;
+	DA_IF_UNLIKELY(!inst) {
+		return 1;
+	}
+
+// Execute a command which does not touch pc
+#define DAVM_EXEC(func)       \
+	func(context, *inst); \
+	++inst;               \
+	continue
+
+// Execute a command which may fault
+#define DAVM_ACCESS(func)            \
+	state.publish(inst, budget + 1); \
+	DAVM_EXEC(func)
+
+// Execute a command which may read or write pc
+#define DAVM_SYNC(func)                        \
+	state.publish(inst, budget + 1);          \
+	DAVM_PC(context) = state.pc_of(inst + 1); \
+	func(context, *inst);                     \
+	goto jump
+
+#define DAVM_BRANCH(cond)     \
+	if(cond(context, inst)) { \
+		goto take;            \
+	}                         \
+	++inst;                   \
+	continue
+
+// Reserve budget for the rest of a fused command, or execute its first command alone
+#define DAVM_FUSE(count)               \
+	DA_IF_UNLIKELY(budget < (count)) { \
+		goto single;                   \
+	}                                  \
+	budget -= (count)
+
+// Execute a leading command of a fused command, followed by @param left commands
+#define DAVM_LEAD(op, left)                       \
+	if constexpr(is_access(OP_##op)) {            \
+		state.publish(inst, budget + 1 + (left)); \
+	}                                             \
+	exec_table[OP_##op](context, *inst);          \
+	++inst
+
+	for(;;) {
+		DA_IF_UNLIKELY(budget == 0) {
+			return state.leave(state.pc_of(inst), budget, 0);
+		}
+		--budget;
+	dispatch:
+		switch(inst->id) {
+#define DA_X(big, type, small...) \
+	case OP_##big:                \
+		DAVM_EXEC(exec_r3<asm_##small>);
+			DA_X_ARITH
+#undef DA_X
+#define DA_X(big, type, small...) \
+	case OP_##big:                \
+		DAVM_ACCESS(exec_##small);
+			DA_X_LOAD
+			DA_X_SAVE
+#undef DA_X
+#define DA_X(big, type, small...) \
+	case OP_##big:                \
+		DAVM_EXEC(exec_##small);
+			DA_X_IMM
+			DA_X_IMM_SHIFT
+#undef DA_X
+#define DA_X(big, ...) \
+	case OP_##big:     \
+		DAVM_ACCESS(exec_table[OP_##big]);
+			DA_X_VECTOR_MEMORY
+			DA_X_FLOAT_MEMORY
+			DA_X_BULK
+			DA_X_ATOMIC
+#undef DA_X
+#define DA_X(big, ...) \
+	case OP_##big:     \
+		DAVM_EXEC(exec_table[OP_##big]);
+			DA_X_VECTOR
+			DA_X_VECTOR_REDUCE
+			DA_X_VECTOR_EXTRACT
+			DA_X_VECTOR_SPLAT
+			DA_X_FLOAT_FMA
+			DA_X_FLOAT
+			DA_X_FLOAT_UNARY
+			DA_X_FLOAT_COMPARE
+			DA_X_FLOAT_TO_X
+			DA_X_FLOAT_FROM_X
+#undef DA_X
+		case OP_MOV:
+			DAVM_EXEC(exec_r2<asm_mov>);
+		case OP_PUSH:
+			DAVM_ACCESS(exec_r1<asm_push>);
+		case OP_POP:
+			DAVM_ACCESS(exec_r1<asm_pop>);
+		case OP_LUI:
+			DAVM_EXEC(exec_lui);
+		case OP_AUIPC:
+			DAVM_PC(context) = state.pc_of(inst + 1);
+			DAVM_EXEC(exec_auipc);
+		case OP_RET:
+			DAVM_SYNC(exec_v<asm_ret>);
+		case OP_HLT:
+			DAVM_SYNC(exec_v<asm_hlt>);
+		case OP_ECALL:
+			return state.leave(state.pc_of(inst + 1), budget, 4);
+		case OP_CALL:
+			DAVM_SYNC(exec_r1<asm_call>);
+		case OP_JALR:
+			DAVM_SYNC(exec_jalr);
+		case OP_GENERIC:
+			DAVM_SYNC(inst->func);
+		case OP_JAL:
+			context.x[inst->rd] = state.pc_of(inst + 1);
+			goto take;
+		case OP_BEQ:
+			DAVM_BRANCH(cond_beq);
+		case OP_BNE:
+			DAVM_BRANCH(cond_bne);
+		case OP_BLT:
+			DAVM_BRANCH(cond_blt);
+		case OP_BGE:
+			DAVM_BRANCH(cond_bge);
+		case OP_BLTU:
+			DAVM_BRANCH(cond_bltu);
+		case OP_BGEU:
+			DAVM_BRANCH(cond_bgeu);
+#define DA_X(name, a, b) \
+	case OP_##name:      \
+		DAVM_FUSE(1);    \
+		DAVM_LEAD(a, 1); \
+		goto dispatch;
+			DA_X_FUSED_PAIR
+#undef DA_X
+#define DA_X(name, a, b, c) \
+	case OP_##name:         \
+		DAVM_FUSE(2);       \
+		DAVM_LEAD(a, 2);    \
+		DAVM_LEAD(b, 1);    \
+		goto dispatch;
+			DA_X_FUSED_TRIPLE
+#undef DA_X
+		case OP_UNDECODED:
+			inst = state.decode(inst);
+			DA_IF_UNLIKELY(inst->id == OP_UNDECODED) { // Sentinel, fall off the end
+				return state.leave(state.pc_of(inst), budget + 1, 1);
+			}
+			goto dispatch;
+		case OP_ERROR:
+		default:
+			return state.leave(state.pc_of(inst + 1), budget + 1, 2);
+		}
+	take: {
+		const asm_inst_t* next = state.target<Verified>(inst);
+		if constexpr(!Verified) {
+			DA_IF_UNLIKELY(!next) {
+				return state.leave(state.pc_of(inst + 1) + inst->imm, budget, 1);
+			}
+		}
+		inst = next;
+		continue;
+	}
+	single: // The first command of a fused one is always straight
+		state.publish(inst, budget + 1);
+		exec_table[inst->op](context, *inst);
+		++inst;
+		continue;
+	jump:
+		inst = state.fetch(DAVM_PC(context));
+		DA_IF_UNLIKELY(!inst) {
+			return state.leave(DAVM_PC(context), budget, 1);
+		}
+	}
+
+#undef DAVM_EXEC
+#undef DAVM_ACCESS
+#undef DAVM_SYNC
+#undef DAVM_BRANCH
+#undef DAVM_FUSE
+#undef DAVM_LEAD
+}
+
+int VM::run_switch(size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return 2;
+	}
+	trap_frame_t frame(m_memory, m_context.bounds);
+	run_state_t	 state(*this, target, frame);
+	if(sigsetjmp(frame.jump, 0)) {
+		return state.fault();
+	}
+	return m_verified ? loop_switch<true>(state) : loop_switch<false>(state);
+}
+
+
+// Computed goto
+
+#if DA_COMP_GNU
+template<bool Verified, bool Jit>
+int VM::loop_goto(run_state_t state) noexcept {
+	vm_context_t&	  context = m_context;
+	const asm_inst_t* inst	  = state.fetch(DAVM_PC(context));
+	size_t			  budget  = state.limit;
+	DA_IF_UNLIKELY(!inst) {
+		return 1;
+	}
+
+	#define DA_X(big, ...) &&L_##big,
+
+	static void* const labels[] = {
+		&&L_UNDECODED,
+		&&L_ERROR,
+		&&L_GENERIC,
+		// clang-format off
+		DA_X_V
+		DA_X_R1
+		DA_X_R2
+		DA_X_R1I1
+		DA_X_ARITH
+		DA_X_LOAD
+		DA_X_SAVE
+		DA_X_IMM
+		DA_X_IMM_SHIFT
+		DA_X_BRANCH
+		DA_X_VECTOR_MEMORY
+		DA_X_VECTOR
+		DA_X_VECTOR_REDUCE
+		DA_X_VECTOR_EXTRACT
+		DA_X_VECTOR_SPLAT
+		DA_X_FLOAT_MEMORY
+		DA_X_FLOAT_FMA
+		DA_X_FLOAT
+		DA_X_FLOAT_UNARY
+		DA_X_FLOAT_COMPARE
+		DA_X_FLOAT_TO_X
+		DA_X_FLOAT_FROM_X
+		DA_X_BULK
+		DA_X_ATOMIC
+		DA_X_FUSED_PAIR
+		DA_X_FUSED_TRIPLE
+		// clang-format on
+	};
+	static_assert(std::size(labels) == OP_COUNT);
+
+	#undef DA_X
+
+	#define DAVM_NEXT()                   \
+		DA_IF_UNLIKELY(budget == 0) {     \
+			goto stop;                    \
+		}                                 \
+		--budget;                         \
+		goto* labels[inst->id]
+
+	#define DAVM_EXEC(func)   \
+		func(context, *inst); \
+		++inst;               \
+		DAVM_NEXT()
+
+	#define DAVM_ACCESS(func)            \
+		state.publish(inst, budget + 1); \
+		DAVM_EXEC(func)
+
+	#define DAVM_SYNC(func)                        \
+		state.publish(inst, budget + 1);          \
+		DAVM_PC(context) = state.pc_of(inst + 1); \
+		func(context, *inst);                     \
+		goto jump
+
+	#define DAVM_BRANCH(cond)     \
+		if(cond(context, inst)) { \
+			goto take;            \
+		}                         \
+		++inst;                   \
+		DAVM_NEXT()
+
+	#define DAVM_FUSE(count)               \
+		DA_IF_UNLIKELY(budget < (count)) { \
+			goto single;                   \
+		}                                  \
+		budget -= (count)
+
+	#define DAVM_LEAD(op, left)                       \
+		if constexpr(is_access(OP_##op)) {            \
+			state.publish(inst, budget + 1 + (left)); \
+		}                                             \
+		exec_table[OP_##op](context, *inst);          \
+		++inst
+
+	DAVM_NEXT();
+
+	#define DA_X(big, type, small...) \
+	L_##big:                          \
+		DAVM_EXEC(exec_r3<asm_##small>);
+	DA_X_ARITH
+	#undef DA_X
+	#define DA_X(big, type, small...) \
+	L_##big:                          \
+		DAVM_ACCESS(exec_##small);
+	DA_X_LOAD
+	DA_X_SAVE
+	#undef DA_X
+	#define DA_X(big, type, small...) \
+	L_##big:                          \
+		DAVM_EXEC(exec_##small);
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	#undef DA_X
+	#define DA_X(big, ...) \
+	L_##big:               \
+		DAVM_ACCESS(exec_table[OP_##big]);
+	DA_X_VECTOR_MEMORY
+	DA_X_FLOAT_MEMORY
+	DA_X_BULK
+	DA_X_ATOMIC
+	#undef DA_X
+	#define DA_X(big, ...) \
+	L_##big:               \
+		DAVM_EXEC(exec_table[OP_##big]);
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	#undef DA_X
+L_MOV:
+	DAVM_EXEC(exec_r2<asm_mov>);
+L_PUSH:
+	DAVM_ACCESS(exec_r1<asm_push>);
+L_POP:
+	DAVM_ACCESS(exec_r1<asm_pop>);
+L_LUI:
+	DAVM_EXEC(exec_lui);
+L_AUIPC:
+	DAVM_PC(context) = state.pc_of(inst + 1);
+	DAVM_EXEC(exec_auipc);
+L_RET:
+	DAVM_SYNC(exec_v<asm_ret>);
+L_HLT:
+	DAVM_SYNC(exec_v<asm_hlt>);
+L_ECALL:
+	return state.leave(state.pc_of(inst + 1), budget, 4);
+L_CALL:
+	DAVM_SYNC(exec_r1<asm_call>);
+L_JALR:
+	DAVM_SYNC(exec_jalr);
+L_GENERIC:
+	DAVM_SYNC(inst->func);
+L_JAL:
+	context.x[inst->rd] = state.pc_of(inst + 1);
+	goto take;
+L_BEQ:
+	DAVM_BRANCH(cond_beq);
+L_BNE:
+	DAVM_BRANCH(cond_bne);
+L_BLT:
+	DAVM_BRANCH(cond_blt);
+L_BGE:
+	DAVM_BRANCH(cond_bge);
+L_BLTU:
+	DAVM_BRANCH(cond_bltu);
+L_BGEU:
+	DAVM_BRANCH(cond_bgeu);
+	// The last command of a fused one is reached by a direct jump
+	#define DA_X(name, a, b) \
+	L_##name:                \
+		DAVM_FUSE(1);        \
+		DAVM_LEAD(a, 1);     \
+		goto L_##b;
+	DA_X_FUSED_PAIR
+	#undef DA_X
+	#define DA_X(name, a, b, c) \
+	L_##name:                   \
+		DAVM_FUSE(2);           \
+		DAVM_LEAD(a, 2);        \
+		DAVM_LEAD(b, 1);        \
+		goto L_##c;
+	DA_X_FUSED_TRIPLE
+	#undef DA_X
+single:
+	state.publish(inst, budget + 1);
+	exec_table[inst->op](context, *inst);
+	++inst;
+	DAVM_NEXT();
+L_UNDECODED:
+	inst = state.decode(inst);
+	DA_IF_UNLIKELY(inst->id == OP_UNDECODED) { // Sentinel, fall off the end
+		return state.leave(state.pc_of(inst), budget + 1, 1);
+	}
+	goto* labels[inst->id];
+L_ERROR:
+	return state.leave(state.pc_of(inst + 1), budget + 1, 2);
+take: {
+	const asm_inst_t* next = state.target<Verified>(inst);
+	if constexpr(!Verified) {
+		DA_IF_UNLIKELY(!next) {
+			return state.leave(state.pc_of(inst + 1) + inst->imm, budget, 1);
+		}
+	}
+	inst = next;
+	goto head;
+}
+jump:
+	inst = state.fetch(DAVM_PC(context));
+	DA_IF_UNLIKELY(!inst) {
+		return state.leave(DAVM_PC(context), budget, 1);
+	}
+head:
+	if constexpr(Jit) {
+		DA_IF_UNLIKELY(state.watch[inst - state.base]) {
+			goto stop;
+		}
+	}
+	DAVM_NEXT();
+stop:
+	return state.leave(state.pc_of(inst), budget, 0);
+
+	#undef DAVM_NEXT
+	#undef DAVM_EXEC
+	#undef DAVM_ACCESS
+	#undef DAVM_SYNC
+	#undef DAVM_BRANCH
+	#undef DAVM_FUSE
+	#undef DAVM_LEAD
+}
+
+int VM::run_goto(size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return 2;
+	}
+	trap_frame_t frame(m_memory, m_context.bounds);
+	run_state_t	 state(*this, target, frame);
+	if(sigsetjmp(frame.jump, 0)) {
+		return state.fault();
+	}
+	return m_verified ? loop_goto<true>(state) : loop_goto<false>(state);
+}
+
+	#if DAVM_JIT // Run by run_jit() between the blocks it compiled
+template int VM::loop_goto<true, true>(run_state_t state) noexcept;
+template int VM::loop_goto<false, true>(run_state_t state) noexcept;
+	#endif
+#endif
+
+// Threaded code, every handler tail calls the next one
+
+#if DA_HAS_MUSTTAIL
+using tail_func_t = int (*)(vm_context_t&, const asm_inst_t*, size_t, run_state_t&) noexcept;
+
+// Handlers in op_t order, one set for each mode
+template<bool Verified>
+struct tail_table_t {
+	static const tail_func_t table[OP_COUNT];
+};
+
+	#define DAVM_NEXT()                                                                              \
+		DA_IF_UNLIKELY(budget == 0) {                                                                \
+			return state.leave(state.pc_of(inst), budget, 0);                                        \
+		}                                                                                            \
+		DA_MUSTTAIL return tail_table_t<Verified>::table[inst->id](context, inst, budget - 1, state)
+
+	#define DAVM_JUMP()                                      \
+		inst = state.fetch(DAVM_PC(context));                \
+		DA_IF_UNLIKELY(!inst) {                              \
+			return state.leave(DAVM_PC(context), budget, 1); \
+		}                                                    \
+		DAVM_NEXT()
+
+	#define DAVM_TAKE()                                                           \
+		const asm_inst_t* next = state.target<Verified>(inst);                    \
+		if constexpr(!Verified) {                                                 \
+			DA_IF_UNLIKELY(!next) {                                               \
+				return state.leave(state.pc_of(inst + 1) + inst->imm, budget, 1); \
+			}                                                                     \
+		}                                                                         \
+		inst = next;                                                              \
+		DAVM_NEXT()
+
+template<bool Verified, asm_func_t F>
+int tail_exec(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	F(context, *inst);
+	++inst;
+	DAVM_NEXT();
+}
+
+template<bool Verified, asm_func_t F>
+int tail_access(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	state.publish(inst, budget + 1);
+	F(context, *inst);
+	++inst;
+	DAVM_NEXT();
+}
+
+template<bool Verified, asm_func_t F>
+int tail_sync(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	state.publish(inst, budget + 1);
+	DAVM_PC(context) = state.pc_of(inst + 1);
+	F(context, *inst);
+	DAVM_JUMP();
+}
+
+template<bool Verified, bool (*C)(const vm_context_t&, const asm_inst_t*) noexcept>
+int tail_branch(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	if(C(context, inst)) {
+		DAVM_TAKE();
+	}
+	++inst;
+	DAVM_NEXT();
+}
+
+template<uint8_t Op>
+DA_ALWAYS_INLINE void tail_lead(vm_context_t& context, const asm_inst_t*& inst, size_t remaining, run_state_t& state) noexcept {
+	if constexpr(is_access(Op)) {
+		state.publish(inst, remaining);
+	}
+	exec_table[Op](context, *inst);
+	++inst;
+}
+
+// Execute the leading commands, then tail call the last one directly
+template<bool Verified, uint8_t Last, uint8_t... Lead>
+int tail_fused(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	DA_IF_UNLIKELY(budget < sizeof...(Lead)) {
+		state.publish(inst, budget + 1);
+		exec_table[inst->op](context, *inst); // The first command is always straight
+		++inst;
+		DAVM_NEXT();
+	}
+	size_t remaining = budget + 1;
+	(tail_lead<Lead>(context, inst, remaining--, state), ...);
+	DA_MUSTTAIL return tail_table_t<Verified>::table[Last](context, inst, budget - sizeof...(Lead), state);
+}
+
+template<bool Verified>
+int tail_auipc(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	DAVM_PC(context) = state.pc_of(inst + 1);
+	exec_auipc(context, *inst);
+	++inst;
+	DAVM_NEXT();
+}
+
+template<bool Verified>
+int tail_generic(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	state.publish(inst, budget + 1);
+	DAVM_PC(context) = state.pc_of(inst + 1);
+	inst->func(context, *inst);
+	DAVM_JUMP();
+}
+
+template<bool Verified>
+int tail_jal(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	context.x[inst->rd] = state.pc_of(inst + 1);
+	DAVM_TAKE();
+}
+
+template<bool Verified>
+int tail_ecall(DA_MAYBE_UNUSED vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	return state.leave(state.pc_of(inst + 1), budget, 4);
+}
+
+template<bool Verified>
+int tail_undecoded(vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	inst = state.decode(inst);
+	DA_IF_UNLIKELY(inst->id == OP_UNDECODED) { // Sentinel, fall off the end
+		return state.leave(state.pc_of(inst), budget + 1, 1);
+	}
+	DA_MUSTTAIL return tail_table_t<Verified>::table[inst->id](context, inst, budget, state);
+}
+
+template<bool Verified>
+int tail_error(DA_MAYBE_UNUSED vm_context_t& context, const asm_inst_t* inst, size_t budget, run_state_t& state) noexcept {
+	return state.leave(state.pc_of(inst + 1), budget + 1, 2);
+}
+
+	#define DA_X(big, type, small...) tail_exec<Verified, exec_r3<asm_##small>>,
+	#define DA_X_EXEC(big, type, small...) tail_exec<Verified, exec_##small>,
+	#define DA_X_ACCESS(big, type, small...) tail_access<Verified, exec_##small>,
+
+template<bool Verified>
+const tail_func_t tail_table_t<Verified>::table[OP_COUNT] = {
+	tail_undecoded<Verified>,
+	tail_error<Verified>,
+	tail_generic<Verified>,
+	// V
+	tail_sync<Verified, exec_v<asm_ret>>,
+	tail_sync<Verified, exec_v<asm_hlt>>,
+	tail_ecall<Verified>,
+	// R1
+	tail_access<Verified, exec_r1<asm_push>>,
+	tail_access<Verified, exec_r1<asm_pop>>,
+	tail_sync<Verified, exec_r1<asm_call>>,
+	// R2
+	tail_exec<Verified, exec_r2<asm_mov>>,
+	// R1I1
+	tail_exec<Verified, exec_lui>,
+	tail_auipc<Verified>,
+	tail_jal<Verified>,
+	// clang-format off
+	DA_X_ARITH
+	#undef DA_X
+	#define DA_X DA_X_ACCESS
+	DA_X_LOAD
+	DA_X_SAVE
+	#undef DA_X
+	#define DA_X DA_X_EXEC
+	DA_X_IMM
+	DA_X_IMM_SHIFT
+	// clang-format on
+	// Branch
+	tail_sync<Verified, exec_jalr>,
+	tail_branch<Verified, cond_beq>,
+	tail_branch<Verified, cond_bne>,
+	tail_branch<Verified, cond_blt>,
+	tail_branch<Verified, cond_bge>,
+	tail_branch<Verified, cond_bltu>,
+	tail_branch<Verified, cond_bgeu>,
+	// Vector
+	#undef DA_X
+	#define DA_X(big, ...) tail_access<Verified, exec_table[OP_##big]>,
+	DA_X_VECTOR_MEMORY
+	#undef DA_X
+	#define DA_X(big, ...) tail_exec<Verified, exec_table[OP_##big]>,
+	DA_X_VECTOR
+	DA_X_VECTOR_REDUCE
+	DA_X_VECTOR_EXTRACT
+	DA_X_VECTOR_SPLAT
+	// Float
+	#undef DA_X
+	#define DA_X(big, ...) tail_access<Verified, exec_table[OP_##big]>,
+	DA_X_FLOAT_MEMORY
+	#undef DA_X
+	#define DA_X(big, ...) tail_exec<Verified, exec_table[OP_##big]>,
+	DA_X_FLOAT_FMA
+	DA_X_FLOAT
+	DA_X_FLOAT_UNARY
+	DA_X_FLOAT_COMPARE
+	DA_X_FLOAT_TO_X
+	DA_X_FLOAT_FROM_X
+	// Bulk
+	#undef DA_X
+	#define DA_X(big, ...) tail_access<Verified, exec_table[OP_##big]>,
+	DA_X_BULK
+	DA_X_ATOMIC
+	// Fused
+	#undef DA_X
+	#define DA_X(name, a, b) tail_fused<Verified, OP_##b, OP_##a>,
+	DA_X_FUSED_PAIR
+	#undef DA_X
+	#define DA_X(name, a, b, c) tail_fused<Verified, OP_##c, OP_##a, OP_##b>,
+	DA_X_FUSED_TRIPLE
+};
+
+	#undef DA_X
+	#undef DA_X_EXEC
+	#undef DA_X_ACCESS
+	#undef DAVM_NEXT
+	#undef DAVM_JUMP
+	#undef DAVM_TAKE
+
+template<bool Verified>
+int VM::loop_tail(run_state_t& state) noexcept {
+	const asm_inst_t* inst = state.fetch(DAVM_PC(m_context));
+	DA_IF_UNLIKELY(!inst) {
+		return 1;
+	}
+	return tail_table_t<Verified>::table[inst->id](m_context, inst, state.limit - 1, state);
+}
+
+int VM::run_tail(size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return 2;
+	}
+	trap_frame_t frame(m_memory, m_context.bounds);
+	run_state_t	 state(*this, target, frame);
+	if(sigsetjmp(frame.jump, 0)) {
+		return state.fault();
+	}
+	return m_verified ? loop_tail<true>(state) : loop_tail<false>(state);
+}
+#endif
+
+END_DA_NAMESPACE
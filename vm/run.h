@@ -0,0 +1,101 @@
+/**
+ * @file      run.h
+ * @brief     Shared state of the execution loops
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_RUN_H_
+#define _DAVM_VM_RUN_H_
+
+#include <vm/pch.h>
+#include <vm/vm.h>
+
+BEGIN_DA_NAMESPACE
+
+// All loops keep the current command in a host local instead of pc,
+// pc is only written back when a command reads it or the loop exits.
+// Straight-line commands need no pc check at all, since falling off the end hits the sentinel record.
+// Commands which may fault are published to the trap frame, so that a fault is reported at them.
+struct run_state_t {
+	VM&				  vm;
+	const asm_inst_t* base; // First record
+	size_t			  count; // Count of commands
+	register_t		  origin; // Address of the first command
+	size_t			  limit; // Initial budget
+	trap_frame_t*	  frame;
+	const uint8_t*	  watch = nullptr; // Record -> whether run_jit() wants it back when jumped to, see jit_t
+
+	// The caller did VM::sync_decoded() first
+	run_state_t(VM& vm, size_t target, trap_frame_t& frame)
+		: vm(vm)
+		, limit(target ? target : ~size_t(0))
+		, frame(&frame) {
+		DA_IF_UNLIKELY(!vm.m_checked) { // After any flush, which leaves verified mode
+			vm.check();
+		}
+		base   = vm.m_decoded.data();
+		count  = vm.m_decoded.size() - 1;
+		origin = DAVM_CAST(register_t, vm.code());
+		frame.remaining = limit;
+		vm.m_memory.mark_dirty();
+		vm.bind_bounds();
+	}
+
+	register_t pc_of(const asm_inst_t* inst) const noexcept {
+		return origin + register_t(inst - base) * sizeof(word_t);
+	}
+
+	// Command at @param pc, nullptr if outside program
+	const asm_inst_t* fetch(register_t pc) const noexcept {
+		const register_t offset = pc - origin;
+		DA_IF_UNLIKELY(offset / sizeof(word_t) >= count || (offset & (sizeof(word_t) - 1))) {
+			return nullptr;
+		}
+		return base + offset / sizeof(word_t);
+	}
+
+	// Target of a direct jump, nullptr if outside program
+	// Verified programs never jump outside, so the check is dropped
+	template<bool Verified = false>
+	const asm_inst_t* target(const asm_inst_t* inst) const noexcept {
+		const size_t index = size_t(inst - base) + 1 + size_t(inst->imm / sregister_t(sizeof(word_t)));
+		if constexpr(!Verified) {
+			DA_IF_UNLIKELY(index >= count) {
+				return nullptr;
+			}
+		}
+		return base + index;
+	}
+
+	const asm_inst_t* decode(const asm_inst_t* inst) noexcept {
+		return vm.decode_page(size_t(inst - base));
+	}
+
+	int leave(register_t pc, size_t budget, int status) noexcept {
+		DAVM_PC(vm.m_context) = pc;
+		vm.m_retired += limit - budget;
+		return status;
+	}
+
+	// Publish @param inst before executing it, @param remaining is the budget before it
+	// The fence keeps the stores before the access, which the compiler cannot see may jump to the trap frame
+	void publish(const asm_inst_t* inst, size_t remaining) noexcept {
+		frame->inst		 = inst;
+		frame->remaining = remaining;
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+
+	// Leave at the last published command after the trap frame caught a fault
+	int fault() noexcept {
+		const register_t pc = frame->inst ? pc_of(frame->inst) : DAVM_PC(vm.m_context);
+		vm.m_trap			= { pc, frame->address };
+		return leave(pc, frame->remaining, 3);
+	}
+};
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_RUN_H_
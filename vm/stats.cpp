@@ -0,0 +1,237 @@
+/**
+ * @file      stats.cpp
+ * @brief     Implemention of execution counters
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/run.h>
+#include <vm/stats.h>
+#include <vm/vm.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+BEGIN_DA_NAMESPACE
+
+// Hardware counters
+
+perf_counters_t::~perf_counters_t() {
+	close();
+}
+
+bool perf_counters_t::open(std::string& error) {
+	static constexpr uint64_t configs[PERF_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES };
+	close();
+	const long page_size = sysconf(_SC_PAGESIZE);
+	m_rdpmc				 = true;
+	for(size_t i = 0; i < PERF_EVENTS; ++i) {
+		perf_event_attr attr {};
+		attr.type			= PERF_TYPE_HARDWARE;
+		attr.size			= sizeof(attr);
+		attr.config			= configs[i];
+		attr.read_format	= PERF_FORMAT_GROUP;
+		attr.disabled		= i == 0; // The group starts with its leader
+		attr.exclude_kernel = 1;
+		attr.exclude_hv		= 1;
+		const int fd		= int(syscall(SYS_perf_event_open, &attr, 0, -1, i ? m_counters[0].fd : -1, 0));
+		if(fd < 0) {
+			error = fmt::format("Cannot open {}: {}", perf_event_name[i], std::strerror(errno));
+			close();
+			return false;
+		}
+		m_counters[i].fd = fd;
+		void* page		 = mmap(nullptr, size_t(page_size), PROT_READ, MAP_SHARED, fd, 0);
+		if(page != MAP_FAILED) {
+			m_counters[i].page = page;
+		}
+#if defined(__x86_64__) || defined(__i386__)
+		m_rdpmc &= m_counters[i].page && static_cast<perf_event_mmap_page*>(m_counters[i].page)->cap_user_rdpmc;
+#else
+		m_rdpmc = false;
+#endif
+	}
+	ioctl(m_counters[0].fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return true;
+}
+
+void perf_counters_t::close() noexcept {
+	const long page_size = sysconf(_SC_PAGESIZE);
+	for(counter_t& counter : m_counters) {
+		if(counter.page) {
+			munmap(counter.page, size_t(page_size));
+		}
+		if(counter.fd >= 0) {
+			::close(counter.fd);
+		}
+		counter = {};
+	}
+}
+
+void perf_counters_t::read(uint64_t (&values)[PERF_EVENTS]) const noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+	DA_IF_LIKELY(m_rdpmc) { // Seqlock of the kernel, see perf_event_mmap_page
+		for(size_t i = 0; i < PERF_EVENTS; ++i) {
+			const volatile perf_event_mmap_page* page = static_cast<const perf_event_mmap_page*>(m_counters[i].page);
+			uint32_t							 seq;
+			do {
+				seq = page->lock;
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+				const uint32_t index = page->index;
+				int64_t		   count = page->offset;
+				if(index) { // 0 while the counter is not scheduled
+					const unsigned shift = 64 - page->pmc_width;
+					count += int64_t(uint64_t(__builtin_ia32_rdpmc(int(index - 1))) << shift) >> shift;
+				}
+				values[i] = uint64_t(count);
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+			} while(page->lock != seq);
+		}
+		return;
+	}
+#endif
+	uint64_t buffer[1 + PERF_EVENTS] {}; // Count of counters, then their values
+	if(::read(m_counters[0].fd, buffer, sizeof(buffer)) != ssize_t(sizeof(buffer))) {
+		std::fill(std::begin(values), std::end(values), 0);
+		return;
+	}
+	std::copy(buffer + 1, std::end(buffer), values);
+}
+
+// Counters
+
+uint64_t vm_stats_t::group(op_group_t group) const noexcept {
+	uint64_t count = 0;
+	for(size_t op = OP_RET; op < OP_FUSED; ++op) {
+		if(op_group[op] == group) {
+			count += ops[op];
+		}
+	}
+	return count;
+}
+
+void vm_stats_t::write_csv(std::ostream& out) const {
+	out << "kind,name,count,commands";
+	for(const char* name : perf_event_name) {
+		out << ',' << name;
+	}
+	out << '\n';
+	for(uint8_t i = 0; i < GROUP_COUNT; ++i) {
+		out << fmt::format("group,{},{},{},0,0,0\n", group_name[i], group(op_group_t(i)), group(op_group_t(i)));
+	}
+	for(size_t op = OP_RET; op < OP_FUSED; ++op) {
+		out << fmt::format("op,{},{},{},0,0,0\n", op_name[op], ops[op], ops[op]);
+	}
+
+	std::vector<std::pair<uint64_t, const block_stats_t*>> sorted;
+	sorted.reserve(blocks.size());
+	for(const auto& [offset, block] : blocks) {
+		sorted.emplace_back(offset, &block);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+		return a.second->commands != b.second->commands ? a.second->commands > b.second->commands : a.first < b.first;
+	});
+	for(const auto& [offset, block] : sorted) {
+		out << fmt::format("block,{:#x},{},{},{},{},{}\n", offset, block->entries, block->commands, block->events[PERF_CYCLES],
+						   block->events[PERF_BRANCH_MISSES], block->events[PERF_CACHE_MISSES]);
+	}
+}
+
+// Counting loop
+
+// One command at a time through asm_inst_t::func like run_trace(), a block ends at the first command not known to fall through
+int VM::run_stats(vm_stats_t& stats, size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return 2;
+	}
+	trap_frame_t frame(m_memory, m_context.bounds);
+	run_state_t	 state(*this, target, frame);
+	if(sigsetjmp(frame.jump, 0)) { // Events of the faulting block are dropped
+		return state.fault();
+	}
+	const asm_inst_t* inst = state.fetch(DAVM_PC(m_context));
+	DA_IF_UNLIKELY(!inst) {
+		return 1;
+	}
+
+	const bool	   perf	 = stats.perf.is_open();
+	block_stats_t* block = nullptr;
+	uint64_t	   start[PERF_EVENTS];
+	auto		   enter = [&](register_t pc) {
+		  block = &stats.blocks[pc - state.origin];
+		  ++block->entries;
+		  if(perf) {
+			  stats.perf.read(start);
+		  }
+	};
+	auto close = [&] {
+		if(perf) {
+			uint64_t now[PERF_EVENTS];
+			stats.perf.read(now);
+			for(size_t i = 0; i < PERF_EVENTS; ++i) {
+				block->events[i] += now[i] - start[i];
+			}
+		}
+	};
+	auto leave = [&](register_t pc, size_t budget, int status) {
+		close();
+		return state.leave(pc, budget, status);
+	};
+
+	enter(DAVM_PC(m_context));
+	for(size_t budget = state.limit;;) {
+		DA_IF_UNLIKELY(budget == 0) {
+			return leave(state.pc_of(inst), budget, 0);
+		}
+		--budget;
+		DA_IF_UNLIKELY(inst->id <= OP_ERROR) {
+			if(inst->id == OP_UNDECODED) {
+				inst = state.decode(inst);
+				DA_IF_UNLIKELY(inst->id == OP_UNDECODED) { // Sentinel, fall off the end
+					return leave(state.pc_of(inst), budget + 1, 1);
+				}
+			}
+			DA_IF_UNLIKELY(inst->id == OP_ERROR) {
+				return leave(state.pc_of(inst + 1), budget + 1, 2);
+			}
+		}
+		const register_t next = state.pc_of(inst + 1);
+		uint8_t			 op	  = inst->op;
+		DA_IF_UNLIKELY(op == OP_GENERIC) { // Irregular commands lose their plain op in the record
+			word_t code;
+			std::memcpy(&code, this->code() + (next - state.origin) - sizeof(word_t), sizeof(code));
+			op = decode_plain(code).op;
+		}
+		++stats.ops[op];
+		++block->commands;
+		DA_IF_UNLIKELY(op == OP_ECALL) {
+			return leave(next, budget, 4);
+		}
+
+		DAVM_PC(m_context) = next;
+		if(is_access(op)) {
+			state.publish(inst, budget + 1);
+		}
+		inst->func(m_context, *inst);
+
+		const register_t pc = DAVM_PC(m_context);
+		DA_IF_LIKELY(pc == next && (is_straight(op) || op == OP_AUIPC)) {
+			++inst;
+			continue;
+		}
+		inst = state.fetch(pc);
+		DA_IF_UNLIKELY(!inst) {
+			return leave(pc, budget, 1);
+		}
+		close();
+		enter(pc);
+	}
+}
+
+END_DA_NAMESPACE
@@ -0,0 +1,105 @@
+/**
+ * @file      stats.h
+ * @brief     Execution counters per command & per block, with optional hardware counters
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_STATS_H_
+#define _DAVM_VM_STATS_H_
+
+#include <vm/pch.h>
+
+#include <ostream>
+#include <unordered_map>
+
+BEGIN_DA_NAMESPACE
+
+// Hardware events counted by perf_counters_t
+enum perf_event_id_t : uint8_t {
+	PERF_CYCLES,
+	PERF_BRANCH_MISSES,
+	PERF_CACHE_MISSES,
+	PERF_EVENTS
+};
+
+DA_MAYBE_UNUSED static constexpr const char* perf_event_name[] = {
+	"cycles",
+	"branch-misses",
+	"cache-misses",
+};
+
+/**
+ * @brief Group of perf_event_open counters of the calling thread, user space only
+ * @note  Read through rdpmc when the kernel allows it, which costs tens of cycles, through read() otherwise
+ */
+class perf_counters_t {
+	struct counter_t {
+		int	  fd   = -1;
+		void* page = nullptr; // perf_event_mmap_page, for rdpmc
+	};
+
+	counter_t m_counters[PERF_EVENTS];
+	bool	  m_rdpmc = false;
+
+public:
+	perf_counters_t() = default;
+	~perf_counters_t();
+
+	perf_counters_t(const perf_counters_t&)			   = delete;
+	perf_counters_t& operator=(const perf_counters_t&) = delete;
+
+	/**
+	 * @brief  Open & start the counters
+	 * @param  error Reason of failure, e.g. no PMU or perf_event_paranoid too high
+	 * @return Whether every counter is opened
+	 */
+	bool open(std::string& error);
+
+	void close() noexcept;
+
+	bool is_open() const noexcept {
+		return m_counters[0].fd >= 0;
+	}
+
+	// Current values of all counters into @param values
+	void read(uint64_t (&values)[PERF_EVENTS]) const noexcept;
+};
+
+// Counters of a block, from an entry until the next command that may leave the fall through
+struct block_stats_t {
+	uint64_t entries;
+	uint64_t commands;
+	uint64_t events[PERF_EVENTS]; // Deltas of perf_counters_t over the block, including the counting
+};
+
+/**
+ * @brief Filled by VM::run_stats(), commands are named as in common/reflect.h
+ */
+struct vm_stats_t {
+	uint64_t								  ops[OP_FUSED] {}; // Per plain op_t, fused commands count their parts
+	std::unordered_map<uint64_t, block_stats_t> blocks; // Per offset of the entry in the code
+	perf_counters_t							  perf; // Attributed to blocks while open
+
+	// Commands of @param group executed
+	uint64_t group(op_group_t group) const noexcept;
+
+	void clear() noexcept {
+		std::fill(std::begin(ops), std::end(ops), 0);
+		blocks.clear();
+	}
+
+	/**
+	 * @brief Write the counters as CSV `kind,name,count,commands,cycles,branch-misses,cache-misses`
+	 *        - `group` rows are named as group_name, `op` rows as op_name, both count commands
+	 *        - `block` rows are named by the offset of their entry in hexadecimal, count entries,
+	 *          then commands & events, which stay 0 unless perf is open, sorted by commands
+	 */
+	void write_csv(std::ostream& out) const;
+};
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_STATS_H_
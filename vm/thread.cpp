@@ -0,0 +1,242 @@
+/**
+ * @file      thread.cpp
+ * @brief     Implemention of guest threads
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/thread.h>
+#include <vm/vm.h>
+
+#if DAVM_THREADS
+
+	#include <cerrno>
+	#include <climits>
+	#include <exception>
+	#include <linux/futex.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <utility>
+
+BEGIN_DA_NAMESPACE
+
+static long futex(register_t word, int op, uint32_t value, const timespec* timeout) noexcept {
+	return syscall(SYS_futex, DAVM_CAST(uint32_t*, word), op, value, timeout, nullptr, 0);
+}
+
+// 0 if @param word may be a futex word of @param vm, -errno otherwise
+static sregister_t check_word(const VM& vm, register_t word) noexcept {
+	const memory_t& memory = vm.memory();
+	DA_IF_UNLIKELY(word & (sizeof(uint32_t) - 1)) {
+		return -EINVAL;
+	}
+	DA_IF_UNLIKELY(word - DAVM_CAST(register_t, memory.begin()) >= memory.size()) {
+		return -EFAULT;
+	}
+	return 0;
+}
+
+// Serve the ECALL of @param vm, then come back to @param loop, so that a service resumed elsewhere ends on the thread of @param vm
+static vm_task_t<void> serve(const vm_services_t& services, VM& vm, vm_loop_t& loop) {
+	std::exception_ptr error;
+	try {
+		co_await services(vm);
+	} catch(...) {
+		error = std::current_exception();
+	}
+	co_await vm_yield_t { loop };
+	if(error) {
+		std::rethrow_exception(error);
+	}
+}
+
+vm_threads_t::vm_threads_t(VM& main, size_t stack)
+	: m_main(main)
+	, m_stack(std::max((stack + VM_PAGE_SIZE - 1) & ~(VM_PAGE_SIZE - 1), VM_PAGE_SIZE)) {
+	size_t reserved = 0; // .data & .bss
+	if(const image_t* image = main.image()) {
+		reserved = image->section_size(IMAGE_DATA) + image->header().bss;
+	}
+	const size_t heap = std::as_const(main).memory().heap_size();
+	m_slots			  = reserved < heap ? (heap - reserved) / (m_stack + VM_PAGE_SIZE) : 0;
+}
+
+// Threads joining others are joined here, so that each thread is joined exactly once
+vm_threads_t::~vm_threads_t() {
+	stop();
+	for(;;) {
+		thread_t* thread = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for(const auto& candidate : m_threads) {
+				if(candidate && !candidate->joining) {
+					thread			= candidate.get();
+					thread->joining = true;
+					break;
+				}
+			}
+		}
+		if(!thread) {
+			break;
+		}
+		thread->host.join();
+	}
+	for(size_t slot = 0; slot < m_carved; ++slot) {
+		mprotect(DAVM_CAST(void*, stack_top(slot) - m_stack - VM_PAGE_SIZE), VM_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	}
+}
+
+void vm_threads_t::install(vm_services_t& services) {
+	m_services = &services;
+	services.add(VM_SERVICE_THREAD_SPAWN, [this](VM& vm) { return thread_spawn(vm); });
+	services.add(VM_SERVICE_THREAD_JOIN, [this](VM& vm) { return thread_join(vm); });
+	services.add(VM_SERVICE_FUTEX_WAIT, [this](VM& vm) { return futex_wait(vm); });
+	services.add(VM_SERVICE_FUTEX_WAKE, [this](VM& vm) { return futex_wake(vm); });
+}
+
+register_t vm_threads_t::stack_top(size_t slot) const noexcept {
+	const memory_t& memory = std::as_const(m_main).memory();
+	return DAVM_CAST(register_t, memory.data() + memory.heap_size() - slot * (m_stack + VM_PAGE_SIZE));
+}
+
+sregister_t vm_threads_t::start(VM& parent, register_t entry, register_t arg) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t						slot;
+	if(!m_free.empty()) {
+		slot = m_free.back();
+		m_free.pop_back();
+	} else {
+		DA_IF_UNLIKELY(m_carved == m_slots) {
+			return -EAGAIN;
+		}
+		DA_IF_UNLIKELY(mprotect(DAVM_CAST(void*, stack_top(m_carved) - m_stack - VM_PAGE_SIZE), VM_PAGE_SIZE, PROT_NONE)) {
+			return -ENOMEM;
+		}
+		slot = m_carved++;
+	}
+
+	const register_t id = m_threads.size() + 1;
+	try {
+		auto thread	 = std::make_unique<thread_t>();
+		thread->slot = slot;
+		thread->vm	 = parent.spawn(entry, stack_top(slot));
+
+		vm_context_t& context = thread->vm->context();
+		context.x[8]		  = arg;
+		DAVM_TP(context)	  = id;
+		m_threads.push_back(std::move(thread));
+		thread_t& ref = *m_threads.back();
+		try {
+			ref.host = std::thread(&vm_threads_t::run, this, std::ref(ref));
+		} catch(...) {
+			m_threads.pop_back();
+			throw;
+		}
+	} catch(...) { // std::bad_alloc or std::system_error
+		m_free.push_back(slot);
+		return -ENOMEM;
+	}
+	return sregister_t(id);
+}
+
+sregister_t vm_threads_t::join(register_t id) {
+	thread_t* thread;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		DA_IF_UNLIKELY(id - 1 >= m_threads.size() || !m_threads[id - 1] || m_threads[id - 1]->joining) {
+			return -ESRCH;
+		}
+		thread = m_threads[id - 1].get();
+		DA_IF_UNLIKELY(thread->host.get_id() == std::this_thread::get_id()) {
+			return -EDEADLK;
+		}
+		thread->joining = true;
+	}
+	thread->host.join();
+	const sregister_t ret = thread->status == 1 ? sregister_t(DAVM_RV(thread->vm->context())) : -ECANCELED;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_free.push_back(thread->slot);
+	m_threads[id - 1].reset();
+	return ret;
+}
+
+// Like VM::run_async() with the services, but checking stop() between slices
+void vm_threads_t::run(thread_t& thread) {
+	VM&		  vm = *thread.vm;
+	vm_loop_t loop;
+	int		  status;
+	while(((status = vm.run(VM_THREAD_SLICE)) == 0 || status == 4) && !m_stop.load(std::memory_order_relaxed)) {
+		if(status == 0) {
+			continue;
+		}
+		DA_IF_UNLIKELY(!m_services) {
+			DAVM_RV(vm.context()) = register_t(-ENOSYS);
+			continue;
+		}
+		const register_t service = DAVM_RV(vm.context());
+		vm_task_t<void>	 task	 = serve(*m_services, vm, loop);
+		task.start();
+		while(!loop.run()) {
+			std::this_thread::yield();
+		}
+		try {
+			task.result();
+		} catch(...) { // Stop the thread as an invalid command would, what() would die before the logger formats it
+			DAVM_LOG_ERROR("Host service {} threw on guest thread {}", service, DAVM_TP(vm.context()));
+			status = 2;
+			break;
+		}
+	}
+	thread.status = status;
+}
+
+vm_task_t<void> vm_threads_t::thread_spawn(VM& vm) {
+	vm_context_t& context = vm.context();
+	DAVM_RV(context)	  = register_t(start(vm, context.x[8], context.x[9]));
+	co_return;
+}
+
+vm_task_t<void> vm_threads_t::thread_join(VM& vm) {
+	vm_context_t& context = vm.context();
+	DAVM_RV(context)	  = register_t(join(context.x[8]));
+	co_return;
+}
+
+// Sleeps VM_THREAD_POLL at a time, so that stop() is seen
+vm_task_t<void> vm_threads_t::futex_wait(VM& vm) {
+	constexpr timespec poll = { 0, VM_THREAD_POLL };
+
+	vm_context_t&	 context = vm.context();
+	const register_t word	 = context.x[8];
+	sregister_t		 ret	 = check_word(vm, word);
+	while(ret == 0 && futex(word, FUTEX_WAIT_PRIVATE, uint32_t(context.x[9]), &poll)) {
+		DA_IF_UNLIKELY(errno != ETIMEDOUT && errno != EINTR) {
+			ret = -errno; // EAGAIN if the word differs
+		} else if(m_stop.load(std::memory_order_relaxed)) {
+			ret = -EINTR;
+		}
+	}
+	DAVM_RV(context) = register_t(ret);
+	co_return;
+}
+
+vm_task_t<void> vm_threads_t::futex_wake(VM& vm) {
+	vm_context_t&	 context = vm.context();
+	const register_t word	 = context.x[8];
+	sregister_t		 ret	 = check_word(vm, word);
+	if(ret == 0) {
+		const long woken = futex(word, FUTEX_WAKE_PRIVATE, uint32_t(std::min<register_t>(context.x[9], INT_MAX)), nullptr);
+		ret				 = woken < 0 ? -errno : woken;
+	}
+	DAVM_RV(context) = register_t(ret);
+	co_return;
+}
+
+END_DA_NAMESPACE
+
+#endif // DAVM_THREADS
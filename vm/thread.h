@@ -0,0 +1,132 @@
+/**
+ * @file      thread.h
+ * @brief     Guest threads running concurrently on host threads over one shared memory
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_THREAD_H_
+#define _DAVM_VM_THREAD_H_
+
+#include <vm/pch.h>
+#include <vm/async.h>
+
+#if DAVM_ASYNC && defined(__linux__)
+	#define DAVM_THREADS 1
+#else
+	#define DAVM_THREADS 0
+#endif
+
+#if DAVM_THREADS
+	#include <atomic>
+	#include <mutex>
+	#include <thread>
+
+BEGIN_DA_NAMESPACE
+
+class VM;
+
+// Services installed by vm_threads_t::install(), rv is -errno on failure
+inline constexpr register_t VM_SERVICE_THREAD_SPAWN = 3; // x8 = entry, x9 = argument, rv = thread id
+inline constexpr register_t VM_SERVICE_THREAD_JOIN	= 4; // x8 = thread id, rv = rv of the thread when it halted
+inline constexpr register_t VM_SERVICE_FUTEX_WAIT	= 5; // x8 = aligned word, x9 = expected value, rv = 0 once woken, -EAGAIN if the word differs
+inline constexpr register_t VM_SERVICE_FUTEX_WAKE	= 6; // x8 = aligned word, x9 = waiters to wake at most, rv = waiters woken
+
+inline constexpr size_t VM_THREAD_STACK = 256 * 1024; // Default stack of a guest thread
+inline constexpr size_t VM_THREAD_SLICE = 100000; // Commands run between checks of vm_threads_t::stop()
+inline constexpr long	VM_THREAD_POLL	= 100 * 1000 * 1000; // Nanoseconds a futex wait sleeps between checks of stop()
+
+/**
+ * @brief Guest threads of one VM, each a VM::spawn() of its creator run by its own host thread
+ *
+ * A thread starts at its entry with the argument in x8 & tp set to its id, the main VM being thread 0.
+ * It halts when its entry returns, its rv is then the result of joining it.
+ * Threads synchronize through the atomic commands, see common/atomic.h, & wait for each other through futex words,
+ * 32-bit words in guest memory which VM_SERVICE_FUTEX_WAIT sleeps on while they hold the expected value.
+ * Waits may return spuriously, as futex(2) does, so guests check the word again.
+ *
+ * Stacks are carved from the top of the heap downward, each above a guard page, & reused once their thread is joined.
+ * The guest keeps its own data below them, .data & .bss of an image are never given away.
+ * @note Services block the host thread of the calling VM, those of @ref install run on every thread so must be thread safe
+ */
+class vm_threads_t {
+	struct thread_t {
+		std::unique_ptr<VM> vm;
+		std::thread			host;
+		size_t				slot; // Index of the stack
+		int					status	= 0; // Last status of VM::run(), written by the host thread
+		bool				joining = false;
+	};
+
+	VM&									   m_main;
+	const vm_services_t*				   m_services = nullptr; // Served to threads, nullptr until install()
+	size_t								   m_stack; // Bytes of each stack
+	size_t								   m_slots; // Stacks fitting the heap
+	std::mutex							   m_mutex; // Guards the members below
+	std::vector<std::unique_ptr<thread_t>> m_threads; // By id - 1, nullptr once joined
+	std::vector<size_t>					   m_free; // Stacks of joined threads
+	size_t								   m_carved = 0; // Stacks below a guard page so far
+	std::atomic_bool					   m_stop { false };
+
+public:
+	/**
+	 * @param main  VM the threads share the memory of, loaded before & outliving them
+	 * @param stack Bytes of each stack, rounded up to pages
+	 */
+	explicit vm_threads_t(VM& main, size_t stack = VM_THREAD_STACK);
+
+	// Stop & join every thread, then give the guard pages back to the heap
+	~vm_threads_t();
+
+	vm_threads_t(const vm_threads_t&)			 = delete;
+	vm_threads_t& operator=(const vm_threads_t&) = delete;
+
+	/**
+	 * @brief Add the thread & futex services to @param services
+	 * @note  Threads serve ECALL through @param services, which must live as long as this
+	 */
+	void install(vm_services_t& services);
+
+	/**
+	 * @brief  Start a thread of the main VM, as VM_SERVICE_THREAD_SPAWN does
+	 * @return Its id, -EAGAIN if no stack is left, -ENOMEM if the VM or the host thread cannot be created
+	 */
+	sregister_t spawn(register_t entry, register_t arg) {
+		return start(m_main, entry, arg);
+	}
+
+	/**
+	 * @brief  Wait for thread @param id to halt & release it, as VM_SERVICE_THREAD_JOIN does
+	 * @return Its rv, -ESRCH if there is no such thread or it is being joined, -EDEADLK if it is the caller,
+	 *         -ECANCELED if it stopped otherwise than by halting, see VM::run()
+	 */
+	sregister_t join(register_t id);
+
+	// Make every thread stop after its current slice or futex wait, joining them then gives -ECANCELED
+	void stop() noexcept {
+		m_stop = true;
+	}
+
+private:
+	// Start a thread of @param parent, which may be a thread itself
+	sregister_t start(VM& parent, register_t entry, register_t arg);
+
+	// Top of stack @param slot, the guard page lies below its bottom
+	register_t stack_top(size_t slot) const noexcept;
+
+	// Body of the host thread of @param thread
+	void run(thread_t& thread);
+
+	vm_task_t<void> thread_spawn(VM& vm);
+	vm_task_t<void> thread_join(VM& vm);
+	vm_task_t<void> futex_wait(VM& vm);
+	vm_task_t<void> futex_wake(VM& vm);
+};
+
+END_DA_NAMESPACE
+
+#endif // DAVM_THREADS
+
+#endif // _DAVM_VM_THREAD_H_
@@ -0,0 +1,309 @@
+/**
+ * @file      trace.cpp
+ * @brief     Implemention of traces
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/trace.h>
+#include <vm/run.h>
+#include <vm/vm.h>
+
+#if DAVM_TRACE
+
+	#include <zlib.h>
+
+BEGIN_DA_NAMESPACE
+
+// Writer
+
+trace_writer_t::~trace_writer_t() {
+	close();
+}
+
+bool trace_writer_t::open(const std::string& filename, VM& vm) {
+	close();
+	gzFile file = gzopen(filename.c_str(), "wb1"); // Fastest level, traces are highly redundant anyway
+	if(!file) {
+		return false;
+	}
+	gzbuffer(file, TRACE_BLOCK);
+	const trace_header_t header = { TRACE_MAGIC, TRACE_VERSION, 0, vm.code_size(), DAVM_CAST(uint64_t, vm.memory().data()) };
+	if(gzwrite(file, &header, sizeof(header)) != int(sizeof(header))
+	   || (header.code_size && gzwrite(file, vm.code(), unsigned(header.code_size)) != int(header.code_size))) {
+		gzclose(file);
+		return false;
+	}
+
+	m_file = file;
+	if(!m_blocks) {
+		m_blocks = std::make_unique<block_t[]>(TRACE_BLOCKS);
+	}
+	m_queued = m_written = 0;
+	m_closing = m_failed = false;
+	m_cursor			 = m_blocks[0].data;
+	m_limit				 = m_cursor + TRACE_BLOCK - TRACE_EVENT;
+	m_count				 = 0;
+	m_address			 = header.memory;
+	m_thread			 = std::thread([this] { run(); });
+	return true;
+}
+
+bool trace_writer_t::close() {
+	if(!m_file) {
+		return true;
+	}
+	submit();
+	{
+		std::lock_guard lock(m_mutex);
+		m_closing = true;
+	}
+	m_ready.notify_one();
+	m_thread.join();
+	const bool ok = gzclose(gzFile(m_file)) == Z_OK && !m_failed;
+	m_file		  = nullptr;
+	return ok;
+}
+
+// Hand the block being filled over & wait for a free one
+void trace_writer_t::submit() noexcept {
+	block_t& block = m_blocks[m_queued % TRACE_BLOCKS];
+	block.size	   = size_t(m_cursor - block.data);
+	std::unique_lock lock(m_mutex);
+	++m_queued;
+	m_ready.notify_one();
+	m_free.wait(lock, [this] { return m_queued - m_written < TRACE_BLOCKS; });
+	m_cursor = m_blocks[m_queued % TRACE_BLOCKS].data;
+	m_limit	 = m_cursor + TRACE_BLOCK - TRACE_EVENT;
+}
+
+void trace_writer_t::run() {
+	std::unique_lock lock(m_mutex);
+	for(;;) {
+		m_ready.wait(lock, [this] { return m_written < m_queued || m_closing; });
+		if(m_written == m_queued) { // Closing with everything written
+			return;
+		}
+		const block_t& block = m_blocks[m_written % TRACE_BLOCKS];
+		lock.unlock();
+		const bool ok = !block.size || gzwrite(gzFile(m_file), block.data, unsigned(block.size)) == int(block.size);
+		lock.lock();
+		m_failed |= !ok;
+		++m_written;
+		m_free.notify_one();
+	}
+}
+
+// Reader
+
+trace_reader_t::~trace_reader_t() {
+	if(m_file) {
+		gzclose(gzFile(m_file));
+	}
+}
+
+bool trace_reader_t::open(const std::string& filename, std::string& error) {
+	if(m_file) {
+		gzclose(gzFile(m_file));
+	}
+	m_file = gzopen(filename.c_str(), "rb");
+	if(!m_file) {
+		error = fmt::format("Cannot open {}", filename);
+		return false;
+	}
+	gzbuffer(gzFile(m_file), TRACE_BLOCK);
+	if(gzread(gzFile(m_file), &m_header, sizeof(m_header)) != int(sizeof(m_header)) || m_header.magic != TRACE_MAGIC
+	   || m_header.version != TRACE_VERSION) {
+		error = "Bad magic or unsupported version";
+		return false;
+	}
+	m_code.resize(m_header.code_size);
+	if(!m_code.empty() && gzread(gzFile(m_file), m_code.data(), unsigned(m_code.size())) != int(m_code.size())) {
+		error = "Truncated code";
+		return false;
+	}
+	m_buffer.clear();
+	m_pos	  = 0;
+	m_left	  = 0;
+	m_kind	  = TRACE_STOP;
+	m_address = m_header.memory;
+	m_status  = -1;
+	return true;
+}
+
+// Read more events, keeping those not parsed yet
+bool trace_reader_t::fill() {
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + ptrdiff_t(m_pos));
+	m_pos			  = 0;
+	const size_t size = m_buffer.size();
+	m_buffer.resize(size + TRACE_BLOCK);
+	const int read = gzread(gzFile(m_file), m_buffer.data() + size, unsigned(TRACE_BLOCK));
+	m_buffer.resize(size + size_t(std::max(read, 0)));
+	return read > 0;
+}
+
+bool trace_reader_t::get(uint64_t& value) {
+	value = 0;
+	for(unsigned shift = 0; shift < DWORD_BITS; shift += 7) {
+		DA_IF_UNLIKELY(m_pos == m_buffer.size() && !fill()) {
+			return false;
+		}
+		const byte_t b = m_buffer[m_pos++];
+		value |= uint64_t(b & 0x7F) << shift;
+		if(!(b & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool trace_reader_t::next(trace_step_t& step) {
+	auto unzigzag = [](uint64_t value) { return value >> 1 ^ (0 - (value & 1)); };
+	while(!m_left) {
+		uint64_t head;
+		if(!m_file || !get(head)) {
+			return false;
+		}
+		m_kind = trace_kind_t(head & 0b111);
+		m_left = head >> 3;
+		if(!get(m_values[0]) || (m_kind == TRACE_ACCESS_JUMP && !get(m_values[1]))) {
+			return false;
+		}
+		if(m_kind == TRACE_START) {
+			m_offset = m_values[0];
+			m_status = -1;
+		} else if(m_kind == TRACE_STOP) {
+			m_status = int(m_values[0]);
+		}
+	}
+
+	step = { m_offset, 0, false, false, false, 0, 0 };
+	if(m_offset + sizeof(word_t) <= m_code.size()) {
+		std::memcpy(&step.code, m_code.data() + m_offset, sizeof(word_t));
+	}
+	m_offset += sizeof(word_t);
+	DA_IF_LIKELY(--m_left || m_kind == TRACE_STOP) { // In sequence
+		return true;
+	}
+	switch(m_kind) {
+	case TRACE_ACCESS_JUMP:
+		step.jumped = true;
+		step.target = m_offset += unzigzag(m_values[1]);
+		[[fallthrough]];
+	case TRACE_ACCESS:
+	case TRACE_FAULT:
+		step.access = true;
+		step.fault	= m_kind == TRACE_FAULT;
+		step.address = m_address += unzigzag(m_values[0]);
+		break;
+	case TRACE_JUMP:
+		step.jumped = true;
+		step.target = m_offset += unzigzag(m_values[0]);
+		break;
+	default:
+		break;
+	}
+	if(step.fault) {
+		m_offset -= sizeof(word_t);
+	}
+	return true;
+}
+
+// Tracing loop
+
+// Address accessed by @param inst of plain @param op, see the asm functions
+static register_t trace_address(const vm_context_t& context, const asm_inst_t& inst, uint8_t op) noexcept {
+	if((op >= OP_LB && op <= OP_LWU) || op == OP_VLD || op == OP_VST || (op >= OP_FLW && op <= OP_FSD)) {
+		return context.x[inst.ra] + register_t(inst.imm);
+	} else if((op >= OP_SB && op <= OP_SD) || op == OP_MCPY || op == OP_MSET) {
+		return context.x[inst.rd];
+	} else if(op >= OP_MCMP && op <= OP_AMOCASD) {
+		return context.x[inst.ra];
+	}
+	switch(op) {
+	case OP_PUSH: return DAVM_SP(context) - sizeof(register_t);
+	case OP_POP: return DAVM_SP(context);
+	case OP_CALL: return DAVM_SP(context) - sizeof(register_t) * 2;
+	default: return DAVM_BP(context); // OP_RET
+	}
+}
+
+// One command at a time through asm_inst_t::func, like one_step(), ignoring fusion so that every command is seen
+int VM::run_trace(trace_writer_t& trace, size_t target) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		return trace.stop(2);
+	}
+	trap_frame_t frame(m_memory, m_context.bounds);
+	run_state_t	 state(*this, target, frame);
+	if(sigsetjmp(frame.jump, 0)) {
+		trace.fault();
+		return trace.stop(state.fault());
+	}
+	const asm_inst_t* inst = state.fetch(DAVM_PC(m_context));
+	DA_IF_UNLIKELY(!inst) {
+		return trace.stop(1);
+	}
+	trace.start(DAVM_PC(m_context) - state.origin);
+	for(size_t budget = state.limit;;) {
+		DA_IF_UNLIKELY(budget == 0) {
+			return trace.stop(state.leave(state.pc_of(inst), budget, 0));
+		}
+		--budget;
+		DA_IF_UNLIKELY(inst->id <= OP_ERROR) {
+			if(inst->id == OP_UNDECODED) {
+				inst = state.decode(inst);
+				DA_IF_UNLIKELY(inst->id == OP_UNDECODED) { // Sentinel, fall off the end
+					return trace.stop(state.leave(state.pc_of(inst), budget + 1, 1));
+				}
+			}
+			DA_IF_UNLIKELY(inst->id == OP_ERROR) {
+				return trace.stop(state.leave(state.pc_of(inst + 1), budget + 1, 2));
+			}
+		}
+		const register_t next = state.pc_of(inst + 1);
+		trace.step();
+		DA_IF_UNLIKELY(inst->op == OP_ECALL) {
+			return trace.stop(state.leave(next, budget, 4));
+		}
+
+		// Irregular commands lose their plain op in the record
+		asm_inst_t plain = *inst;
+		DA_IF_UNLIKELY(inst->op == OP_GENERIC) {
+			word_t code;
+			std::memcpy(&code, this->code() + (next - state.origin) - sizeof(word_t), sizeof(code));
+			plain = decode_plain(code);
+		}
+		DAVM_PC(m_context) = next;
+		const bool access  = is_access(plain.op);
+		if(access) {
+			trace.pending(trace_address(m_context, plain, plain.op));
+			state.publish(inst, budget + 1);
+		}
+		inst->func(m_context, *inst);
+
+		const register_t pc = DAVM_PC(m_context);
+		DA_IF_LIKELY(pc == next) {
+			if(access) {
+				trace.access(false, 0);
+			}
+			++inst;
+			continue;
+		}
+		if(access) {
+			trace.access(true, pc - next);
+		} else {
+			trace.jump(pc - next);
+		}
+		inst = state.fetch(pc);
+		DA_IF_UNLIKELY(!inst) {
+			return trace.stop(state.leave(pc, budget, 1));
+		}
+	}
+}
+
+END_DA_NAMESPACE
+
+#endif // DAVM_TRACE
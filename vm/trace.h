@@ -0,0 +1,247 @@
+/**
+ * @file      trace.h
+ * @brief     Compressed binary traces of executed commands
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_TRACE_H_
+#define _DAVM_VM_TRACE_H_
+
+#include <vm/pch.h>
+
+// Enabled by CMake if zlib is found, disable it with -DDAVM_TRACE=OFF
+#ifndef DAVM_TRACE
+	#define DAVM_TRACE 0
+#endif
+
+#if DAVM_TRACE
+
+	#include <condition_variable>
+	#include <mutex>
+	#include <thread>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr uint32_t TRACE_MAGIC	= 0x52544144; // "DATR" in little endian
+inline constexpr uint16_t TRACE_VERSION = 1;
+inline constexpr size_t	  TRACE_BLOCK	= 256 * 1024; // Bytes of events handed to the compressor at once
+inline constexpr size_t	  TRACE_BLOCKS	= 4; // Blocks of a writer, the VM waits for the compressor if all are full
+inline constexpr size_t	  TRACE_EVENT	= 32; // Longest event
+
+class VM;
+
+/**
+ * @brief Events of a trace, each written as a varint (count << 3 | kind) & the varints of its values
+ *
+ * Count is the commands executed since the previous event, including the one the event is about,
+ * all others ran in sequence, so that the sequence of pc is known without an event per command.
+ * Deltas are zigzag encoded.
+ */
+enum trace_kind_t : uint8_t {
+	TRACE_JUMP, // Control left the fall through, value: target - fall through
+	TRACE_ACCESS, // Memory accessed, value: address - previous address, the base of memory at first
+	TRACE_ACCESS_JUMP, // Both, values: address delta, target delta
+	TRACE_FAULT, // Memory access faulted, the command did not complete, value: address delta
+	TRACE_START, // run_trace() started, count 0, value: offset of pc in the code
+	TRACE_STOP, // run_trace() returned, count excludes the command stopped at, value: status
+};
+
+/**
+ * @brief Gzip file made of a header, the code traced & the events
+ *
+ * All fields are little endian.
+ */
+struct trace_header_t {
+	uint32_t magic; // TRACE_MAGIC
+	uint16_t version; // TRACE_VERSION
+	uint16_t flags; // Reserved, 0
+	uint64_t code_size; // Bytes of code following the header
+	uint64_t memory; // Address of guest memory while traced
+};
+
+/**
+ * @brief Collects the events of one VM into blocks, compressed & written by a thread of its own
+ * @note  The code must not change while traced, only one VM may use a writer at a time
+ */
+class trace_writer_t {
+	struct block_t {
+		byte_t data[TRACE_BLOCK];
+		size_t size;
+	};
+
+	std::unique_ptr<block_t[]> m_blocks;
+	byte_t*					   m_cursor = nullptr; // In the block being filled
+	byte_t*					   m_limit	= nullptr; // Where the block is handed over
+	uint64_t				   m_count	= 0; // Commands since the last event
+	uint64_t				   m_address = 0; // Of the last access
+	uint64_t				   m_pending = 0; // Address of the access being executed
+
+	void*					m_file = nullptr; // gzFile
+	std::thread				m_thread;
+	std::mutex				m_mutex;
+	std::condition_variable m_ready; // A block is queued or the writer closes
+	std::condition_variable m_free; // A block is written
+	size_t					m_queued  = 0; // Blocks handed over so far
+	size_t					m_written = 0; // Blocks written so far
+	bool					m_closing = false;
+	bool					m_failed  = false;
+
+	static byte_t* put(byte_t* out, uint64_t value) noexcept {
+		while(value >= 0x80) {
+			*out++ = byte_t(value | 0x80);
+			value >>= 7;
+		}
+		*out++ = byte_t(value);
+		return out;
+	}
+
+	static uint64_t zigzag(uint64_t delta) noexcept {
+		return delta << 1 ^ uint64_t(sregister_t(delta) >> 63);
+	}
+
+	void event(trace_kind_t kind, uint64_t value) noexcept {
+		DA_IF_UNLIKELY(m_cursor >= m_limit) {
+			submit();
+		}
+		m_cursor = put(m_cursor, m_count << 3 | kind);
+		m_cursor = put(m_cursor, value);
+		m_count	 = 0;
+	}
+
+	void submit() noexcept;
+	void run();
+
+public:
+	trace_writer_t() = default;
+	~trace_writer_t();
+
+	trace_writer_t(const trace_writer_t&)			 = delete;
+	trace_writer_t& operator=(const trace_writer_t&) = delete;
+
+	/**
+	 * @brief  Create @param filename & write the header & the code of @param vm
+	 * @return Whether the file is created
+	 */
+	bool open(const std::string& filename, VM& vm);
+
+	/**
+	 * @brief  Write out every event & close the file
+	 * @return Whether everything is written
+	 */
+	bool close();
+
+	bool is_open() const noexcept {
+		return m_file;
+	}
+
+public: // Called by VM::run_trace()
+	void start(uint64_t offset) noexcept {
+		event(TRACE_START, offset);
+	}
+
+	int stop(int status) noexcept {
+		event(TRACE_STOP, uint64_t(status));
+		return status;
+	}
+
+	void step() noexcept {
+		++m_count;
+	}
+
+	// Before a command accessing @param address
+	void pending(uint64_t address) noexcept {
+		m_pending = address;
+	}
+
+	// After the command accessing memory, @param jumped with @param delta from the fall through or not
+	void access(bool jumped, uint64_t delta) noexcept {
+		const uint64_t address = zigzag(m_pending - m_address);
+		m_address			   = m_pending;
+		if(!jumped) {
+			return event(TRACE_ACCESS, address);
+		}
+		event(TRACE_ACCESS_JUMP, address);
+		m_cursor = put(m_cursor, zigzag(delta));
+	}
+
+	void jump(uint64_t delta) noexcept {
+		event(TRACE_JUMP, zigzag(delta));
+	}
+
+	void fault() noexcept {
+		event(TRACE_FAULT, zigzag(m_pending - m_address));
+		m_address = m_pending;
+	}
+};
+
+// Command executed, as replayed by trace_reader_t
+struct trace_step_t {
+	uint64_t offset; // Of the command in the code
+	word_t	 code;
+	bool	 access; // Whether it accessed memory
+	bool	 jumped; // Whether control left the fall through after it
+	bool	 fault; // Whether its access faulted, so that it did not complete
+	uint64_t address; // Accessed, if access
+	uint64_t target; // Offset of the next command, if jumped
+};
+
+/**
+ * @brief Replays a trace command by command
+ */
+class trace_reader_t {
+	void*				m_file = nullptr; // gzFile
+	trace_header_t		m_header {};
+	std::vector<byte_t> m_code;
+	std::vector<byte_t> m_buffer; // Decompressed events not parsed yet
+	size_t				m_pos	 = 0;
+	uint64_t			m_offset = 0; // Of the next command
+	uint64_t			m_left	 = 0; // Commands of the current event left
+	trace_kind_t		m_kind	 = TRACE_STOP;
+	uint64_t			m_values[2] {};
+	uint64_t			m_address = 0;
+	int					m_status  = -1;
+
+	bool fill();
+	bool get(uint64_t& value);
+
+public:
+	trace_reader_t() = default;
+	~trace_reader_t();
+
+	trace_reader_t(const trace_reader_t&)			 = delete;
+	trace_reader_t& operator=(const trace_reader_t&) = delete;
+
+	/**
+	 * @brief  Open the trace @param filename & read its header & code
+	 * @param  error Reason of rejection
+	 */
+	bool open(const std::string& filename, std::string& error);
+
+	/**
+	 * @brief  Replay the next command
+	 * @return Whether there is one, false at the end of the trace
+	 */
+	bool next(trace_step_t& step);
+
+	const trace_header_t& header() const noexcept {
+		return m_header;
+	}
+
+	const std::vector<byte_t>& code() const noexcept {
+		return m_code;
+	}
+
+	// Status returned by the last run_trace() replayed, -1 while it runs
+	int status() const noexcept {
+		return m_status;
+	}
+};
+
+END_DA_NAMESPACE
+
+#endif // DAVM_TRACE
+
+#endif // _DAVM_VM_TRACE_H_
@@ -0,0 +1,124 @@
+/**
+ * @file      verify.cpp
+ * @brief     Implemention of the byte code verifier
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#include <vm/pch.h>
+#include <vm/verify.h>
+#include <vm/vm.h>
+
+BEGIN_DA_NAMESPACE
+
+inline bool is_direct_jump(const asm_inst_t& inst) noexcept {
+	return inst.op == OP_JAL || (inst.op >= OP_BEQ && inst.op <= OP_BGEU);
+}
+
+// Whether the next command may be executed after @param inst, CALL does when the callee returns
+inline bool falls_through(const asm_inst_t& inst) noexcept {
+	return inst.op != OP_JAL && inst.op != OP_JALR && inst.op != OP_RET && inst.op != OP_HLT;
+}
+
+// Whether @param inst may leave the straight line
+inline bool ends_block(const asm_inst_t& inst) noexcept {
+	return is_direct_jump(inst) || !falls_through(inst) || inst.op == OP_CALL || is_irregular(inst);
+}
+
+bool verify_program(const byte_t* program, size_t size, cfg_t& cfg, std::string& error) {
+	cfg.clear();
+	DA_IF_UNLIKELY(size % sizeof(word_t)) {
+		error = fmt::format("Program size {:#x} is not a multiple of command size", size);
+		return false;
+	}
+	const size_t count = size / sizeof(word_t);
+	DA_IF_UNLIKELY(count >= CFG_NONE) {
+		error = fmt::format("Program size {:#x} is too large", size);
+		return false;
+	}
+	if(count == 0) {
+		return true;
+	}
+
+	// First pass: decode & find the leaders
+	std::vector<asm_inst_t> insts(count);
+	std::vector<uint32_t>	block_of(count + 1); // Block id + 1 of leaders, 0 for others
+	block_of[0] = 1;
+	for(size_t i = 0; i < count; ++i) {
+		word_t code;
+		std::memcpy(&code, program + i * sizeof(word_t), sizeof(word_t));
+		const asm_inst_t& inst = insts[i] = decode_plain(code);
+		DA_IF_UNLIKELY(inst.id == OP_ERROR) {
+			error = fmt::format("Invalid command {:#010X} at {:#x}", code, i * sizeof(word_t));
+			return false;
+		}
+		if(is_direct_jump(inst)) {
+			DA_IF_UNLIKELY(inst.imm & (sizeof(word_t) - 1)) {
+				error = fmt::format("Unaligned jump offset {} at {:#x}", inst.imm, i * sizeof(word_t));
+				return false;
+			}
+			const size_t target = i + 1 + size_t(inst.imm / sregister_t(sizeof(word_t)));
+			DA_IF_UNLIKELY(target >= count) {
+				error = fmt::format("Jump target {:#x} at {:#x} is outside program", sregister_t((i + 1) * sizeof(word_t)) + inst.imm, i * sizeof(word_t));
+				return false;
+			}
+			block_of[target] = 1;
+		}
+		if(ends_block(inst)) {
+			block_of[i + 1] = 1;
+		}
+	}
+	DA_IF_UNLIKELY(falls_through(insts[count - 1])) {
+		error = fmt::format("Last command at {:#x} falls through the end of program", (count - 1) * sizeof(word_t));
+		return false;
+	}
+
+	// Second pass: number the blocks & link them
+	for(size_t i = 0; i < count; ++i) {
+		if(block_of[i]) {
+			cfg.push_back({ uint32_t(i), 0, CFG_NONE, CFG_NONE });
+			block_of[i] = uint32_t(cfg.size());
+		}
+	}
+	for(size_t b = 0; b < cfg.size(); ++b) {
+		cfg_block_t& block = cfg[b];
+		block.end		   = b + 1 < cfg.size() ? cfg[b + 1].begin : uint32_t(count);
+
+		const size_t	  last = block.end - 1;
+		const asm_inst_t& inst = insts[last];
+		if(falls_through(inst)) {
+			block.next = block_of[block.end] - 1;
+		}
+		if(is_direct_jump(inst)) {
+			block.target = block_of[last + 1 + size_t(inst.imm / sregister_t(sizeof(word_t)))] - 1;
+		}
+	}
+	return true;
+}
+
+bool VM::verify() {
+	std::string error;
+	m_verified = verify_program(code(), code_size(), m_cfg, error);
+	m_checked  = true;
+	if(!m_verified) {
+		fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
+				   "From VM::verify:\n"
+				   "ERROR: {}!\n",
+				   error);
+	}
+	return m_verified;
+}
+
+void VM::check() noexcept {
+	std::string error;
+	m_checked = true;
+	try {
+		m_verified = verify_program(code(), code_size(), m_cfg, error);
+	} catch(...) { // std::bad_alloc
+		m_verified = false;
+	}
+}
+
+END_DA_NAMESPACE
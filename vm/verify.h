@@ -0,0 +1,46 @@
+/**
+ * @file      verify.h
+ * @brief     Load time verifier of byte code
+ * @version   0.1
+ * @author    dragon-archer
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef _DAVM_VM_VERIFY_H_
+#define _DAVM_VM_VERIFY_H_
+
+#include <vm/pch.h>
+
+BEGIN_DA_NAMESPACE
+
+inline constexpr uint32_t CFG_NONE = UINT32_MAX;
+
+// Basic block, all indexes are of commands except the successors which are of blocks
+struct cfg_block_t {
+	uint32_t begin; // First command
+	uint32_t end; // One past the last command
+	uint32_t next; // Successor by falling through, CFG_NONE if the last command never falls through
+	uint32_t target; // Successor by direct jump, CFG_NONE if the last command is not a direct jump
+};
+
+using cfg_t = std::vector<cfg_block_t>;
+
+/**
+ * @brief  Build the control flow graph of a program & check it can be run without checking pc,
+ *         except after indirect jumps (JALR, CALL, RET & irregular commands writing pc)
+ * @param  program Byte code
+ * @param  size    Size of @param program in bytes
+ * @param  cfg     Filled with the blocks in address order
+ * @param  error   Reason of rejection
+ * @return Whether the program is accepted, which requires
+ *         - the size is a multiple of a command
+ *         - every command is valid
+ *         - every direct jump targets an aligned command inside the program
+ *         - the last command never falls through
+ */
+bool verify_program(const byte_t* program, size_t size, cfg_t& cfg, std::string& error);
+
+END_DA_NAMESPACE
+
+#endif // _DAVM_VM_VERIFY_H_
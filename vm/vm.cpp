@@ -10,6 +10,8 @@
 #include <vm/pch.h>
 #include <vm/vm.h>
 
+#include <common/base64.h>
+
 BEGIN_DA_NAMESPACE
 
 // Init the stack layout to
@@ -19,65 +21,294 @@ BEGIN_DA_NAMESPACE
 // |0x0000| -0x10| <- rbp, rsp			will be considered as saved rbp by the vm
 // So that the VM will be automated halt when all programs end
 void VM::init_stack() noexcept {
+	m_memory.mark_dirty();
 	std::memset(&m_context, 0, sizeof(m_context));
-	DAVM_BP(m_context) = DAVM_CAST(register_t, &*(m_memory.end() - 2 * sizeof(register_t)));
-	DAVM_SP(m_context) = DAVM_BP(m_context);
+	init_frame(DAVM_CAST(register_t, m_memory.end()));
 	DAVM_PC(m_context) = 0; // Set pc to 0 to avoid start before load
 	DAVM_ZR(m_context) = 0; // Clear zero register
+}
+
+void VM::init_frame(register_t top) noexcept {
+	DAVM_BP(m_context) = top - 2 * sizeof(register_t);
+	DAVM_SP(m_context) = DAVM_BP(m_context);
 
 	*DAVM_CAST(register_t*, DAVM_SP(m_context) + sizeof(register_t)) = 0;
 	*DAVM_CAST(register_t*, DAVM_SP(m_context))						 = 0;
 }
 
-int VM::one_step() noexcept {
-	// Avoid execute outside program
-	DA_IF_UNLIKELY((DAVM_PC(m_context) - DAVM_CAST(register_t, &*m_program.begin()))
-				   >= (DAVM_CAST(register_t, &*m_program.end()) - DAVM_CAST(register_t, &*m_program.begin()))) {
-		return 1;
+// .text & .rodata of a loaded image both lie in its read only mapping
+void VM::bind_bounds() noexcept {
+	guest_bounds_t& bounds = m_context.bounds;
+	bounds.begin		   = DAVM_CAST(register_t, m_memory.begin());
+	bounds.end			   = DAVM_CAST(register_t, m_memory.end());
+	if(m_text) {
+		const register_t text	= DAVM_CAST(register_t, m_text);
+		const register_t rodata = DAVM_CAST(register_t, m_image->section(IMAGE_RODATA));
+		bounds.ro_begin			= std::min(text, rodata);
+		bounds.ro_end			= std::max(text + m_image->section_size(IMAGE_TEXT), rodata + m_image->section_size(IMAGE_RODATA));
+	} else {
+		bounds.ro_begin = DAVM_CAST(register_t, m_program.data());
+		bounds.ro_end	= bounds.ro_begin + m_program.size();
 	}
-	word_t code = *DAVM_CAST(register_t*, DAVM_PC(m_context));
-	DAVM_PC(m_context) += sizeof(word_t);
-	switch(code & 0x7F) { // Bit 6 - 0 is opcode
-	case I_G_ARITH: {
-		const asm_cmd_r3_t cmd = *DAVM_CAST(asm_cmd_r3_t*, &code);
-		asm_table_arith[cmd.op2](m_context, cmd.rd, cmd.ra, cmd.rb);
-		return 0;
-	}
-	case I_G_LOAD: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		asm_table_load[cmd.op2](m_context, cmd.rd, cmd.ra, cmd.imm);
-		return 0;
-	}
-	case I_G_SAVE: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		asm_table_save[cmd.op2](m_context, cmd.rd, cmd.ra, cmd.imm);
-		return 0;
-	}
-	case I_G_IMM: {
-		const asm_cmd_r2i1_t cmd = *DAVM_CAST(asm_cmd_r2i1_t*, &code);
-		DA_IF_UNLIKELY(cmd.op2 == I_G_IMM_SHIFT) {
-			const asm_cmd_imm_shift_t cmd = *DAVM_CAST(asm_cmd_imm_shift_t*, &code);
-			asm_table_imm_shift[cmd.op3](m_context, cmd.rd, cmd.ra, cmd.imm);
+}
+
+bool VM::load(string_t filename) {
+	auto		image = std::make_shared<image_t>();
+	std::string error;
+	if(image->open(filename, error)) {
+		const size_t data = image->section_size(IMAGE_DATA);
+		const size_t bss  = image->header().bss;
+		if(bss > m_memory.heap_size() || data > m_memory.heap_size() - bss) {
+			error = ".data does not fit the heap";
 		} else {
-			asm_table_imm[cmd.op2](m_context, cmd.rd, cmd.ra, cmd.imm);
+			init_stack();
+			byte_t* base = m_memory.data();
+			std::memcpy(base, image->section(IMAGE_DATA), data);
+			std::memset(base + data, 0, bss);
+			const register_t bases[IMAGE_SECTIONS] = {
+				DAVM_CAST(register_t, image->section(IMAGE_TEXT)),
+				DAVM_CAST(register_t, image->section(IMAGE_RODATA)),
+				DAVM_CAST(register_t, base),
+			};
+			for(size_t i = 0; i < image->header().reloc_count; ++i) {
+				const image_reloc_t& reloc = image->relocs()[i];
+				register_t			 value;
+				std::memcpy(&value, base + reloc.offset, sizeof(value));
+				value += bases[reloc.section];
+				std::memcpy(base + reloc.offset, &value, sizeof(value));
+			}
+			m_program.clear();
+			m_text			   = image->section(IMAGE_TEXT);
+			m_image			   = std::move(image);
+			DAVM_PC(m_context) = DAVM_CAST(register_t, m_text) + m_image->header().entry;
+			DAVM_GP(m_context) = DAVM_CAST(register_t, base);
+			flush_decoded();
+			return true;
+		}
+	}
+	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
+			   "From VM::load:\n"
+			   "ERROR: {}!\n",
+			   error);
+	return false;
+}
+
+bool VM::load_base64(std::istream& in) {
+	std::unique_ptr<char[]> chunk(new char[VM_LOAD_CHUNK]);
+	b64dec_stream_t			decoder;
+	array_t					program;
+	std::string				error;
+	const auto				start = in.tellg(); // Reserve the whole program if the stream is seekable
+	if(start != std::istream::pos_type(-1) && in.seekg(0, std::ios::end)) {
+		program.reserve(b64dec_len(size_t(in.tellg() - start)));
+		in.seekg(start);
+	}
+	in.clear();
+	while(in) {
+		in.read(chunk.get(), VM_LOAD_CHUNK);
+		const size_t n	  = size_t(in.gcount());
+		const size_t size = program.size();
+		program.resize(size + b64dec_len(n + 3));
+		const size_t ret = decoder.feed(program.data() + size, chunk.get(), n);
+		DA_IF_UNLIKELY(ret >= size_t(-2)) {
+			error = "Unexpected token";
+			break;
 		}
-		return 0;
-	}
-	default: { // Deal with unique id
-		if(code & 0x08) { // void call
-			const asm_cmd_v_t cmd = *DAVM_CAST(asm_cmd_v_t*, &code);
-			asm_table_v[cmd.op2](m_context);
-			return 0;
-		} else if(code & 0x10) { // r1 call
-			const asm_cmd_r1_t cmd = *DAVM_CAST(asm_cmd_r1_t*, &code);
-			asm_table_r1[cmd.op2](m_context, cmd.rd);
-			return 0;
+		program.resize(size + ret);
+	}
+	if(error.empty()) {
+		if(in.bad()) {
+			error = "Cannot read the stream";
+		} else if(decoder.finish()) {
+			error = "Unexpected end of stream";
+		} else if(program.size() % sizeof(word_t)) {
+			error = "Partial command in the program";
 		} else {
-			return 2;
+			init_stack();
+			m_image.reset();
+			m_text			   = nullptr;
+			m_program		   = std::move(program);
+			DAVM_PC(m_context) = DAVM_CAST(register_t, m_program.data());
+			flush_decoded();
+			return true;
+		}
+	}
+	fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::red),
+			   "From VM::load_base64:\n"
+			   "ERROR: {}!\n",
+			   error);
+	return false;
+}
+
+VM::array_t& VM::program() {
+	if(m_text) {
+		const register_t text = DAVM_CAST(register_t, m_text);
+		m_program.assign(m_text, m_text + m_image->section_size(IMAGE_TEXT));
+		m_text = nullptr;
+		if(DAVM_PC(m_context) - text < m_program.size()) {
+			DAVM_PC(m_context) += DAVM_CAST(register_t, m_program.data()) - text;
+		}
+		flush_decoded();
+	}
+	return m_program;
+}
+
+// Commands fault before changing any register, so pc is the only one to restore
+std::unique_ptr<VM> VM::fork() {
+	std::unique_ptr<VM> child(new VM(m_memory.fork()));
+	child->m_context  = m_context;
+	child->m_program  = m_program;
+	child->m_rodata	  = m_rodata;
+	child->m_decoded  = m_decoded;
+	child->m_image	  = m_image;
+	child->m_text	  = m_text;
+	child->m_retired  = m_retired;
+	child->m_cfg	  = m_cfg;
+	child->m_verified = m_verified;
+	child->m_checked  = m_checked;
+	child->m_trap	  = m_trap;
+
+	const register_t memory		= DAVM_CAST(register_t, m_memory.data());
+	const register_t program	= DAVM_CAST(register_t, code());
+	const register_t to_memory	= DAVM_CAST(register_t, child->m_memory.data()) - memory;
+	const register_t to_program = DAVM_CAST(register_t, child->code()) - program; // 0 for a mapped image
+
+	auto rebase = [&](register_t& value) {
+		if(value - memory <= m_memory.size()) {
+			value += to_memory;
+		} else if(value - program <= code_size() && code_size()) {
+			value += to_program;
 		}
+	};
+	for(register_t& x : child->m_context.x) {
+		rebase(x);
+	}
+	// Frames saved by CALL in the stack, the one set by init_stack() ends the chain with zeros
+	const register_t low = DAVM_CAST(register_t, child->m_memory.end() - child->m_memory.stack_size());
+	const register_t top = child->m_memory.stack_size() - 2 * sizeof(register_t); // Highest offset of a frame
+	for(register_t bp = DAVM_BP(child->m_context); bp - low <= top && !(bp & (sizeof(register_t) - 1));) {
+		register_t* frame = DAVM_CAST(register_t*, bp);
+		rebase(frame[0]);
+		rebase(frame[1]);
+		DA_IF_UNLIKELY(frame[0] <= bp) { // Callers are always above
+			break;
+		}
+		bp = frame[0];
+	}
+	return child;
+}
+
+// Nothing but memory is shared, so the thread decodes on its own, starting from what this VM decoded
+std::unique_ptr<VM> VM::spawn(register_t entry, register_t stack) {
+	std::unique_ptr<VM> child(new VM(m_memory.share()));
+	child->m_program  = m_program;
+	child->m_rodata	  = m_rodata;
+	child->m_decoded  = m_decoded;
+	child->m_image	  = m_image;
+	child->m_text	  = m_text;
+	child->m_cfg	  = m_cfg;
+	child->m_verified = m_verified;
+	child->m_checked  = m_checked;
+
+	const register_t program = DAVM_CAST(register_t, code());
+	if(entry - program < code_size()) {
+		entry += DAVM_CAST(register_t, child->code()) - program; // 0 for a mapped image
+	}
+	std::memset(&child->m_context, 0, sizeof(child->m_context));
+	child->init_frame(stack);
+	DAVM_PC(child->m_context) = entry;
+	DAVM_GP(child->m_context) = DAVM_GP(m_context);
+	return child;
+}
+
+// Only commands which may fault need the trap frame, & only they may write memory or read the bounds
+int VM::one_step() noexcept {
+	int				  status;
+	const asm_inst_t* inst = prepare_step(status);
+	DA_IF_UNLIKELY(!inst) {
+		return status;
+	}
+	DA_IF_LIKELY(!is_access(inst->op)) {
+		return execute_step(inst);
+	}
+	m_memory.mark_dirty();
+	bind_bounds();
+	trap_frame_t frame(m_memory, m_context.bounds);
+	DA_IF_UNLIKELY(sigsetjmp(frame.jump, 0)) {
+		DAVM_PC(m_context) -= sizeof(word_t);
+		m_trap = { DAVM_PC(m_context), frame.address };
+		return 3;
+	}
+	return execute_step(inst);
+}
+
+const asm_inst_t* VM::prepare_step(int& status) noexcept {
+	DA_IF_UNLIKELY(!sync_decoded()) {
+		status = 2;
+		return nullptr;
+	}
+	const register_t offset = DAVM_PC(m_context) - DAVM_CAST(register_t, code());
+	const size_t	 index	= offset / sizeof(word_t);
+	// Avoid execute outside program, the last record is a sentinel
+	DA_IF_UNLIKELY(index >= m_decoded.size() - 1 || (offset & (sizeof(word_t) - 1))) {
+		status = 1;
+		return nullptr;
+	}
+	const asm_inst_t* inst = &m_decoded[index];
+	DA_IF_UNLIKELY(inst->id <= OP_ERROR) {
+		if(inst->id == OP_UNDECODED) {
+			inst = decode_page(index);
+		}
+		DA_IF_UNLIKELY(inst->id == OP_ERROR) {
+			DAVM_PC(m_context) += sizeof(word_t);
+			status = 2;
+			return nullptr;
+		}
+	}
+	return inst;
+}
+
+int VM::execute_step(const asm_inst_t* inst) noexcept {
+	DAVM_PC(m_context) += sizeof(word_t);
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	inst->func(m_context, *inst);
+	++m_retired;
+	DA_IF_UNLIKELY(inst->op == OP_ECALL) {
+		return 4;
+	}
+	return 0;
+}
+
+// One more record than commands, which stays undecoded forever,
+// so that run() stops when it falls off the end without checking pc
+void VM::flush_decoded() {
+	cache_t(code_size() / sizeof(word_t) + 1).swap(m_decoded); // Zeroed by the allocator, so this costs no more than its address space
+	m_verified = false;
+	m_checked  = false;
+#if DAVM_JIT
+	if(m_jit) {
+		m_jit->clear();
+	}
+#endif
+}
+
+// Decode the whole page containing m_decoded[index], so that code never runs is never decoded
+// Sequences in the page are fused afterwards, records after the first keep their plain op so they can still be jumped to
+const asm_inst_t* VM::decode_page(size_t index) noexcept {
+	constexpr size_t page_size = VM_DECODE_PAGE / sizeof(word_t);
+
+	const byte_t* text	= code();
+	const size_t  begin = index & ~(page_size - 1);
+	const size_t  end	= std::min(begin + page_size, m_decoded.size() - 1);
+	for(size_t i = begin; i < end; ++i) {
+		word_t word;
+		std::memcpy(&word, text + i * sizeof(word_t), sizeof(word_t));
+		m_decoded[i] = decode_inst(word);
 	}
+	for(size_t i = begin; i < end; ++i) {
+		m_decoded[i].id = fuse_inst(&m_decoded[i], end - i);
 	}
-	return 1;
+	return &m_decoded[index];
 }
 
 END_DA_NAMESPACE
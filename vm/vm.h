@@ -11,41 +11,213 @@
 #define _DAVM_VM_VM_H_
 
 #include <vm/pch.h>
+#include <vm/async.h>
+#include <vm/image.h>
+#include <vm/jit.h>
+#include <vm/memory.h>
+#include <vm/stats.h>
+#include <vm/trace.h>
+#include <vm/verify.h>
 
 BEGIN_DA_NAMESPACE
 
-inline constexpr size_t VM_DEFAULT_MEMORY = 64 * 1024 * 1024; // 64M
+inline constexpr size_t VM_DECODE_PAGE = 4096; // Byte code decoded at once
+inline constexpr size_t VM_LOAD_CHUNK	 = 64 * 1024; // Encoded chars read at once by VM::load_base64
+
+// Dispatch strategies of VM::run
+// The default is chosen by the compiler, override it with -DDAVM_DISPATCH=<strategy>
+#define DAVM_DISPATCH_SWITCH 0 // Plain switch, works everywhere
+#define DAVM_DISPATCH_GOTO	 1 // Computed goto, needs GNU extension
+#define DAVM_DISPATCH_TAIL	 2 // Threaded code with guaranteed tail calls, needs [[clang::musttail]]
+
+#ifndef DAVM_DISPATCH
+	#if DA_HAS_MUSTTAIL
+		#define DAVM_DISPATCH DAVM_DISPATCH_TAIL
+	#elif DA_COMP_GNU
+		#define DAVM_DISPATCH DAVM_DISPATCH_GOTO
+	#else
+		#define DAVM_DISPATCH DAVM_DISPATCH_SWITCH
+	#endif
+#endif
+
+struct run_state_t;
 
 class VM {
-	using string_t = std::string;
-	using array_t  = std::vector<byte_t>;
+	using string_t	  = std::string;
+	using array_t	  = std::vector<byte_t>;
+	using cache_t	  = std::vector<asm_inst_t, zero_allocator_t<asm_inst_t>>;
+	using image_ptr_t = std::shared_ptr<const image_t>;
 
 private:
-	vm_context_t m_context; // Internal context
-	array_t		 m_program; // Program byte code
-	array_t		 m_memory; // Memory, shared by heap and stack
-	array_t		 m_rodata; // Read only data
+	vm_context_t	 m_context; // Internal context
+	array_t			 m_program; // Program byte code, unless run from m_image
+	memory_t		 m_memory; // Memory, shared by heap and stack
+	array_t			 m_rodata; // Read only data
+	cache_t			 m_decoded; // Predecoded program, one record per command, filled one page at a time
+	image_ptr_t		 m_image; // Loaded image, shared with forks
+	const byte_t*	 m_text = nullptr; // .text of m_image being run, nullptr if running m_program
+	size_t			 m_retired = 0; // Commands executed so far
+	cfg_t			 m_cfg; // Control flow graph, valid if m_verified
+	bool			 m_verified = false; // Program passed verify(), so direct jumps need no check
+	bool			 m_checked	= false; // verify() ran since flush_decoded(), done by the first run otherwise
+	vm_trap_t		 m_trap {}; // Last memory fault
+#if DAVM_JIT
+	std::unique_ptr<jit_t> m_jit; // Created on first run_jit()
+#endif
+
+	friend struct run_state_t;
 
 public:
-	VM()
-		: m_memory(VM_DEFAULT_MEMORY) {
+	/**
+	 * @param memory Bytes of guest memory, only reserved until touched, see memory_t
+	 * @param stack  Bytes at the top of memory used as stack
+	 */
+	explicit VM(size_t memory = VM_DEFAULT_MEMORY, size_t stack = VM_DEFAULT_STACK)
+		: m_memory(memory, stack) {
 		init_stack();
+		flush_decoded();
 	}
 
+	/**
+	 * @brief  Clone the VM, sharing memory copy-on-write, see memory_t::fork()
+	 * @return VM with copies of the program & the context, registers pointing into memory or program are rebased,
+	 *         so are the saved bp & pc of the frames chained from bp in the stack
+	 * @throw  std::bad_alloc if the memory cannot be forked
+	 * @note   Other pointers the guest stored in memory still point into this VM
+	 */
+	std::unique_ptr<VM> fork();
+
+	/**
+	 * @brief  Clone the VM as a guest thread sharing its memory, see memory_t::share() & vm/thread.h
+	 * @param  entry Where the thread starts, rebased as in fork() if it points into program()
+	 * @param  stack Top of the stack of the thread, laid out as by init_stack() so that returning from @param entry halts
+	 * @return VM with copies of the program, & a context cleared but for pc, bp, sp & gp
+	 * @note   Code addresses the guest stored in memory still point into program() of this VM, images share their code
+	 */
+	std::unique_ptr<VM> spawn(register_t entry, register_t stack);
+
+	/**
+	 * @brief  Load the image @param filename, see image_t, reset the stack & start from its entry
+	 * @return Whether the image is accepted & its .data fits the heap, the reason is printed otherwise
+	 * @note   .text & .rodata are mapped, not read, .data is copied to the start of memory & relocated, gp points to it.
+	 *         Nothing is decoded or verified yet, so loading takes about the same time whatever the size of .text
+	 */
 	bool load(string_t filename);
 
-	int run(size_t target = 0);
+	/**
+	 * @brief  Load base64 encoded byte code from @param in as program(), reset the stack & start from its first command
+	 * @return Whether the stream is valid base64 of whole commands, the reason is printed otherwise
+	 * @note   The stream is decoded chunk by chunk while it is read, so only VM_LOAD_CHUNK chars are held besides the program
+	 */
+	bool load_base64(std::istream& in);
+
+	/**
+	 * @brief  Check the program with verify_program(), & run it in verified mode if accepted
+	 * @return Whether the program is accepted, the reason is printed otherwise
+	 * @note   Verified mode skips the range check of direct jumps, it ends at flush_decoded().
+	 *         The run loops verify the program silently on their first run after flush_decoded() if this was not called
+	 */
+	bool verify();
+
+	/**
+	 * @brief  Execute commands until stopped, using the dispatch strategy chosen by DAVM_DISPATCH
+	 * @param  target Maximum count of commands to execute, 0 for unlimited
+	 * @return Execute status
+	 * @retval 0 Success: @param target commands executed
+	 * @retval 1 Stopped: pc out of program, including halted by HLT
+	 * @retval 2 Error: invalid code, or no memory left to decode the program after it was resized
+	 * @retval 3 Error: invalid memory access, pc is left at the faulting command, see trap()
+	 * @retval 4 Host call: ECALL executed, pc is left after it, see asm_ecall()
+	 */
+	int run(size_t target = 0) noexcept {
+#if DAVM_DISPATCH == DAVM_DISPATCH_TAIL
+		return run_tail(target);
+#elif DAVM_DISPATCH == DAVM_DISPATCH_GOTO
+		return run_goto(target);
+#else
+		return run_switch(target);
+#endif
+	}
+
+	// Each available strategy is exposed so that they can be compared on the same program
+	int run_switch(size_t target = 0) noexcept;
+#if DA_COMP_GNU
+	int run_goto(size_t target = 0) noexcept;
+#endif
+#if DA_HAS_MUSTTAIL
+	int run_tail(size_t target = 0) noexcept;
+#endif
+
+#if DAVM_ASYNC
+	/**
+	 * @brief  Run until stopped as a coroutine, suspending it between slices & while a host call is served
+	 * @param  executor Queue the coroutine is posted to after each slice, so that other VMs run in between
+	 * @param  host     Serves ECALL, whose suspension parks the VM, if omitted the coroutine returns at ECALL
+	 * @param  slice    Commands run before yielding to @param executor
+	 * @return Final status of run(), 4 only without @param host
+	 * @note   The state of a suspended VM is its context & memory, the coroutine frame holds only the arguments
+	 */
+	vm_task_t<int> run_async(vm_executor_t& executor, vm_host_t host = {}, size_t slice = VM_ASYNC_SLICE);
+#endif
+
+#if DAVM_JIT
+	/**
+	 * @brief Same as run(), but compiles hot blocks into native code
+	 * @note  Commands the JIT does not support are executed by one_step()
+	 */
+	int run_jit(size_t target = 0) noexcept;
+#endif
+
+#if DAVM_TRACE
+	/**
+	 * @brief Same as run(), but records every command to @param trace, see trace_kind_t
+	 * @note  Commands are executed one at a time, without fusion nor JIT
+	 */
+	int run_trace(trace_writer_t& trace, size_t target = 0) noexcept;
+#endif
+
+	/**
+	 * @brief Same as run(), but counts commands & blocks into @param stats, see vm_stats_t
+	 * @note  Commands are executed one at a time, without fusion nor JIT, perf events include the counting
+	 */
+	int run_stats(vm_stats_t& stats, size_t target = 0) noexcept;
 
 public: // Access
 	vm_context_t& context() noexcept {
 		return m_context;
 	}
 
-	array_t& program() noexcept {
-		return m_program;
+	const vm_context_t& context() const noexcept {
+		return m_context;
+	}
+
+	/**
+	 * @brief Byte code to modify or replace
+	 * @note  After load(), the first call copies .text here & moves pc along, pc relative references to .rodata break
+	 */
+	array_t& program();
+
+	// Byte code being run, .text of the loaded image or program()
+	const byte_t* code() const noexcept {
+		return m_text ? m_text : m_program.data();
+	}
+
+	size_t code_size() const noexcept {
+		return m_text ? m_image->section_size(IMAGE_TEXT) : m_program.size();
+	}
+
+	// Loaded image, nullptr if none
+	const image_t* image() const noexcept {
+		return m_image.get();
 	}
 
-	array_t& memory() noexcept {
+	memory_t& memory() noexcept {
+		m_memory.mark_dirty();
+		return m_memory;
+	}
+
+	// Memory to inspect, without marking it dirty
+	const memory_t& memory() const noexcept {
 		return m_memory;
 	}
 
@@ -53,18 +225,89 @@ public: // Access
 		return m_rodata;
 	}
 
+	size_t retired() const noexcept {
+		return m_retired;
+	}
+
+	bool verified() const noexcept {
+		return m_verified;
+	}
+
+	const cfg_t& cfg() const noexcept {
+		return m_cfg;
+	}
+
+	const vm_trap_t& trap() const noexcept {
+		return m_trap;
+	}
+
 public: //
 	/**
 	 * @brief  Execute one instruction
 	 * @return Excuete status
 	 * @retval 0 Success
 	 * @retval 1 Error: pc out of program
-	 * @retval 2 Error: invalid code
+	 * @retval 2 Error: invalid code, see run()
+	 * @retval 3 Error: invalid memory access, see run()
+	 * @retval 4 Host call, see run()
 	 */
 	int one_step() noexcept;
 
+	/**
+	 * @brief Drop all predecoded commands & leave verified mode
+	 * @note  Must be called after modifying program() without changing its size, size changes are detected automatically
+	 */
+	void flush_decoded();
+
 private:
+	explicit VM(memory_t&& memory) noexcept
+		: m_memory(std::move(memory)) {
+	}
+
 	void init_stack() noexcept;
+
+	// Frame of init_stack() below @param top
+	void init_frame(register_t top) noexcept;
+
+	// Refresh vm_context_t::bounds from memory & the code being run, before running
+	void bind_bounds() noexcept;
+
+	// verify() without printing, a program rejected or too large to verify runs unverified
+	void check() noexcept;
+
+	// Redo flush_decoded() if the program was resized since, false if there is no memory left for it
+	bool sync_decoded() noexcept {
+		DA_IF_LIKELY(m_decoded.size() == code_size() / sizeof(word_t) + 1) {
+			return true;
+		}
+		try {
+			flush_decoded();
+		} catch(...) { // std::bad_alloc
+			return false;
+		}
+		return true;
+	}
+
+	// Record at pc, its page decoded, nullptr with @param status set if it cannot run
+	const asm_inst_t* prepare_step(int& status) noexcept;
+
+	// Execute @param inst, the record at pc
+	int execute_step(const asm_inst_t* inst) noexcept;
+
+	// Loops behind run_*, Verified drops the range check of direct jumps,
+	// Jit leaves at the jump targets run_jit() watches, see run_state_t::watch
+	template<bool Verified>
+	int loop_switch(run_state_t state) noexcept;
+#if DA_COMP_GNU
+	template<bool Verified, bool Jit = false>
+	int loop_goto(run_state_t state) noexcept;
+#endif
+#if DA_HAS_MUSTTAIL
+	template<bool Verified>
+	int loop_tail(run_state_t& state) noexcept;
+#endif
+
+	const asm_inst_t* decode_page(size_t index) noexcept;
 };
 
 END_DA_NAMESPACE